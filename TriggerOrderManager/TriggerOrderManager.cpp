@@ -2,6 +2,9 @@
 // Created by Bob   on 2022/6/9.
 //
 
+#include <algorithm>
+#include <unordered_set>
+
 #include "TriggerOrderManager.h"
 #include "log.h"
 
@@ -23,7 +26,7 @@ TriggerOrderManager::~TriggerOrderManager()
 
 void TriggerOrderManager::handleOrder(OPNX::Order& order)
 {
-    OPNX::CInOutLog cInOutLog("TriggerOrderManager::handleOrder");
+    OPNX_TRACE_SCOPE("TriggerOrderManager::handleOrder");
 
     OPNX::CAutoMutex  autoMutex(m_spinMutexTriggerOrder);
     try {
@@ -33,8 +36,9 @@ void TriggerOrderManager::handleOrder(OPNX::Order& order)
             saveToSearchOrder(order);
             m_pCallbackManager->pulsarOrder(order);
         }
-        else if (OPNX::Order::AMEND == order.action)
+        else if (OPNX::Order::AMEND == order.action || OPNX::Order::CANCEL_REPLACE == order.action)
         {
+            // a trigger order has no queue position, cancel-replace is an amend
             handleAmendOrder(order);
         }
         else if (OPNX::Order::CANCEL == order.action)
@@ -65,7 +69,7 @@ void TriggerOrderManager::markPriceTriggerOrder(long long markPrice)
 {
     if (cfLog.enabledTrace())
     {
-        OPNX::CInOutLog cInOutLog(m_strMarketCode + " markPriceTriggerOrder");
+        OPNX_TRACE_SCOPE(m_strMarketCode, "markPriceTriggerOrder");
     }
 
     if (OPNX::Order::MAX_PRICE == markPrice)
@@ -74,76 +78,10 @@ void TriggerOrderManager::markPriceTriggerOrder(long long markPrice)
     }
     try {
         OPNX::CAutoMutex autoMutex(m_spinMutexTriggerOrder);
-        auto itLess = m_lessMarkPriceTriggerOrder.begin();
-        while (itLess != m_lessMarkPriceTriggerOrder.end())
-        {
-            if (markPrice <= itLess->first)
-            {
-                std::for_each(itLess->second.begin(), itLess->second.end(), [&](auto it) {
-                    auto &order = *(it.second);
-                    OPNX::Order copyOrder(order);
-                    copyOrder.isTriggered = true;
-                    copyOrder.action = OPNX::Order::NEW;
-                    if (OPNX::Order::STOP_LIMIT == copyOrder.type || OPNX::Order::TAKE_PROFIT_LIMIT == copyOrder.type)
-                    {
-                        copyOrder.type = OPNX::Order::LIMIT;
-                    }
-                    else // OPNX::Order::STOP_MARKET == copyOrder.type || OPNX::Order::TAKE_PROFIT_MARKET == copyOrder.type
-                    {
-                        copyOrder.type = OPNX::Order::MARKET;
-                    }
-                    if (nullptr != m_pCallbackManager)
-                    {
-                        m_pCallbackManager->triggerOrderToEngine(copyOrder);
-                    }
-                    auto item = m_unmapSearchOrder.find(order.orderId);
-                    if (m_unmapSearchOrder.end() != item)
-                    {
-                        m_unmapSearchOrder.erase(item);
-                    }
-                });
-                itLess = m_lessMarkPriceTriggerOrder.erase(itLess);
-            }
-            else
-            {
-                break;
-            }
-        }
-        auto itGreater = m_greaterMarkPriceTriggerOrder.begin();
-        while (itGreater != m_greaterMarkPriceTriggerOrder.end())
-        {
-            if (markPrice >= itGreater->first)
-            {
-                std::for_each(itGreater->second.begin(), itGreater->second.end(), [&](auto it) {
-                    auto &order = *(it.second);
-                    OPNX::Order copyOrder(order);
-                    copyOrder.isTriggered = true;
-                    copyOrder.action = OPNX::Order::NEW;
-                    if (OPNX::Order::STOP_LIMIT == copyOrder.type || OPNX::Order::TAKE_PROFIT_LIMIT == copyOrder.type)
-                    {
-                        copyOrder.type = OPNX::Order::LIMIT;
-                    }
-                    else // OPNX::Order::STOP_MARKET == copyOrder.type || OPNX::Order::TAKE_PROFIT_MARKET == copyOrder.type
-                    {
-                        copyOrder.type = OPNX::Order::MARKET;
-                    }
-                    if (nullptr != m_pCallbackManager)
-                    {
-                        m_pCallbackManager->triggerOrderToEngine(copyOrder);
-                    }
-                    auto item = m_unmapSearchOrder.find(order.orderId);
-                    if (m_unmapSearchOrder.end() != item)
-                    {
-                        m_unmapSearchOrder.erase(item);
-                    }
-                });
-                itGreater = m_greaterMarkPriceTriggerOrder.erase(itGreater);
-            }
-            else
-            {
-                break;
-            }
-        }
+        m_vecTriggeredOrder.clear();
+        m_lessMarkPriceTriggerOrder.trigger(markPrice, [this](OPNX::Order* pOrder) { triggerOrder(pOrder); });
+        m_greaterMarkPriceTriggerOrder.trigger(markPrice, [this](OPNX::Order* pOrder) { triggerOrder(pOrder); });
+        dispatchTriggeredOrders();
     } catch (...) {
         cfLog.fatal() << "markPriceTriggerOrder exception!!!" << std::endl;
     }
@@ -152,7 +90,7 @@ void TriggerOrderManager::lastPriceTriggerOrder(long long lastPrice)
 {
     if (cfLog.enabledTrace())
     {
-        OPNX::CInOutLog cInOutLog(m_strMarketCode + " lastPriceTriggerOrder");
+        OPNX_TRACE_SCOPE(m_strMarketCode, "lastPriceTriggerOrder");
     }
 
     if (OPNX::Order::MAX_PRICE == lastPrice)
@@ -161,92 +99,121 @@ void TriggerOrderManager::lastPriceTriggerOrder(long long lastPrice)
     }
     try {
         OPNX::CAutoMutex autoMutex(m_spinMutexTriggerOrder);
-        auto itLess = m_lessLastPriceTriggerOrder.begin();
-        while (itLess != m_lessLastPriceTriggerOrder.end())
+        m_vecTriggeredOrder.clear();
+        m_lessLastPriceTriggerOrder.trigger(lastPrice, [this](OPNX::Order* pOrder) { triggerOrder(pOrder); });
+        m_greaterLastPriceTriggerOrder.trigger(lastPrice, [this](OPNX::Order* pOrder) { triggerOrder(pOrder); });
+        dispatchTriggeredOrders();
+    } catch (...) {
+        cfLog.fatal() << "lastPriceTriggerOrder exception!!!" << std::endl;
+    }
+}
+
+// The order leaves the trigger order manager, its copy goes to the engine as a LIMIT or MARKET order
+inline void TriggerOrderManager::triggerOrder(OPNX::Order* pOrder)
+{
+    OPNX::Order copyOrder(*pOrder);
+    copyOrder.isTriggered = true;
+    copyOrder.action = OPNX::Order::NEW;
+    if (OPNX::Order::STOP_LIMIT == copyOrder.type || OPNX::Order::TAKE_PROFIT_LIMIT == copyOrder.type)
+    {
+        copyOrder.type = OPNX::Order::LIMIT;
+    }
+    else // OPNX::Order::STOP_MARKET == copyOrder.type || OPNX::Order::TAKE_PROFIT_MARKET == copyOrder.type
+    {
+        copyOrder.type = OPNX::Order::MARKET;
+    }
+    m_vecTriggeredOrder.push_back(copyOrder);
+    m_unmapSearchOrder.erase(copyOrder.orderId);
+}
+
+// The orders triggered by one price go to the engine together, in the order of their trigger prices and sortIds
+inline void TriggerOrderManager::dispatchTriggeredOrders()
+{
+    if (!m_vecTriggeredOrder.empty() && nullptr != m_pCallbackManager)
+    {
+        m_pCallbackManager->triggerOrderListToEngine(m_vecTriggeredOrder);
+    }
+    m_vecTriggeredOrder.clear();
+}
+
+void TriggerOrderManager::clearOrder()
+{
+    m_lessMarkPriceTriggerOrder.clear();
+    m_greaterMarkPriceTriggerOrder.clear();
+    m_lessLastPriceTriggerOrder.clear();
+    m_greaterLastPriceTriggerOrder.clear();
+    m_unmapSearchOrder.clear();
+}
+
+// The orders of the ladders keep their sortId, the bracket orders that wait for their parent are kept apart,
+// so the restore puts the same orders in the ladders in the same time priority
+void TriggerOrderManager::getSnapshot(OPNX::MarketSnapshot& snapshot)
+{
+    OPNX::CAutoMutex autoMutex(m_spinMutexTriggerOrder);
+    try {
+        snapshot.vecTriggerOrder.reserve(m_unmapSearchOrder.size());
+        auto addOrder = [&snapshot](const OPNX::Order* pOrder) { snapshot.vecTriggerOrder.push_back(*pOrder); };
+        m_lessMarkPriceTriggerOrder.forEach(addOrder);
+        m_greaterMarkPriceTriggerOrder.forEach(addOrder);
+        m_lessLastPriceTriggerOrder.forEach(addOrder);
+        m_greaterLastPriceTriggerOrder.forEach(addOrder);
+        std::sort(snapshot.vecTriggerOrder.begin(), snapshot.vecTriggerOrder.end(), [](const OPNX::Order& a, const OPNX::Order& b) {
+            return a.sortId < b.sortId;
+        });
+        if (snapshot.vecTriggerOrder.size() < m_unmapSearchOrder.size())
         {
-            if (lastPrice <= itLess->first)
+            std::unordered_set<unsigned long long> setLadderOrderId;
+            setLadderOrderId.reserve(snapshot.vecTriggerOrder.size());
+            for (auto& order: snapshot.vecTriggerOrder)
             {
-                std::for_each(itLess->second.begin(), itLess->second.end(), [&](auto it) {
-                    auto &order = *(it.second);
-                    OPNX::Order copyOrder(order);
-                    copyOrder.isTriggered = true;
-                    copyOrder.action = OPNX::Order::NEW;
-                    if (OPNX::Order::STOP_LIMIT == copyOrder.type || OPNX::Order::TAKE_PROFIT_LIMIT == copyOrder.type)
-                    {
-                        copyOrder.type = OPNX::Order::LIMIT;
-                    }
-                    else // OPNX::Order::STOP_MARKET == copyOrder.type || OPNX::Order::TAKE_PROFIT_MARKET == copyOrder.type
-                    {
-                        copyOrder.type = OPNX::Order::MARKET;
-                    }
-                    if (nullptr != m_pCallbackManager)
-                    {
-                        m_pCallbackManager->triggerOrderToEngine(copyOrder);
-                    }
-                    auto item = m_unmapSearchOrder.find(order.orderId);
-                    if (m_unmapSearchOrder.end() != item)
-                    {
-                        m_unmapSearchOrder.erase(item);
-                    }
-                });
-                itLess = m_lessLastPriceTriggerOrder.erase(itLess);
+                setLadderOrderId.insert(order.orderId);
             }
-            else
+            for (auto& item: m_unmapSearchOrder)
             {
-                break;
+                if (0 == setLadderOrderId.count(item.first))
+                {
+                    snapshot.vecPendingTriggerOrder.push_back(item.second);
+                }
             }
+            std::sort(snapshot.vecPendingTriggerOrder.begin(), snapshot.vecPendingTriggerOrder.end(), [](const OPNX::Order& a, const OPNX::Order& b) {
+                return a.orderId < b.orderId;
+            });
         }
-        auto itGreater = m_greaterLastPriceTriggerOrder.begin();
-        while (itGreater != m_greaterLastPriceTriggerOrder.end())
+    } catch (...) {
+        cfLog.fatal() << "TriggerOrderManager::getSnapshot exception!!!" << std::endl;
+    }
+}
+
+void TriggerOrderManager::loadSnapshot(OPNX::MarketSnapshot& snapshot)
+{
+    OPNX::CAutoMutex autoMutex(m_spinMutexTriggerOrder);
+    try {
+        clearOrder();
+        m_unmapSearchOrder.reserve(snapshot.vecTriggerOrder.size() + snapshot.vecPendingTriggerOrder.size());
+        // by sortId, each order goes to the back of its level
+        for (auto& order: snapshot.vecTriggerOrder)
         {
-            if (lastPrice >= itGreater->first)
-            {
-                std::for_each(itGreater->second.begin(), itGreater->second.end(), [&](auto it) {
-                    auto &order = *(it.second);
-                    OPNX::Order copyOrder(order);
-                    copyOrder.isTriggered = true;
-                    copyOrder.action = OPNX::Order::NEW;
-                    if (OPNX::Order::STOP_LIMIT == copyOrder.type || OPNX::Order::TAKE_PROFIT_LIMIT == copyOrder.type)
-                    {
-                        copyOrder.type = OPNX::Order::LIMIT;
-                    }
-                    else // OPNX::Order::STOP_MARKET == copyOrder.type || OPNX::Order::TAKE_PROFIT_MARKET == copyOrder.type
-                    {
-                        copyOrder.type = OPNX::Order::MARKET;
-                    }
-                    if (nullptr != m_pCallbackManager)
-                    {
-                        m_pCallbackManager->triggerOrderToEngine(copyOrder);
-                    }
-                    auto item = m_unmapSearchOrder.find(order.orderId);
-                    if (m_unmapSearchOrder.end() != item)
-                    {
-                        m_unmapSearchOrder.erase(item);
-                    }
-                });
-                itGreater = m_lessLastPriceTriggerOrder.erase(itGreater);
-            }
-            else
+            order.action = OPNX::Order::NEW;
+            auto item = m_unmapSearchOrder.emplace(order.orderId, order);
+            OPNX::TriggerLadder* pTriggerLadder = getTriggerLadder(order);
+            if (item.second && nullptr != pTriggerLadder)
             {
-                break;
+                pTriggerLadder->add(&(item.first->second));
             }
         }
+        for (auto& order: snapshot.vecPendingTriggerOrder)
+        {
+            order.action = OPNX::Order::NEW;
+            m_unmapSearchOrder.emplace(order.orderId, order);
+        }
     } catch (...) {
-        cfLog.fatal() << "lastPriceTriggerOrder exception!!!" << std::endl;
+        cfLog.fatal() << "TriggerOrderManager::loadSnapshot exception!!!" << std::endl;
     }
 }
-void TriggerOrderManager::clearOrder()
-{
-    m_lessMarkPriceTriggerOrder.clear();
-    m_greaterMarkPriceTriggerOrder.clear();
-    m_lessLastPriceTriggerOrder.clear();
-    m_greaterLastPriceTriggerOrder.clear();
-    m_unmapSearchOrder.clear();
-}
 
 void TriggerOrderManager::handleCancelOrder(OPNX::Order& order)
 {
-    OPNX::CInOutLog cInOutLog(m_strMarketCode + " TriggerOrderManager::handleCancelOrder");
+    OPNX_TRACE_SCOPE(m_strMarketCode, "TriggerOrderManager::handleCancelOrder");
     try {
 
         if (0 != order.orderId)
@@ -313,7 +280,7 @@ void TriggerOrderManager::handleCancelOrder(OPNX::Order& order)
 
 void TriggerOrderManager::handleAmendOrder(OPNX::Order& order)
 {
-    OPNX::CInOutLog cInOutLog(m_strMarketCode + " TriggerOrderManager::handleAmendOrder");
+    OPNX_TRACE_SCOPE(m_strMarketCode, "TriggerOrderManager::handleAmendOrder");
     try {
         auto it = m_unmapSearchOrder.find(order.orderId);
         if (m_unmapSearchOrder.end() == it)
@@ -357,7 +324,7 @@ void TriggerOrderManager::handleAmendOrder(OPNX::Order& order)
 
 inline OPNX::Order* TriggerOrderManager::saveToSearchOrder(OPNX::Order& order)
 {
-    OPNX::CInOutLog cInOutLog(m_strMarketCode + " TriggerOrderManager::saveToSearchOrder");
+    OPNX_TRACE_SCOPE(m_strMarketCode, "TriggerOrderManager::saveToSearchOrder");
 
     OPNX::Order* pOrder = nullptr;
     try {
@@ -390,30 +357,25 @@ void TriggerOrderManager::saveToTriggerOrder(OPNX::Order* pOrder)
         m_pCallbackManager->orderStore(pOrder);
 
         pOrder->sortId = OPNX::Utils::getSortId();
-        if (OPNX::Order::GREATER_EQUAL == pOrder->stopCondition)
+        OPNX::TriggerLadder* pTriggerLadder = getTriggerLadder(*pOrder);
+        if (nullptr != pTriggerLadder)
         {
-            if (OPNX::Order::MARK_PRICE == pOrder->triggerType)
-            {
-                m_greaterMarkPriceTriggerOrder[pOrder->triggerPrice][pOrder->sortId] = pOrder;
-            }
-            else
-            {
-                m_greaterLastPriceTriggerOrder[pOrder->triggerPrice][pOrder->sortId] = pOrder;
-            }
-        }
-        else if (OPNX::Order::LESS_EQUAL == pOrder->stopCondition)
-        {
-            if (OPNX::Order::MARK_PRICE == pOrder->triggerType)
-            {
-                m_lessMarkPriceTriggerOrder[pOrder->triggerPrice][pOrder->sortId] = pOrder;
-            }
-            else
-            {
-                m_lessLastPriceTriggerOrder[pOrder->triggerPrice][pOrder->sortId] = pOrder;
-            }
+            pTriggerLadder->add(pOrder);
         }
+    }
+}
 
+inline OPNX::TriggerLadder* TriggerOrderManager::getTriggerLadder(const OPNX::Order& order)
+{
+    if (OPNX::Order::GREATER_EQUAL == order.stopCondition)
+    {
+        return OPNX::Order::MARK_PRICE == order.triggerType ? &m_greaterMarkPriceTriggerOrder : &m_greaterLastPriceTriggerOrder;
+    }
+    if (OPNX::Order::LESS_EQUAL == order.stopCondition)
+    {
+        return OPNX::Order::MARK_PRICE == order.triggerType ? &m_lessMarkPriceTriggerOrder : &m_lessLastPriceTriggerOrder;
     }
+    return nullptr;
 }
 
 inline void TriggerOrderManager::eraseFromSearchOrderMap(OPNX::Order& order)
@@ -436,51 +398,16 @@ inline OPNX::SearchOrderMap::iterator TriggerOrderManager::eraseFromSearchOrderM
 void TriggerOrderManager::eraseFromTriggerOrderMap(OPNX::Order& order)
 {
     try {
-        if (OPNX::Order::LESS_EQUAL == order.stopCondition)
-        {
-            if (OPNX::Order::MARK_PRICE == order.triggerType)
-            {
-                eraseFromTriggerOrderMap<OPNX::OrderDescendMap>(m_lessMarkPriceTriggerOrder, order);
-            }
-            else
-            {
-                eraseFromTriggerOrderMap<OPNX::OrderDescendMap>(m_lessLastPriceTriggerOrder, order);
-            }
-        }
-        else if (OPNX::Order::GREATER_EQUAL == order.stopCondition)
+        OPNX::TriggerLadder* pTriggerLadder = getTriggerLadder(order);
+        if (nullptr != pTriggerLadder)
         {
-            if (OPNX::Order::MARK_PRICE == order.triggerType)
-            {
-                eraseFromTriggerOrderMap<OPNX::OrderAscendMap>(m_greaterMarkPriceTriggerOrder, order);
-            }
-            else
-            {
-                eraseFromTriggerOrderMap<OPNX::OrderAscendMap>(m_greaterLastPriceTriggerOrder, order);
-            }
+            pTriggerLadder->erase(order);
         }
     } catch (...) {
         cfLog.fatal() << "Engine::eraseFromPriceOrderMap exception!!!" << std::endl;
     }
 }
 
-template <typename PriceOrderMap>
-void TriggerOrderManager::eraseFromTriggerOrderMap(PriceOrderMap& priceOrderMap, const OPNX::Order& order)
-{
-    auto orderMap = priceOrderMap.find(order.triggerPrice);
-    if (priceOrderMap.end() != orderMap)
-    {
-        auto it = orderMap->second.find(order.sortId);
-        if (orderMap->second.end() != it)
-        {
-            orderMap->second.erase(it);
-        }
-        if (orderMap->second.empty())
-        {
-            priceOrderMap.erase(orderMap);
-        }
-    }
-}
-
 
 void TriggerOrderManager::handleBracketOrder(const OPNX::Order& bracketOrder)
 {
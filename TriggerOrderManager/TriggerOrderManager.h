@@ -12,11 +12,16 @@
 #include "json.hpp"
 #include "utils.h"
 #include "thread_queue.h"
+#include "trigger_ladder.h"
 
 class TriggerOrderManager: public OPNX::ITriggerOrder {
 private:
     TriggerOrderManager(const nlohmann::json& jsonMarketInfo, OPNX::ICallbackManager* pCallbackManager)
-            : m_jsonMarketInfo(jsonMarketInfo)
+            : m_lessMarkPriceTriggerOrder(OPNX::Order::LESS_EQUAL)
+            , m_greaterMarkPriceTriggerOrder(OPNX::Order::GREATER_EQUAL)
+            , m_lessLastPriceTriggerOrder(OPNX::Order::LESS_EQUAL)
+            , m_greaterLastPriceTriggerOrder(OPNX::Order::GREATER_EQUAL)
+            , m_jsonMarketInfo(jsonMarketInfo)
             , m_pCallbackManager(pCallbackManager)
             , m_strMarketCode("")
     {
@@ -30,10 +35,11 @@ private:
 
 private:
     OPNX::SearchOrderMap m_unmapSearchOrder;   // save all orders
-    OPNX::OrderDescendMap m_lessMarkPriceTriggerOrder; // key is price, Save the order with OrderStopCondition as LESS_EQUAL, in ascending order
-    OPNX::OrderAscendMap m_greaterMarkPriceTriggerOrder; // key is price, Save the order with OrderStopCondition as GREATER_EQUAL, in descending order
-    OPNX::OrderDescendMap m_lessLastPriceTriggerOrder; // key is price, Save the order with OrderStopCondition as LESS_EQUAL, in ascending order
-    OPNX::OrderAscendMap m_greaterLastPriceTriggerOrder; // key is price, Save the order with OrderStopCondition as GREATER_EQUAL, in descending order
+    OPNX::TriggerLadder m_lessMarkPriceTriggerOrder;       // the orders with OrderStopCondition as LESS_EQUAL, the highest trigger price first
+    OPNX::TriggerLadder m_greaterMarkPriceTriggerOrder;    // the orders with OrderStopCondition as GREATER_EQUAL, the lowest trigger price first
+    OPNX::TriggerLadder m_lessLastPriceTriggerOrder;       // the orders with OrderStopCondition as LESS_EQUAL, the highest trigger price first
+    OPNX::TriggerLadder m_greaterLastPriceTriggerOrder;    // the orders with OrderStopCondition as GREATER_EQUAL, the lowest trigger price first
+    std::vector<OPNX::Order> m_vecTriggeredOrder;       // the orders triggered by one price, dispatched together
 
     nlohmann::json m_jsonMarketInfo;
     OPNX::ICallbackManager* m_pCallbackManager;
@@ -50,6 +56,8 @@ public:
     virtual void lastPriceTriggerOrder(long long lastPrice);
     virtual std::string getMarketCode() { return m_strMarketCode; };
     virtual void clearOrder();
+    virtual void getSnapshot(OPNX::MarketSnapshot& snapshot);
+    virtual void loadSnapshot(OPNX::MarketSnapshot& snapshot);
     virtual unsigned long long getOrdersCount() { return m_unmapSearchOrder.size(); };
 
 private:
@@ -58,12 +66,13 @@ private:
     inline OPNX::Order* saveToSearchOrder(OPNX::Order& order);
     void saveToTriggerOrder(OPNX::Order* order);
     void handleBracketOrder(const OPNX::Order& bracketOrder);
+    inline void dispatchTriggeredOrders();
 
     inline void eraseFromSearchOrderMap(OPNX::Order& order);
     inline OPNX::SearchOrderMap::iterator eraseFromSearchOrderMap(OPNX::SearchOrderMap::iterator& it);
     void eraseFromTriggerOrderMap(OPNX::Order& order);
-    template <typename PriceOrderMap>
-    void eraseFromTriggerOrderMap(PriceOrderMap& priceOrderMap, const OPNX::Order& order);
+    inline OPNX::TriggerLadder* getTriggerLadder(const OPNX::Order& order);
+    inline void triggerOrder(OPNX::Order* pOrder);
 };
 
 
@@ -0,0 +1,718 @@
+#include <algorithm>
+#include <cstdio>
+#include <limits>
+
+#include "bench.h"
+#include "manager.h"
+#include "log.h"
+#include "rapidjson/document.h"
+
+static const unsigned long long BENCH_QUANTITY = 10;
+static const unsigned long long BENCH_IMPLIED_DEPTH = 100;   // orders on each side of the legs of an implier
+static const unsigned long long BENCH_ORDER_COUNT = 1024;    // different orders of the json cases
+static const unsigned long long BENCH_SNAPSHOT_OPS = 20;     // at most operations of the engine snapshot, one copies the whole book
+
+void Bench::run()
+{
+    for (unsigned long long ullDepth : {0, 100, 1000, 10000})
+    {
+        benchAdd(ullDepth);
+    }
+    for (unsigned long long ullDepth : {100, 1000, 10000})
+    {
+        benchCancel(ullDepth);
+        benchAmend(ullDepth);
+        benchAmendPrice(ullDepth);
+    }
+    for (unsigned long long ullLevels : {1, 10, 100})
+    {
+        benchSweep(ullLevels);
+    }
+    benchIceberg(100);
+    for (unsigned long long ullDepth : {100, 1000})
+    {
+        benchFok(ullDepth, true);
+        benchFok(ullDepth, false);
+    }
+    for (int iType = OPNX::Implier::PERP_REPO_OUT_SPOT; iType <= OPNX::Implier::SPOT_PERP_OUT_REPO; iType++)
+    {
+        benchImplied((OPNX::Implier::ImpliedType)iType, false);
+        benchImplied((OPNX::Implier::ImpliedType)iType, true);
+    }
+    for (unsigned long long ullDepth : {100, 10000})
+    {
+        benchTriggerFire(ullDepth);
+        benchTriggerCheck(ullDepth);
+    }
+    benchDecode();
+    benchEncode();
+    for (unsigned long long ullChanges : {1, 10, 100})
+    {
+        benchBookDiff(400, ullChanges);
+    }
+    benchBookSnapshot(400);
+    for (unsigned long long ullDepth : {1000, 10000, 100000})
+    {
+        benchEngineSnapshot(ullDepth);
+    }
+}
+
+// New order at a random price of the book that doesn't cross, the order is canceled again before the next one
+void Bench::benchAdd(unsigned long long ullDepth)
+{
+    if (!isSelected("add"))
+    {
+        return;
+    }
+    reset();
+    long long llTick = PRICE_FACTOR;
+    OPNX::IEngine* pIEngine = createEngine("BTC-USD-SWAP-LIN", "PERP", 1.0);
+    fillBook(pIEngine, ullDepth, MID_PRICE, llTick, BENCH_QUANTITY);
+    unsigned long long ullRange = std::max(ullDepth, 100ULL);
+    for (unsigned long long i = 0; i < m_ullOps; i++)
+    {
+        long long llOffset = (m_random() % ullRange + 1) * llTick;
+        OPNX::Order order = (0 == m_random() % 2) ? newOrder(OPNX::Order::BUY, MID_PRICE - llOffset, BENCH_QUANTITY)
+                                                  : newOrder(OPNX::Order::SELL, MID_PRICE + llOffset, BENCH_QUANTITY);
+        unsigned long long ullBegin = beginTime();
+        pIEngine->handleOrder(order);
+        endTime(ullBegin);
+
+        OPNX::Order cancelOrder(order);
+        cancelOrder.action = OPNX::Order::CANCEL;
+        pIEngine->handleOrder(cancelOrder);
+    }
+    pIEngine->releaseIEngine();
+    report("add", {{"depth", ullDepth}});
+}
+
+// Cancel a random order of the book, an order with the same price is added again
+void Bench::benchCancel(unsigned long long ullDepth)
+{
+    if (!isSelected("cancel"))
+    {
+        return;
+    }
+    reset();
+    long long llTick = PRICE_FACTOR;
+    OPNX::IEngine* pIEngine = createEngine("BTC-USD-SWAP-LIN", "PERP", 1.0);
+    std::vector<unsigned long long> vecOrderId;
+    fillBook(pIEngine, ullDepth, MID_PRICE, llTick, BENCH_QUANTITY, &vecOrderId);
+    for (unsigned long long i = 0; i < m_ullOps; i++)
+    {
+        unsigned long long index = m_random() % vecOrderId.size();
+        OPNX::Order cancelOrder;
+        cancelOrder.action = OPNX::Order::CANCEL;
+        cancelOrder.marketId = m_ullMarketId;
+        cancelOrder.orderId = vecOrderId[index];
+        unsigned long long ullBegin = beginTime();
+        pIEngine->handleOrder(cancelOrder);
+        endTime(ullBegin);
+
+        long long llOffset = (index / 2 + 1) * llTick;
+        OPNX::Order order = (0 == index % 2) ? newOrder(OPNX::Order::BUY, MID_PRICE - llOffset, BENCH_QUANTITY)
+                                             : newOrder(OPNX::Order::SELL, MID_PRICE + llOffset, BENCH_QUANTITY);
+        pIEngine->handleOrder(order);
+        vecOrderId[index] = order.orderId;
+    }
+    pIEngine->releaseIEngine();
+    report("cancel", {{"depth", ullDepth}});
+}
+
+// Amend a random order of the book to a smaller quantity, it keeps its place in the queue
+void Bench::benchAmend(unsigned long long ullDepth)
+{
+    if (!isSelected("amend"))
+    {
+        return;
+    }
+    reset();
+    long long llTick = PRICE_FACTOR;
+    unsigned long long ullQuantity = 1000000000;
+    OPNX::IEngine* pIEngine = createEngine("BTC-USD-SWAP-LIN", "PERP", 1.0);
+    std::vector<unsigned long long> vecOrderId;
+    fillBook(pIEngine, ullDepth, MID_PRICE, llTick, ullQuantity, &vecOrderId);
+    std::vector<unsigned long long> vecQuantity(vecOrderId.size(), ullQuantity);
+    for (unsigned long long i = 0; i < m_ullOps; i++)
+    {
+        unsigned long long index = m_random() % vecOrderId.size();
+        long long llOffset = (index / 2 + 1) * llTick;
+        OPNX::Order amendOrder = (0 == index % 2) ? newOrder(OPNX::Order::BUY, MID_PRICE - llOffset, --vecQuantity[index])
+                                                  : newOrder(OPNX::Order::SELL, MID_PRICE + llOffset, --vecQuantity[index]);
+        amendOrder.action = OPNX::Order::AMEND;
+        amendOrder.orderId = vecOrderId[index];
+        unsigned long long ullBegin = beginTime();
+        pIEngine->handleOrder(amendOrder);
+        endTime(ullBegin);
+    }
+    pIEngine->releaseIEngine();
+    report("amend", {{"depth", ullDepth}});
+}
+
+// Amend a random order of the book to another price of its side, it is canceled and added again
+void Bench::benchAmendPrice(unsigned long long ullDepth)
+{
+    if (!isSelected("amend_price"))
+    {
+        return;
+    }
+    reset();
+    long long llTick = PRICE_FACTOR;
+    OPNX::IEngine* pIEngine = createEngine("BTC-USD-SWAP-LIN", "PERP", 1.0);
+    std::vector<unsigned long long> vecOrderId;
+    fillBook(pIEngine, ullDepth, MID_PRICE, llTick, BENCH_QUANTITY, &vecOrderId);
+    for (unsigned long long i = 0; i < m_ullOps; i++)
+    {
+        unsigned long long index = m_random() % vecOrderId.size();
+        long long llOffset = (m_random() % ullDepth + 1) * llTick;
+        OPNX::Order amendOrder = (0 == index % 2) ? newOrder(OPNX::Order::BUY, MID_PRICE - llOffset, BENCH_QUANTITY)
+                                                  : newOrder(OPNX::Order::SELL, MID_PRICE + llOffset, BENCH_QUANTITY);
+        amendOrder.action = OPNX::Order::AMEND;
+        amendOrder.orderId = vecOrderId[index];
+        unsigned long long ullBegin = beginTime();
+        pIEngine->handleOrder(amendOrder);
+        endTime(ullBegin);
+    }
+    pIEngine->releaseIEngine();
+    report("amend_price", {{"depth", ullDepth}});
+}
+
+// A buy order that takes the first ullLevels levels of the asks, the levels are added again
+void Bench::benchSweep(unsigned long long ullLevels)
+{
+    if (!isSelected("sweep"))
+    {
+        return;
+    }
+    reset();
+    long long llTick = PRICE_FACTOR;
+    OPNX::IEngine* pIEngine = createEngine("BTC-USD-SWAP-LIN", "PERP", 1.0);
+    fillBook(pIEngine, ullLevels + 100, MID_PRICE, llTick, BENCH_QUANTITY);
+    for (unsigned long long i = 0; i < m_ullOps; i++)
+    {
+        OPNX::Order order = newOrder(OPNX::Order::BUY, MID_PRICE + ullLevels * llTick, ullLevels * BENCH_QUANTITY);
+        order.accountId = 2;
+        unsigned long long ullBegin = beginTime();
+        pIEngine->handleOrder(order);
+        endTime(ullBegin);
+
+        for (unsigned long long ullLevel = 1; ullLevel <= ullLevels; ullLevel++)
+        {
+            OPNX::Order makerOrder = newOrder(OPNX::Order::SELL, MID_PRICE + ullLevel * llTick, BENCH_QUANTITY);
+            pIEngine->handleOrder(makerOrder);
+        }
+    }
+    pIEngine->releaseIEngine();
+    report("sweep", {{"levels", ullLevels}});
+}
+
+// A buy order that takes the displayed quantity of an iceberg order at the best ask, the iceberg order is refilled
+void Bench::benchIceberg(unsigned long long ullDepth)
+{
+    if (!isSelected("iceberg"))
+    {
+        return;
+    }
+    reset();
+    long long llTick = PRICE_FACTOR;
+    OPNX::IEngine* pIEngine = createEngine("BTC-USD-SWAP-LIN", "PERP", 1.0);
+    fillBook(pIEngine, ullDepth, MID_PRICE, llTick, BENCH_QUANTITY);
+    OPNX::Order icebergOrder = newOrder(OPNX::Order::SELL, MID_PRICE, 1000000000000);
+    icebergOrder.displayQuantity = BENCH_QUANTITY;
+    pIEngine->handleOrder(icebergOrder);
+    for (unsigned long long i = 0; i < m_ullOps; i++)
+    {
+        OPNX::Order order = newOrder(OPNX::Order::BUY, MID_PRICE, BENCH_QUANTITY);
+        order.accountId = 2;
+        unsigned long long ullBegin = beginTime();
+        pIEngine->handleOrder(order);
+        endTime(ullBegin);
+    }
+    pIEngine->releaseIEngine();
+    report("iceberg", {{"depth", ullDepth}});
+}
+
+// bFill: a FOK order that takes the best ask, the level is added again.
+// Otherwise a FOK order for more than the asks up to its price, it is canceled after checking all levels.
+void Bench::benchFok(unsigned long long ullDepth, bool bFill)
+{
+    std::string strName = bFill ? "fok_fill" : "fok_kill";
+    if (!isSelected(strName))
+    {
+        return;
+    }
+    reset();
+    long long llTick = PRICE_FACTOR;
+    OPNX::IEngine* pIEngine = createEngine("BTC-USD-SWAP-LIN", "PERP", 1.0);
+    fillBook(pIEngine, ullDepth, MID_PRICE, llTick, BENCH_QUANTITY);
+    for (unsigned long long i = 0; i < m_ullOps; i++)
+    {
+        OPNX::Order order = bFill ? newOrder(OPNX::Order::BUY, MID_PRICE + llTick, BENCH_QUANTITY)
+                                  : newOrder(OPNX::Order::BUY, MID_PRICE + ullDepth * llTick, ullDepth * BENCH_QUANTITY + 1);
+        order.accountId = 2;
+        order.timeCondition = OPNX::Order::FOK;
+        unsigned long long ullBegin = beginTime();
+        pIEngine->handleOrder(order);
+        endTime(ullBegin);
+
+        if (bFill)
+        {
+            OPNX::Order makerOrder = newOrder(OPNX::Order::SELL, MID_PRICE + llTick, BENCH_QUANTITY);
+            pIEngine->handleOrder(makerOrder);
+        }
+    }
+    pIEngine->releaseIEngine();
+    report(strName, {{"depth", ullDepth}});
+}
+
+// Best ask and bid, or the order books with bBook, of a market with one implier whose legs have BENCH_IMPLIED_DEPTH orders on each side.
+// The legs are the same as the "implied" of the config.
+void Bench::benchImplied(OPNX::Implier::ImpliedType impliedType, bool bBook)
+{
+    std::string strName = bBook ? "implied_book" : "implied_best";
+    if (!isSelected(strName))
+    {
+        return;
+    }
+    reset();
+    struct Market {
+        std::string strMarketCode;
+        std::string strType;
+        double dTickSize;
+        long long llMid;
+    };
+    static const Market spot{"BTC-USD", "SPOT", 1.0, 3000000};
+    static const Market perp{"BTC-USD-SWAP-LIN", "PERP", 1.0, 3001000};
+    static const Market repo{"BTC-USD-REPO-LIN", "REPO", 0.1, 1000};
+    static const Market future{"BTC-USD-240329-LIN", "FUTURE", 1.0, 3010000};
+    static const Market spread{"BTC-USD-SPR-240329-LIN", "SPREAD", 0.1, 9000};
+    const Market* arrMarket[3] = {nullptr, nullptr, nullptr};   // the market with the implier, leg1, leg2
+    switch (impliedType)
+    {
+        case OPNX::Implier::PERP_REPO_OUT_SPOT      : arrMarket[0] = &spot; arrMarket[1] = &perp; arrMarket[2] = &repo; break;
+        case OPNX::Implier::SPREAD_PERP_OUT_FUTURES : arrMarket[0] = &future; arrMarket[1] = &spread; arrMarket[2] = &perp; break;
+        case OPNX::Implier::FUTURES_SPREAD_OUT_PERP : arrMarket[0] = &perp; arrMarket[1] = &future; arrMarket[2] = &spread; break;
+        case OPNX::Implier::FUTURES_PERP_OUT_SPREAD : arrMarket[0] = &spread; arrMarket[1] = &future; arrMarket[2] = &perp; break;
+        case OPNX::Implier::SPOT_REPO_OUT_PERP      : arrMarket[0] = &perp; arrMarket[1] = &spot; arrMarket[2] = &repo; break;
+        case OPNX::Implier::SPOT_PERP_OUT_REPO      : arrMarket[0] = &repo; arrMarket[1] = &spot; arrMarket[2] = &perp; break;
+    }
+    OPNX::IEngine* arrIEngine[3] = {nullptr, nullptr, nullptr};
+    for (int i = 0; i < 3; i++)
+    {
+        const Market& market = *arrMarket[i];
+        arrIEngine[i] = createEngine(market.strMarketCode, market.strType, market.dTickSize);
+        fillBook(arrIEngine[i], BENCH_IMPLIED_DEPTH, market.llMid, arrIEngine[i]->getMiniTick(), BENCH_QUANTITY);
+    }
+    OPNX::IEngine* pIEngine = arrIEngine[0];
+    OPNX::Implier implier(arrIEngine[1], arrIEngine[2], impliedType, pIEngine->getMiniTick(), pIEngine->getFactor());
+    pIEngine->setImplier(implier);
+    unsigned long long ullQuantity = 0;
+    for (unsigned long long i = 0; i < m_ullOps; i++)
+    {
+        unsigned long long ullBegin = beginTime();
+        if (bBook)
+        {
+            AskOrderBook askOrderBook;
+            BidOrderBook bidOrderBook;
+            pIEngine->getDisplayAskOrderBook(askOrderBook);
+            pIEngine->getDisplayBidOrderBook(bidOrderBook);
+            ullQuantity += askOrderBook.size() + bidOrderBook.size();
+        }
+        else
+        {
+            OPNX::OrderBookItem bestAskItem = pIEngine->getBestAsk();
+            OPNX::OrderBookItem bestBidItem = pIEngine->getBestBid(&bestAskItem);
+            ullQuantity += bestAskItem.quantity + bestBidItem.quantity;
+        }
+        endTime(ullBegin);
+    }
+    for (int i = 0; i < 3; i++)
+    {
+        arrIEngine[i]->releaseIEngine();
+    }
+    report(strName, {{"type", (int)impliedType}, {"market", arrMarket[0]->strType}, {"quantity", ullQuantity / m_ullOps}});
+}
+
+// A mark price that triggers the stop order of the first of ullDepth trigger prices, an order with the same trigger price is added again
+void Bench::benchTriggerFire(unsigned long long ullDepth)
+{
+    if (!isSelected("trigger_fire"))
+    {
+        return;
+    }
+    reset();
+    long long llTick = PRICE_FACTOR;
+    OPNX::ITriggerOrder* pITriggerOrder = createTriggerOrderManager("BTC-USD-SWAP-LIN");
+    auto newStopOrder = [&](long long llTriggerPrice) {
+        OPNX::Order order = newOrder(OPNX::Order::BUY, llTriggerPrice + llTick, BENCH_QUANTITY);
+        order.type = OPNX::Order::STOP_LIMIT;
+        order.triggerType = OPNX::Order::MARK_PRICE;
+        order.stopCondition = OPNX::Order::GREATER_EQUAL;
+        order.triggerPrice = llTriggerPrice;
+        return order;
+    };
+    for (unsigned long long ullLevel = 1; ullLevel <= ullDepth; ullLevel++)
+    {
+        OPNX::Order order = newStopOrder(MID_PRICE + ullLevel * llTick);
+        pITriggerOrder->handleOrder(order);
+    }
+    for (unsigned long long i = 0; i < m_ullOps; i++)
+    {
+        unsigned long long ullBegin = beginTime();
+        pITriggerOrder->markPriceTriggerOrder(MID_PRICE + llTick);
+        endTime(ullBegin);
+
+        OPNX::Order order = newStopOrder(MID_PRICE + llTick);
+        pITriggerOrder->handleOrder(order);
+    }
+    pITriggerOrder->releaseITriggerOrder();
+    report("trigger_fire", {{"depth", ullDepth}, {"triggered", m_ullTriggeredCount}});
+}
+
+// A mark price between the trigger prices of ullDepth buy stops above and ullDepth sell stops below, nothing is triggered
+void Bench::benchTriggerCheck(unsigned long long ullDepth)
+{
+    if (!isSelected("trigger_check"))
+    {
+        return;
+    }
+    reset();
+    long long llTick = PRICE_FACTOR;
+    OPNX::ITriggerOrder* pITriggerOrder = createTriggerOrderManager("BTC-USD-SWAP-LIN");
+    for (unsigned long long ullLevel = 1; ullLevel <= ullDepth; ullLevel++)
+    {
+        OPNX::Order buyOrder = newOrder(OPNX::Order::BUY, MID_PRICE + (ullLevel + 1) * llTick, BENCH_QUANTITY);
+        buyOrder.type = OPNX::Order::STOP_LIMIT;
+        buyOrder.triggerType = OPNX::Order::MARK_PRICE;
+        buyOrder.stopCondition = OPNX::Order::GREATER_EQUAL;
+        buyOrder.triggerPrice = MID_PRICE + ullLevel * llTick;
+        pITriggerOrder->handleOrder(buyOrder);
+
+        OPNX::Order sellOrder = newOrder(OPNX::Order::SELL, MID_PRICE - (ullLevel + 1) * llTick, BENCH_QUANTITY);
+        sellOrder.type = OPNX::Order::STOP_LIMIT;
+        sellOrder.triggerType = OPNX::Order::MARK_PRICE;
+        sellOrder.stopCondition = OPNX::Order::LESS_EQUAL;
+        sellOrder.triggerPrice = MID_PRICE - ullLevel * llTick;
+        pITriggerOrder->handleOrder(sellOrder);
+    }
+    for (unsigned long long i = 0; i < m_ullOps; i++)
+    {
+        long long llMarkPrice = MID_PRICE - llTick + 1 + m_random() % (2 * llTick - 1);
+        unsigned long long ullBegin = beginTime();
+        pITriggerOrder->markPriceTriggerOrder(llMarkPrice);
+        endTime(ullBegin);
+    }
+    pITriggerOrder->releaseITriggerOrder();
+    report("trigger_check", {{"depth", ullDepth}, {"triggered", m_ullTriggeredCount}});
+}
+
+// An order of the order topic parsed and converted as by the consumers of pulsar
+void Bench::benchDecode()
+{
+    if (!isSelected("decode"))
+    {
+        return;
+    }
+    reset();
+    std::vector<std::string> vecJsonOrder;
+    for (unsigned long long i = 0; i < BENCH_ORDER_COUNT; i++)
+    {
+        OPNX::Order order = newOrder(0 == m_random() % 2 ? OPNX::Order::BUY : OPNX::Order::SELL, MID_PRICE + (long long)(m_random() % 10000) - 5000, m_random() % 1000 + 1);
+        order.clientOrderId = m_random();
+        order.timestamp = 1700000000000 + m_random() % 1000000;
+        std::string strJsonOrder = "";
+        OPNX::Order::orderToJsonString(order, strJsonOrder);
+        vecJsonOrder.push_back(strJsonOrder);
+    }
+    unsigned long long ullQuantity = 0;
+    for (unsigned long long i = 0; i < m_ullOps; i++)
+    {
+        const std::string& strJsonOrder = vecJsonOrder[i % vecJsonOrder.size()];
+        unsigned long long ullBegin = beginTime();
+        rapidjson::Document document;
+        document.Parse(strJsonOrder.c_str());
+        OPNX::Order order;
+        OPNX::Order::rapidjsonToOrder(document, order);
+        endTime(ullBegin);
+        ullQuantity += order.quantity;
+    }
+    report("decode", {{"quantity", ullQuantity}});
+}
+
+// An order converted to the json of a report
+void Bench::benchEncode()
+{
+    if (!isSelected("encode"))
+    {
+        return;
+    }
+    reset();
+    std::vector<OPNX::Order> vecOrder;
+    for (unsigned long long i = 0; i < BENCH_ORDER_COUNT; i++)
+    {
+        OPNX::Order order = newOrder(0 == m_random() % 2 ? OPNX::Order::BUY : OPNX::Order::SELL, MID_PRICE + (long long)(m_random() % 10000) - 5000, m_random() % 1000 + 1);
+        order.clientOrderId = m_random();
+        order.timestamp = 1700000000000 + m_random() % 1000000;
+        order.remainQuantity = m_random() % order.quantity;
+        order.lastMatchQuantity = order.quantity - order.remainQuantity;
+        order.lastMatchPrice = order.price;
+        vecOrder.push_back(order);
+    }
+    unsigned long long ullLength = 0;
+    for (unsigned long long i = 0; i < m_ullOps; i++)
+    {
+        const OPNX::Order& order = vecOrder[i % vecOrder.size()];
+        unsigned long long ullBegin = beginTime();
+        std::string strJsonOrder = "";
+        OPNX::Order::orderToJsonString(order, strJsonOrder);
+        endTime(ullBegin);
+        ullLength += strJsonOrder.size();
+    }
+    report("encode", {{"length", ullLength / m_ullOps}});
+}
+
+// The diff of the order book of the manager after ullChanges levels changed, and the copy of the order book for the next diff
+void Bench::benchBookDiff(unsigned long long ullDepth, unsigned long long ullChanges)
+{
+    if (!isSelected("book_diff"))
+    {
+        return;
+    }
+    reset();
+    nlohmann::json jsonConfig = nlohmann::json::object();
+    Manager manager("", "BTC/USD", jsonConfig);
+    unsigned long long ullMarketId = ++m_ullMarketId;
+    long long llTick = PRICE_FACTOR;
+    AskOrderBook askOrderBook;
+    BidOrderBook bidOrderBook;
+    for (unsigned long long ullLevel = 1; ullLevel <= ullDepth; ullLevel++)
+    {
+        askOrderBook[MID_PRICE + ullLevel * llTick] = m_random() % 100 + 1;
+        bidOrderBook[MID_PRICE - ullLevel * llTick] = m_random() % 100 + 1;
+    }
+    manager.m_unmapAskOrderBook[ullMarketId] = askOrderBook;
+    manager.m_unmapBidOrderBook[ullMarketId] = bidOrderBook;
+    for (unsigned long long i = 0; i < m_ullOps; i++)
+    {
+        // a change removes a level, adds one or changes its quantity
+        for (unsigned long long ullChange = 0; ullChange < ullChanges; ullChange++)
+        {
+            long long llOffset = (m_random() % (ullDepth + ullDepth / 10) + 1) * llTick;
+            unsigned long long ullQuantity = (0 == m_random() % 4) ? 0 : m_random() % 100 + 1;
+            if (0 == m_random() % 2)
+            {
+                if (0 == ullQuantity)
+                {
+                    askOrderBook.erase(MID_PRICE + llOffset);
+                }
+                else
+                {
+                    askOrderBook[MID_PRICE + llOffset] = ullQuantity;
+                }
+            }
+            else
+            {
+                if (0 == ullQuantity)
+                {
+                    bidOrderBook.erase(MID_PRICE - llOffset);
+                }
+                else
+                {
+                    bidOrderBook[MID_PRICE - llOffset] = ullQuantity;
+                }
+            }
+        }
+        unsigned long long ullBegin = beginTime();
+        manager.sendOrderBookDiff(ullMarketId, "BTC-USD-SWAP-LIN", PRICE_FACTOR, 1, askOrderBook, bidOrderBook, i + 1);
+        manager.m_unmapAskOrderBook[ullMarketId] = askOrderBook;
+        manager.m_unmapBidOrderBook[ullMarketId] = bidOrderBook;
+        endTime(ullBegin);
+    }
+    report("book_diff", {{"depth", ullDepth}, {"changes", ullChanges}});
+}
+
+// The snapshot of the order book of the manager, one level changes between two snapshots
+void Bench::benchBookSnapshot(unsigned long long ullDepth)
+{
+    if (!isSelected("book_snapshot"))
+    {
+        return;
+    }
+    reset();
+    nlohmann::json jsonConfig = nlohmann::json::object();
+    Manager manager("", "BTC/USD", jsonConfig);
+    manager.m_iSnapshotLogCycle = std::numeric_limits<int>::max();   // without the log of every 100th snapshot
+    unsigned long long ullMarketId = ++m_ullMarketId;
+    long long llTick = PRICE_FACTOR;
+    AskOrderBook askOrderBook;
+    BidOrderBook bidOrderBook;
+    for (unsigned long long ullLevel = 1; ullLevel <= ullDepth; ullLevel++)
+    {
+        askOrderBook[MID_PRICE + ullLevel * llTick] = m_random() % 100 + 1;
+        bidOrderBook[MID_PRICE - ullLevel * llTick] = m_random() % 100 + 1;
+    }
+    for (unsigned long long i = 0; i < m_ullOps; i++)
+    {
+        long long llOffset = (m_random() % ullDepth + 1) * llTick;
+        if (0 == m_random() % 2)
+        {
+            askOrderBook[MID_PRICE + llOffset] = m_random() % 100 + 1;
+        }
+        else
+        {
+            bidOrderBook[MID_PRICE - llOffset] = m_random() % 100 + 1;
+        }
+        unsigned long long ullBegin = beginTime();
+        manager.sendOrderBookSnapshot(ullMarketId, "BTC-USD-SWAP-LIN", PRICE_FACTOR, 1, askOrderBook, bidOrderBook, i + 1);
+        endTime(ullBegin);
+    }
+    report("book_snapshot", {{"depth", ullDepth}});
+}
+
+// The copy and hash of Manager::takeSnapshot of one market with ullDepth orders on each side and ullDepth stop orders,
+// the orders in and the trigger orders of all the markets wait for it
+void Bench::benchEngineSnapshot(unsigned long long ullDepth)
+{
+    if (!isSelected("engine_snapshot"))
+    {
+        return;
+    }
+    reset();
+    long long llTick = PRICE_FACTOR;
+    OPNX::IEngine* pIEngine = createEngine("BTC-USD-SWAP-LIN", "PERP", 1.0);
+    OPNX::ITriggerOrder* pITriggerOrder = createTriggerOrderManager("BTC-USD-SWAP-LIN");
+    fillBook(pIEngine, ullDepth, MID_PRICE, llTick, BENCH_QUANTITY);
+    for (unsigned long long ullLevel = 1; ullLevel <= ullDepth; ullLevel++)
+    {
+        OPNX::Order order = newOrder(OPNX::Order::BUY, MID_PRICE + (ullLevel + 1) * llTick, BENCH_QUANTITY);
+        order.type = OPNX::Order::STOP_LIMIT;
+        order.triggerType = OPNX::Order::MARK_PRICE;
+        order.stopCondition = OPNX::Order::GREATER_EQUAL;
+        order.triggerPrice = MID_PRICE + ullLevel * llTick;
+        pITriggerOrder->handleOrder(order);
+    }
+    unsigned long long ullOps = std::min(m_ullOps, BENCH_SNAPSHOT_OPS);
+    unsigned long long ullHash = 0;
+    for (unsigned long long i = 0; i < ullOps; i++)
+    {
+        std::vector<OPNX::MarketSnapshot> vecMarket(1);
+        unsigned long long ullBegin = beginTime();
+        pIEngine->getSnapshot(vecMarket[0]);
+        pITriggerOrder->getSnapshot(vecMarket[0]);
+        ullHash = OPNX::Snapshot::hash(vecMarket);
+        endTime(ullBegin);
+    }
+    pITriggerOrder->releaseITriggerOrder();
+    pIEngine->releaseIEngine();
+    report("engine_snapshot", {{"depth", ullDepth}, {"hash", ullHash}});
+}
+
+bool Bench::isSelected(const std::string& strName)
+{
+    return m_strFilter.empty() || std::string::npos != strName.find(m_strFilter);
+}
+
+void Bench::reset()
+{
+    m_random.seed(m_ullSeed);
+    m_ullReportCount = 0;
+    m_ullTriggeredCount = 0;
+    m_vecLatency.clear();
+    m_vecLatency.reserve(m_ullOps);
+}
+
+void Bench::report(const std::string& strName, const nlohmann::json& jsonParams)
+{
+    std::sort(m_vecLatency.begin(), m_vecLatency.end());
+    auto percentile = [&](double dPercent) -> unsigned long long {
+        if (m_vecLatency.empty())
+        {
+            return 0;
+        }
+        size_t index = std::min(m_vecLatency.size() - 1, (size_t)(dPercent / 100 * m_vecLatency.size()));
+        return m_vecLatency[index];
+    };
+    unsigned long long ullTotal = 0;
+    for (auto ullLatency: m_vecLatency)
+    {
+        ullTotal += ullLatency;
+    }
+    nlohmann::json jsonResult;
+    jsonResult["bench"] = strName;
+    for (auto it = jsonParams.begin(); jsonParams.end() != it; it++)
+    {
+        jsonResult[it.key()] = it.value();
+    }
+    jsonResult["seed"] = m_ullSeed;
+    jsonResult["ops"] = m_vecLatency.size();
+    jsonResult["reports"] = m_ullReportCount;
+    jsonResult["nsPerOp"] = m_vecLatency.empty() ? 0.0 : (double)ullTotal / m_vecLatency.size();
+    jsonResult["p50"] = percentile(50);
+    jsonResult["p90"] = percentile(90);
+    jsonResult["p99"] = percentile(99);
+    jsonResult["p999"] = percentile(99.9);
+    jsonResult["max"] = percentile(100);
+    printf("%s\n", jsonResult.dump().c_str());
+    fflush(stdout);
+}
+
+nlohmann::json Bench::getMarketInfo(const std::string& strMarketCode, const std::string& strType, double dTickSize)
+{
+    nlohmann::json jsonMarketInfo;
+    jsonMarketInfo["marketCode"] = strMarketCode;
+    jsonMarketInfo["type"] = strType;
+    jsonMarketInfo["referencePair"] = "BTC/USD";
+    jsonMarketInfo["marketId"] = ++m_ullMarketId;
+    jsonMarketInfo["factor"] = PRICE_FACTOR;
+    jsonMarketInfo["qtyFactor"] = 1;
+    jsonMarketInfo["makerFee"] = 0;
+    jsonMarketInfo["tickSize"] = dTickSize;
+    jsonMarketInfo["qtyIncrement"] = 1.0;
+    return jsonMarketInfo;
+}
+
+OPNX::IEngine* Bench::createEngine(const std::string& strMarketCode, const std::string& strType, double dTickSize)
+{
+    return createIEngine(getMarketInfo(strMarketCode, strType, dTickSize), (OPNX::ICallbackManager*)this);
+}
+
+OPNX::ITriggerOrder* Bench::createTriggerOrderManager(const std::string& strMarketCode)
+{
+    return createTriggerOrder(getMarketInfo(strMarketCode, "PERP", 1.0), (OPNX::ICallbackManager*)this);
+}
+
+OPNX::Order Bench::newOrder(OPNX::Order::OrderSide side, long long llPrice, unsigned long long ullQuantity)
+{
+    OPNX::Order order;
+    order.action = OPNX::Order::NEW;
+    order.type = OPNX::Order::LIMIT;
+    order.timeCondition = OPNX::Order::GTC;
+    order.side = side;
+    order.price = llPrice;
+    order.quantity = ullQuantity;
+    order.displayQuantity = ullQuantity;
+    order.remainQuantity = ullQuantity;
+    order.accountId = 1;
+    order.marketId = m_ullMarketId;
+    order.orderId = ++m_ullOrderId;
+    return order;
+}
+
+void Bench::fillBook(OPNX::IEngine* pIEngine, unsigned long long ullDepth, long long llMid, long long llTick, unsigned long long ullQuantity,
+                     std::vector<unsigned long long>* pVecOrderId)
+{
+    for (unsigned long long ullLevel = 1; ullLevel <= ullDepth; ullLevel++)
+    {
+        OPNX::Order bidOrder = newOrder(OPNX::Order::BUY, llMid - ullLevel * llTick, ullQuantity);
+        bidOrder.marketId = pIEngine->getMarketId();
+        pIEngine->handleOrder(bidOrder);
+        OPNX::Order askOrder = newOrder(OPNX::Order::SELL, llMid + ullLevel * llTick, ullQuantity);
+        askOrder.marketId = pIEngine->getMarketId();
+        pIEngine->handleOrder(askOrder);
+        if (nullptr != pVecOrderId)
+        {
+            pVecOrderId->push_back(bidOrder.orderId);
+            pVecOrderId->push_back(askOrder.orderId);
+        }
+    }
+}
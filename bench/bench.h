@@ -0,0 +1,95 @@
+#ifndef MATCHING_ENGINE_BENCH_H
+#define MATCHING_ENGINE_BENCH_H
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include "common.h"
+#include "IEngine.h"
+#include "ITriggerOrder.h"
+#include "json.hpp"
+#include "order.h"
+#include "utils.h"
+
+// Micro benchmarks of the hot paths of the engine, the trigger order manager and the manager.
+// Each case prints one json line: {"bench", the parameters of the case, "seed", "ops", "nsPerOp", "p50", "p90", "p99", "p999", "max"},
+// the percentiles are the nano seconds of a single operation. The orders, prices and changes of a case come from
+// std::mt19937_64 seeded with the seed of the run and the ids from the fixed globals of main.cpp, so two runs with the
+// same seed do the same work and their lines can be compared to see the regression of a change.
+// Everything runs on the calling thread, the book is restored between two operations outside of the measured time.
+class Bench: public OPNX::ICallbackManager {
+public:
+    Bench(unsigned long long ullSeed, unsigned long long ullOps, const std::string& strFilter)
+    : m_ullSeed(ullSeed)
+    , m_ullOps(ullOps)
+    , m_strFilter(strFilter)
+    , m_ullMarketId(0)
+    , m_ullOrderId(0)
+    , m_ullReportCount(0)
+    , m_ullTriggeredCount(0){};
+    virtual ~Bench(){};
+
+public:
+    // ICallbackManager, the reports are only counted
+    virtual void pulsarOrder(const OPNX::Order& order){ m_ullReportCount++; }
+    virtual void pulsarOrderList(const std::vector<OPNX::Order>& orders){ m_ullReportCount += orders.size(); }
+    virtual void triggerOrderToEngine(const OPNX::Order& order){ m_ullTriggeredCount++; }
+    virtual void triggerOrderListToEngine(const std::vector<OPNX::Order>& orders){ m_ullTriggeredCount += orders.size(); }
+    virtual void engineOrderToTrigger(const OPNX::Order& order){}
+    virtual void bestOrderBookChange(){}
+    virtual void orderStore(OPNX::Order* pOrder){}
+
+public:
+    // Runs the cases whose name contains the filter, all of them with an empty filter
+    void run();
+
+private:
+    void benchAdd(unsigned long long ullDepth);
+    void benchCancel(unsigned long long ullDepth);
+    void benchAmend(unsigned long long ullDepth);
+    void benchAmendPrice(unsigned long long ullDepth);
+    void benchSweep(unsigned long long ullLevels);
+    void benchIceberg(unsigned long long ullDepth);
+    void benchFok(unsigned long long ullDepth, bool bFill);
+    void benchImplied(OPNX::Implier::ImpliedType impliedType, bool bBook);
+    void benchTriggerFire(unsigned long long ullDepth);
+    void benchTriggerCheck(unsigned long long ullDepth);
+    void benchDecode();
+    void benchEncode();
+    void benchBookDiff(unsigned long long ullDepth, unsigned long long ullChanges);
+    void benchBookSnapshot(unsigned long long ullDepth);
+    void benchEngineSnapshot(unsigned long long ullDepth);
+
+    bool isSelected(const std::string& strName);
+    // Same random sequence and counters at the begin of each case
+    void reset();
+    void report(const std::string& strName, const nlohmann::json& jsonParams);
+
+    OPNX::IEngine* createEngine(const std::string& strMarketCode, const std::string& strType, double dTickSize);
+    OPNX::ITriggerOrder* createTriggerOrderManager(const std::string& strMarketCode);
+    nlohmann::json getMarketInfo(const std::string& strMarketCode, const std::string& strType, double dTickSize);
+    OPNX::Order newOrder(OPNX::Order::OrderSide side, long long llPrice, unsigned long long ullQuantity);
+    // ullDepth orders on each side, one for each tick: the bids from llMid - llTick down, the asks from llMid + llTick up
+    void fillBook(OPNX::IEngine* pIEngine, unsigned long long ullDepth, long long llMid, long long llTick, unsigned long long ullQuantity,
+                  std::vector<unsigned long long>* pVecOrderId = nullptr);
+
+    inline unsigned long long beginTime() { return OPNX::Utils::getNanoTimestamp(); }
+    inline void endTime(unsigned long long ullBegin) { m_vecLatency.push_back(OPNX::Utils::getNanoTimestamp() - ullBegin); }
+
+private:
+    static const long long PRICE_FACTOR = 100;     // factor of the markets of the benchmarks
+    static const long long MID_PRICE = 3000000;    // 30000.00
+
+    unsigned long long m_ullSeed;
+    unsigned long long m_ullOps;
+    std::string m_strFilter;
+    std::mt19937_64 m_random;
+    unsigned long long m_ullMarketId;
+    unsigned long long m_ullOrderId;
+    unsigned long long m_ullReportCount;
+    unsigned long long m_ullTriggeredCount;
+    std::vector<unsigned long long> m_vecLatency;  // nano seconds of each operation of the current case
+};
+
+#endif //MATCHING_ENGINE_BENCH_H
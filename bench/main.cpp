@@ -0,0 +1,73 @@
+#include <string>
+#include <cstdlib>
+
+#include "bench.h"
+#include "log.h"
+#include "utils.h"
+#include "global.h"
+
+
+// init global variables of global.h
+unsigned long long g_ullPerpMarketId = 0;
+long long g_llPerpMarkPrice = 0;
+unsigned long long g_ullRepoMarketId = 0;
+
+// init global variables of utils.h, fixed values so that two runs give the same ids
+std::atomic<unsigned long long> g_ullSortId(10000);
+std::atomic<unsigned long long> g_ullMatchId(10000);
+std::atomic<unsigned long long> g_ullSequenceNumber(10000);
+unsigned long long g_ullNodeId = 0;
+
+CallBackPulsarLog pulsarLog = [](const std::string& strLog) {};
+OPNX::Log cfLog(OPNX::Log::ERROR, pulsarLog);
+
+static void usage(const char* pszName)
+{
+    // one std::endl, the log prints its buffer on each flush
+    cfLog.printInfo() << "usage: " << pszName << " [--seed n] [--ops n] [--filter name] [--log level]\n"
+                      << "  --seed    seed of the orders and prices, the default is 1\n"
+                      << "  --ops     measured operations of each case, the default is 20000\n"
+                      << "  --filter  only the cases whose name contains name\n"
+                      << "  prints one json line for each case, the latencies are nano seconds" << std::endl;
+}
+
+int main(int iArgc, char** pszArgv) {
+
+    unsigned long long ullSeed = 1;
+    unsigned long long ullOps = 20000;
+    std::string strFilter = "";
+    for (int i = 1; i < iArgc; i++)
+    {
+        std::string strArg = pszArgv[i];
+        if ("--seed" == strArg && i + 1 < iArgc)
+        {
+            ullSeed = strtoull(pszArgv[++i], nullptr, 10);
+        }
+        else if ("--ops" == strArg && i + 1 < iArgc)
+        {
+            ullOps = strtoull(pszArgv[++i], nullptr, 10);
+        }
+        else if ("--filter" == strArg && i + 1 < iArgc)
+        {
+            strFilter = pszArgv[++i];
+        }
+        else if ("--log" == strArg && i + 1 < iArgc)
+        {
+            cfLog.setLogLevel((OPNX::Log::Level)atoi(pszArgv[++i]));
+        }
+        else
+        {
+            usage(pszArgv[0]);
+            return 1;
+        }
+    }
+    if (0 == ullOps)
+    {
+        usage(pszArgv[0]);
+        return 1;
+    }
+
+    Bench bench(ullSeed, ullOps, strFilter);
+    bench.run();
+    return 0;
+}
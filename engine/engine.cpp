@@ -2,6 +2,9 @@
 // Created by Bob   on 2021/12/24.
 //
 
+#include <algorithm>
+#include <cmath>
+
 #include "engine.h"
 #include "log.h"
 #include "global.h"
@@ -23,46 +26,25 @@ Engine::~Engine()
 
 void Engine::handleOrder(OPNX::Order& order)
 {
-    OPNX::CInOutLog cInOutLog("handleOrder");
+    OPNX_TRACE_SCOPE("handleOrder");
 
     try {
-        if (OPNX::Order::AUCTION == order.timeCondition)
+        if (!m_vecRecoveryOrder.empty() && OPNX::Order::RECOVERY != order.action && OPNX::Order::RECOVERY_END != order.action)
         {
-            unsigned long long  quantity = 0;
-            std::vector<OPNX::Order> vecCancelOrder;
-            auto it = m_unmapSearchOrder.begin();
-            while (it != m_unmapSearchOrder.end()) {
-                OPNX::Order oldOrder(it->second);
-                if (order.source == oldOrder.source) {
-                    order.side =  oldOrder.side;
-                    quantity += oldOrder.remainQuantity;
-                    oldOrder.status = OPNX::Order::CANCELED_BY_PRE_AUCTION;
-                    m_pCallbackManager->pulsarOrder(oldOrder);
-                    it = m_unmapSearchOrder.erase(it);
-
-                    OPNX::Order newOrder(oldOrder);
-                    newOrder.remainQuantity = 0;
-                    updateOrderBook(newOrder, oldOrder);
-                }
-                else
-                {
-                    it++;
-                }
-            }
-            order.quantity = quantity;
-            order.remainQuantity = quantity;
-            order.displayQuantity = order.quantity;
-            if (OPNX::Order::BUY == order.side)
+            // the order book must be complete before any other order is handled
+            loadRecoveryOrders();
+        }
+        if (OPNX::Order::AUCTION == order.timeCondition && OPNX::Order::NEW == order.action)
+        {
+            // Call phase: auction orders are collected without matching, they are uncrossed together.
+            // The sortId is the arrival of the order in the call phase.
+            if (m_vecAuctionOrder.empty())
             {
-                order.price = order.upperBound;
-            } else {
-                order.price = order.lowerBound;
-            }
-            if (0 == quantity) {
-                order.status = OPNX::Order::CANCELED_BY_NO_AUCTION;
-                m_pCallbackManager->pulsarOrder(order);
-                return;
+                m_ullAuctionCallTime = OPNX::Utils::getMilliTimestamp();
             }
+            order.sortId = OPNX::Utils::getSortId();
+            m_vecAuctionOrder.push_back(order);
+            return;
         }
         if (OPNX::Order::NEW == order.action)
         {
@@ -76,10 +58,29 @@ void Engine::handleOrder(OPNX::Order& order)
         {
             handleCancelOrder(order);
         }
+        else if (OPNX::Order::CANCEL_REPLACE == order.action)
+        {
+            handleCancelReplaceOrder(order);
+        }
         else if (OPNX::Order::RECOVERY == order.action)
         {
-            order.action = OPNX::Order::NEW;
-            saveToSearchOrder(order);
+            if (0 == order.sortId)
+            {
+                order.sortId = OPNX::Utils::getSortId();
+            }
+            m_vecRecoveryOrder.push_back(order);
+        }
+        else if (OPNX::Order::RECOVERY_END == order.action)
+        {
+            loadRecoveryOrders();
+        }
+        else if (OPNX::Order::AUCTION_UNCROSS == order.action)
+        {
+            // The call phase ends only with AUCTION_UNCROSS, see expireOrders
+            if (!m_vecAuctionOrder.empty())
+            {
+                uncrossAuction();
+            }
         }
         else
         {
@@ -92,15 +93,33 @@ void Engine::handleOrder(OPNX::Order& order)
 
 }
 
+// The orders triggered by one price, in their order with one notification of the best order book
+void Engine::handleOrderList(std::vector<OPNX::Order>& vecOrder)
+{
+    OPNX_TRACE_SCOPE(m_strMarketCode, "handleOrderList");
+    m_bDeferBestChange = true;
+    m_bBestChanged = false;
+    for (auto& order: vecOrder)
+    {
+        handleOrder(order);
+    }
+    m_bDeferBestChange = false;
+    if (m_bBestChanged)
+    {
+        m_bBestChanged = false;
+        m_pCallbackManager->bestOrderBookChange();
+    }
+}
+
 void Engine::handleNewOrder(OPNX::Order& order)
 {
-    OPNX::CInOutLog cInOutLog(m_strMarketCode + " handleNewOrder");
+    OPNX_TRACE_SCOPE(m_strMarketCode, "handleNewOrder");
 
     try {
         // handle FOK order
         if (OPNX::Order::FOK == order.timeCondition && 0 == order.amount)
         {
-            OPNX::CInOutLog cInOutLog(m_strMarketCode + " OPNX::Order::FOK == order.timeCondition");
+            OPNX_TRACE_SCOPE(m_strMarketCode, "OPNX::Order::FOK == order.timeCondition");
 
             OPNX::OrderBookItem bestAskItem;
             OPNX::OrderBookItem bestBidItem;
@@ -185,7 +204,7 @@ void Engine::handleNewOrder(OPNX::Order& order)
             ullMatchableQuantity = order.remainQuantity;
         }
 
-        cfLog.debug() << m_strMarketCode << " handleNewOrder: matching begin" << std::endl;
+        OPNX_LOG_DEBUG << m_strMarketCode << " handleNewOrder: matching begin" << std::endl;
 
         OPNX::SortOrderBook* pMakerOrders = nullptr;
         OPNX::OrderBookItem bestAskObItem;
@@ -249,7 +268,7 @@ void Engine::handleNewOrder(OPNX::Order& order)
                 }
             }
 
-            cfLog.debug() << m_strMarketCode << " handleNewOrder: ullMatchQuantity: " << ullMatchQuantity << ", bestObItem.price: " << bestObItem.price << std::endl;
+            OPNX_LOG_DEBUG << m_strMarketCode << " handleNewOrder: ullMatchQuantity: " << ullMatchQuantity << ", bestObItem.price: " << bestObItem.price << std::endl;
             if (0 >= ullMatchQuantity)
             {
                 break;
@@ -257,7 +276,7 @@ void Engine::handleNewOrder(OPNX::Order& order)
 
             if (nullptr == pImplier)
             {
-                OPNX::CInOutLog cInOutLog(m_strMarketCode + " handleNewOrder: nullptr == pImplier");
+                OPNX_TRACE_SCOPE(m_strMarketCode, "handleNewOrder: nullptr == pImplier");
                 // Because pMakerOrders may be deleted in the matchOrder() function, the for loop exit condition cannot be judged by pMakerOrders
                 while (0 < ullMatchQuantity)
                 {
@@ -272,13 +291,14 @@ void Engine::handleNewOrder(OPNX::Order& order)
                     }
                     if (nullptr != pMakerOrders && bestObItem.price == pMakerOrders->obItem.price)
                     {
-                        OPNX::CInOutLog cInOutLog(m_strMarketCode + " handleNewOrder: nullptr != pMakerOrders");
+                        OPNX_TRACE_SCOPE(m_strMarketCode, "handleNewOrder: nullptr != pMakerOrders");
                         unsigned long long ullMatchId = OPNX::Utils::getMatchId();
                         auto it = pMakerOrders->sortMapOrder.begin();
                         if (pMakerOrders->sortMapOrder.end() != it)
                         {
                             OPNX::Order* pMakerOrder = it->second;
 
+                            bool bOnlyOwnOrders = false;    // a FOK order skips its own orders, the rest of the level has none of the others
                             if (OPNX::Order::STP_NONE != order.selfTradeProtectionType)
                             {
                                 if (order.accountId == pMakerOrder->accountId)
@@ -290,6 +310,12 @@ void Engine::handleNewOrder(OPNX::Order& order)
                                                 // There is a statistics section on the transaction volume in front of the FOK order.
                                                 // If there is a self closing transaction after entering the matching cycle, it will be skipped
                                                 bIsSTP = true;
+                                                const OPNX::LevelAccountItem* pAccountItem = pMakerOrders->findAccount(order.accountId);
+                                                if (nullptr != pAccountItem && pAccountItem->orderCount >= pMakerOrders->sortMapOrder.size())
+                                                {
+                                                    bOnlyOwnOrders = true;  // the price level only has orders of the same account
+                                                    break;
+                                                }
                                                 do {
                                                     it++;
                                                     if (pMakerOrders->sortMapOrder.end() != it)
@@ -302,6 +328,7 @@ void Engine::handleNewOrder(OPNX::Order& order)
                                                 } while (order.accountId == pMakerOrder->accountId);
                                                 if (pMakerOrders->sortMapOrder.end() == it || order.accountId == pMakerOrder->accountId)
                                                 {
+                                                    bOnlyOwnOrders = true;
                                                     break;
                                                 }
                                             } else {
@@ -335,6 +362,12 @@ void Engine::handleNewOrder(OPNX::Order& order)
                                                 // There is a statistics section on the transaction volume in front of the FOK order.
                                                 // If there is a self closing transaction after entering the matching cycle, it will be skipped
                                                 bIsSTP = true;
+                                                const OPNX::LevelAccountItem* pAccountItem = pMakerOrders->findAccount(order.accountId);
+                                                if (nullptr != pAccountItem && pAccountItem->orderCount >= pMakerOrders->sortMapOrder.size())
+                                                {
+                                                    bOnlyOwnOrders = true;  // the price level only has orders of the same account
+                                                    break;
+                                                }
                                                 do {
                                                     it++;
                                                     if (pMakerOrders->sortMapOrder.end() != it)
@@ -347,6 +380,7 @@ void Engine::handleNewOrder(OPNX::Order& order)
                                                 } while (order.accountId == pMakerOrder->accountId);
                                                 if (pMakerOrders->sortMapOrder.end() == it || order.accountId == pMakerOrder->accountId)
                                                 {
+                                                    bOnlyOwnOrders = true;
                                                     break;
                                                 }
                                             } else {
@@ -376,6 +410,11 @@ void Engine::handleNewOrder(OPNX::Order& order)
                                     }
                                 }
                             }
+                            if (bOnlyOwnOrders)
+                            {
+                                // leave the level, the order never matches its own orders
+                                break;
+                            }
                             unsigned long long quantity = getOrderMatchableQuantity(pMakerOrder);
                             unsigned long long ullMinMatchQuantity = std::min(ullMatchQuantity, quantity);
                             if (0 < ullMinMatchQuantity)
@@ -436,7 +475,7 @@ void Engine::handleNewOrder(OPNX::Order& order)
             }
             else
             {
-                OPNX::CInOutLog cInOutLog(m_strMarketCode + " handleNewOrder: nullptr != pImplier");
+                OPNX_TRACE_SCOPE(m_strMarketCode, "handleNewOrder: nullptr != pImplier");
 
                 std::vector<OPNX::Order> *pVecMatchedOrder = &vecThirdMatchedOrder;
                 if (OPNX::Order::AUCTION == order.timeCondition)
@@ -452,7 +491,7 @@ void Engine::handleNewOrder(OPNX::Order& order)
                     cfLog.error() << "The quantity of matching before and after is inconsistent!!!" << std::endl;
                     break;  //
                 }
-                cfLog.debug() << m_strMarketCode << " handleNewOrder: implied: ullMatchQuantity: " << ullMatchQuantity << ", remainingQuantity: " << remainingQuantity << std::endl;
+                OPNX_LOG_DEBUG << m_strMarketCode << " handleNewOrder: implied: ullMatchQuantity: " << ullMatchQuantity << ", remainingQuantity: " << remainingQuantity << std::endl;
 
                 //Split group orders
                 if (OPNX::Order::AUCTION != order.timeCondition && m_iOrderGroupCount <= vecThirdMatchedOrder.size())
@@ -481,7 +520,7 @@ void Engine::handleNewOrder(OPNX::Order& order)
                 }
             }
         }
-        cfLog.debug() << m_strMarketCode << " handleNewOrder: matching end" << std::endl;
+        OPNX_LOG_DEBUG << m_strMarketCode << " handleNewOrder: matching end" << std::endl;
 //      bool bTriggerTrade = false;
 //      long long triggerLastPrice = order.lastMatchPrice;
         if (!vecMatchedOrder.empty())
@@ -612,7 +651,7 @@ void Engine::handleNewOrder(OPNX::Order& order)
 
 void Engine::handleCancelOrder(OPNX::Order& order)
 {
-    OPNX::CInOutLog cInOutLog(m_strMarketCode + " handleCancelOrder");
+    OPNX_TRACE_SCOPE(m_strMarketCode, "handleCancelOrder");
     try {
 
         if (0 != order.orderId)
@@ -630,7 +669,7 @@ void Engine::handleCancelOrder(OPNX::Order& order)
                 auto& oldOrder = it->second;
                 oldOrder.action = order.action;
                 oldOrder.source = order.source;
-                oldOrder.status = OPNX::Order::CANCELED_BY_USER;
+                oldOrder.status = OPNX::Order::CANCELED_BY_EXPIRY == order.status ? OPNX::Order::CANCELED_BY_EXPIRY : OPNX::Order::CANCELED_BY_USER;
                 strncpy(&oldOrder.tag[0], &order.tag[0], sizeof(order.tag));
                 memcpy(&order, &oldOrder, sizeof(OPNX::Order));
                 order.timestamp = OPNX::Utils::getMilliTimestamp();
@@ -681,7 +720,7 @@ void Engine::handleCancelOrder(OPNX::Order& order)
 }
 void Engine::handleAmendOrder(OPNX::Order& order)
 {
-    OPNX::CInOutLog cInOutLog(m_strMarketCode + " handleAmendOrder");
+    OPNX_TRACE_SCOPE(m_strMarketCode, "handleAmendOrder");
     try {
         auto it = m_unmapSearchOrder.find(order.orderId);
         if (m_unmapSearchOrder.end() == it)
@@ -748,6 +787,10 @@ void Engine::handleAmendOrder(OPNX::Order& order)
                 order.lastMatchedOrderId = oldOrder.lastMatchedOrderId;
                 order.lastMatchedOrderId2 = oldOrder.lastMatchedOrderId2;
                 order.source = oldOrder.source;
+                if (0 == order.expireTime)
+                {
+                    order.expireTime = oldOrder.expireTime;
+                }
                 strncpy(&oldOrder.tag[0], &order.tag[0], sizeof(order.tag));
 
                 oldOrder.status = OPNX::Order::CANCELED_BY_AMEND;
@@ -764,9 +807,509 @@ void Engine::handleAmendOrder(OPNX::Order& order)
         cfLog.fatal() << "Engine::handleAmendOrder exception!!!" << std::endl;
     }
 }
+// Cancel and replace in one engine step, the order keeps its orderId.
+// A quantity decrease at the same price keeps the queue position, and the match loop only runs if the new price crosses.
+void Engine::handleCancelReplaceOrder(OPNX::Order& order)
+{
+    OPNX_TRACE_SCOPE(m_strMarketCode, "handleCancelReplaceOrder");
+    try {
+        auto it = m_unmapSearchOrder.find(order.orderId);
+        if (m_unmapSearchOrder.end() == it)
+        {
+            order.remainQuantity = 0;
+            order.status = OPNX::Order::REJECT_AMEND_ORDER_ID_NOT_FOUND;
+            order.timestamp = OPNX::Utils::getMilliTimestamp();
+            m_pCallbackManager->pulsarOrder(order);
+            return;
+        }
+
+        OPNX::Order oldOrder(it->second);
+        long long remainQuantity = order.quantity - (oldOrder.quantity - oldOrder.remainQuantity);
+        if (0 >= remainQuantity)
+        {
+            OPNX::Order newOrder(oldOrder);
+            newOrder.remainQuantity = 0;
+            updateOrderBook(newOrder, oldOrder);
+            oldOrder.action = OPNX::Order::CANCEL_REPLACE;
+            oldOrder.status = OPNX::Order::CANCELED_BY_AMEND;
+            oldOrder.timestamp = OPNX::Utils::getMilliTimestamp();
+            m_pCallbackManager->pulsarOrder(oldOrder);
+            return;
+        }
+
+        OPNX::Order newOrder(oldOrder);
+        newOrder.price = order.price;
+        newOrder.quantity = order.quantity;
+        newOrder.displayQuantity = order.displayQuantity;
+        newOrder.remainQuantity = remainQuantity;
+        newOrder.status = OPNX::Order::OPEN;
+        strncpy(&newOrder.tag[0], &order.tag[0], sizeof(order.tag));
+
+        // an iceberg order keeps its queue position only when its visible tranche does not grow either,
+        // a displayQuantity of 0 shows the whole order
+        if (newOrder.price == oldOrder.price && newOrder.quantity <= oldOrder.quantity
+        && newOrder.displayQuantity <= oldOrder.displayQuantity && (0 != newOrder.displayQuantity || 0 == oldOrder.displayQuantity))
+        {
+            // keep the queue position
+            updateOrderBook(newOrder, oldOrder);
+            memcpy(&order, &newOrder, sizeof(OPNX::Order));
+            order.action = OPNX::Order::CANCEL_REPLACE;
+            order.timestamp = OPNX::Utils::getMilliTimestamp();
+            m_pCallbackManager->pulsarOrder(order);
+            return;
+        }
+
+        OPNX::Order cancelOrder(oldOrder);
+        cancelOrder.remainQuantity = 0;
+        updateOrderBook(cancelOrder, oldOrder);
+
+        memcpy(&order, &newOrder, sizeof(OPNX::Order));
+        order.action = OPNX::Order::CANCEL_REPLACE;
+        if (isCrossed(order))
+        {
+            handleNewOrder(order);
+        }
+        else
+        {
+            // the new price does not cross, the order goes to the back of its new price level without the match loop
+            order.timestamp = OPNX::Utils::getMilliTimestamp();
+            saveToSearchOrder(order);
+            m_pCallbackManager->pulsarOrder(order);
+        }
+    } catch (...) {
+        cfLog.fatal() << "Engine::handleCancelReplaceOrder exception!!!" << std::endl;
+    }
+}
+
+// A mass quote replaces all quotes of the account in this market.
+// Quotes are passive: a quote that would cross is canceled as MAKER_ONLY, quotes never match on entry.
+// Quotes are identified by orderId, a quote resting in the book keeps its priority if only its quantity is reduced.
+// A quote with zero quantity is only a placeholder, so an empty mass quote cancels all quotes of the account.
+void Engine::handleMassQuote(std::vector<OPNX::Order>& vecQuote)
+{
+    OPNX_TRACE_SCOPE(m_strMarketCode, "handleMassQuote");
+    if (vecQuote.empty())
+    {
+        return;
+    }
+    if (!m_vecRecoveryOrder.empty())
+    {
+        // as handleOrder, the quotes are diffed against the complete order book
+        loadRecoveryOrders();
+    }
+    try {
+        m_bDeferBestChange = true;
+        m_bBestChanged = false;
+
+        unsigned long long accountId = vecQuote[0].accountId;
+        unsigned long long timestamp = OPNX::Utils::getMilliTimestamp();
+        std::vector<OPNX::Order> vecReport;
+        std::vector<unsigned long long> vecQuoteId;
+        std::unordered_map<unsigned long long, OPNX::Order*> unmapNewQuote;   // key is orderId
+        for (auto& quote: vecQuote)
+        {
+            if (0 < quote.quantity)
+            {
+                unmapNewQuote.emplace(quote.orderId, &quote);
+            }
+        }
+
+        // cancel the quotes that are not in the new mass quote
+        auto itAccount = m_unmapAccountQuoteId.find(accountId);
+        if (m_unmapAccountQuoteId.end() != itAccount)
+        {
+            for (auto ullOrderId: itAccount->second)
+            {
+                auto it = m_unmapSearchOrder.find(ullOrderId);
+                if (m_unmapSearchOrder.end() == it || unmapNewQuote.end() != unmapNewQuote.find(ullOrderId))
+                {
+                    continue;
+                }
+                OPNX::Order oldOrder(it->second);
+                OPNX::Order newOrder(oldOrder);
+                newOrder.remainQuantity = 0;
+                updateOrderBook(newOrder, oldOrder);
+
+                oldOrder.action = OPNX::Order::MASS_QUOTE;
+                oldOrder.status = OPNX::Order::CANCELED_BY_USER;
+                oldOrder.timestamp = timestamp;
+                vecReport.push_back(oldOrder);
+            }
+        }
+
+        for (auto& quote: vecQuote)
+        {
+            if (0 == quote.quantity)
+            {
+                continue;
+            }
+            quote.timestamp = timestamp;
+            auto it = m_unmapSearchOrder.find(quote.orderId);
+            if (m_unmapSearchOrder.end() != it && accountId == it->second.accountId)
+            {
+                OPNX::Order oldOrder(it->second);
+                OPNX::Order newOrder(oldOrder);
+                long long remainQuantity = quote.quantity - (oldOrder.quantity - oldOrder.remainQuantity);
+                if (0 >= remainQuantity || isCrossed(quote))
+                {
+                    newOrder.remainQuantity = 0;
+                    updateOrderBook(newOrder, oldOrder);
+                    oldOrder.status = (0 >= remainQuantity) ? OPNX::Order::CANCELED_BY_AMEND : OPNX::Order::CANCELED_BY_MAKER_ONLY;
+                    oldOrder.action = OPNX::Order::MASS_QUOTE;
+                    oldOrder.timestamp = timestamp;
+                    vecReport.push_back(oldOrder);
+                    continue;
+                }
+                newOrder.price = quote.price;
+                newOrder.quantity = quote.quantity;
+                newOrder.displayQuantity = quote.displayQuantity;
+                newOrder.remainQuantity = remainQuantity;
+                newOrder.status = OPNX::Order::OPEN;
+                strncpy(&newOrder.tag[0], &quote.tag[0], sizeof(quote.tag));
+                if (newOrder.price != oldOrder.price || newOrder.quantity != oldOrder.quantity || newOrder.displayQuantity != oldOrder.displayQuantity)
+                {
+                    updateOrderBook(newOrder, oldOrder);
+                }
+                newOrder.action = OPNX::Order::MASS_QUOTE;
+                newOrder.timestamp = timestamp;
+                vecReport.push_back(newOrder);
+            }
+            else if (isCrossed(quote))
+            {
+                quote.status = OPNX::Order::CANCELED_BY_MAKER_ONLY;
+                vecReport.push_back(quote);
+                continue;
+            }
+            else
+            {
+                quote.remainQuantity = quote.quantity;
+                quote.status = OPNX::Order::OPEN;
+                quote.action = OPNX::Order::NEW;
+                saveToSearchOrder(quote);
+                quote.action = OPNX::Order::MASS_QUOTE;
+                vecReport.push_back(quote);
+            }
+            vecQuoteId.push_back(quote.orderId);
+        }
+
+        if (vecQuoteId.empty())
+        {
+            m_unmapAccountQuoteId.erase(accountId);
+        }
+        else
+        {
+            m_unmapAccountQuoteId[accountId] = std::move(vecQuoteId);
+        }
+
+        // one report for the whole mass quote
+        if (!vecReport.empty())
+        {
+            m_pCallbackManager->pulsarOrderList(vecReport);
+        }
+    } catch (const std::exception &e) {
+        cfLog.error() << "Engine::handleMassQuote exception: " << e.what() << std::endl;
+    } catch (...) {
+        cfLog.fatal() << "Engine::handleMassQuote exception!!!" << std::endl;
+    }
+    m_bDeferBestChange = false;
+    if (m_bBestChanged)
+    {
+        m_bBestChanged = false;
+        m_pCallbackManager->bestOrderBookChange();
+    }
+}
+
+void Engine::uncrossAuction()
+{
+    OPNX_TRACE_SCOPE(m_strMarketCode, "uncrossAuction");
+    try {
+        pullAuctionOrders();
+
+        std::vector<OPNX::Order> vecMatchedOrder;
+        long long llAuctionPrice = 0;
+        unsigned long long ullAuctionVolume = 0;
+        if (getAuctionPrice(llAuctionPrice, ullAuctionVolume))
+        {
+            cfLog.info() << m_strMarketCode << " uncrossAuction: auction price: " << llAuctionPrice << ", volume: " << ullAuctionVolume
+                         << ", auction orders: " << m_vecAuctionOrder.size() << std::endl;
+            std::vector<OPNX::Order*> vecBuyOrder;
+            std::vector<OPNX::Order*> vecSellOrder;
+            getAuctionOrders<OPNX::OrderBookDescendMap>(vecBuyOrder, m_bidOrderBook, OPNX::Order::BUY, llAuctionPrice);
+            getAuctionOrders<OPNX::OrderBookAscendMap>(vecSellOrder, m_askOrderBook, OPNX::Order::SELL, llAuctionPrice);
+
+            size_t iBuy = 0;
+            size_t iSell = 0;
+            unsigned long long ullRemainVolume = ullAuctionVolume;
+            while (0 < ullRemainVolume && iBuy < vecBuyOrder.size() && iSell < vecSellOrder.size())
+            {
+                OPNX::Order* pBuyOrder = vecBuyOrder[iBuy];
+                OPNX::Order* pSellOrder = vecSellOrder[iSell];
+                unsigned long long ullMatchQuantity = std::min(std::min(pBuyOrder->remainQuantity, pSellOrder->remainQuantity), ullRemainVolume);
+                // A resting order is erased from the book when it is filled, so check it before matching
+                bool bBuyFilled = ullMatchQuantity == pBuyOrder->remainQuantity;
+                bool bSellFilled = ullMatchQuantity == pSellOrder->remainQuantity;
+                unsigned long long ullMatchId = OPNX::Utils::getMatchId();
+
+                if (OPNX::Order::AUCTION == pBuyOrder->timeCondition && OPNX::Order::AUCTION == pSellOrder->timeCondition)
+                {
+                    // the later auction order is the taker
+                    if (pBuyOrder->sortId > pSellOrder->sortId)
+                    {
+                        matchAuctionOrder(vecMatchedOrder, *pBuyOrder, *pSellOrder, llAuctionPrice, ullMatchQuantity, ullMatchId);
+                    }
+                    else
+                    {
+                        matchAuctionOrder(vecMatchedOrder, *pSellOrder, *pBuyOrder, llAuctionPrice, ullMatchQuantity, ullMatchId);
+                    }
+                }
+                else if (OPNX::Order::AUCTION == pBuyOrder->timeCondition)
+                {
+                    matchOrder(vecMatchedOrder, *pBuyOrder, pSellOrder, llAuctionPrice, ullMatchQuantity, ullMatchId, nullptr, true, m_bIsRepo);
+                }
+                else
+                {
+                    matchOrder(vecMatchedOrder, *pSellOrder, pBuyOrder, llAuctionPrice, ullMatchQuantity, ullMatchId, nullptr, true, m_bIsRepo);
+                }
+                ullRemainVolume -= ullMatchQuantity;
+                if (bBuyFilled)
+                {
+                    iBuy++;
+                }
+                if (bSellFilled)
+                {
+                    iSell++;
+                }
+            }
+            // all trades of the auction are at the auction price
+            for (auto& matchedOrder: vecMatchedOrder)
+            {
+                matchedOrder.lastMatchPrice = llAuctionPrice;
+            }
+        }
+        if (!vecMatchedOrder.empty())
+        {
+            m_pCallbackManager->pulsarOrderList(vecMatchedOrder);
+        }
+
+        unsigned long long timestamp = OPNX::Utils::getMilliTimestamp();
+        for (auto& auctionOrder: m_vecAuctionOrder)
+        {
+            if (0 == auctionOrder.quantity)
+            {
+                auctionOrder.status = OPNX::Order::CANCELED_BY_NO_AUCTION;
+            }
+            else if (0 == auctionOrder.remainQuantity)
+            {
+                continue;
+            }
+            else if (auctionOrder.quantity == auctionOrder.remainQuantity)
+            {
+                auctionOrder.status = OPNX::Order::CANCELED_ALL_BY_AUCTION;
+            }
+            else
+            {
+                auctionOrder.status = OPNX::Order::CANCELED_PARTIAL_BY_AUCTION;
+            }
+            auctionOrder.timestamp = timestamp;
+            m_pCallbackManager->pulsarOrder(auctionOrder);
+        }
+    } catch (const std::exception &e) {
+        cfLog.error() << "Engine::uncrossAuction exception: " << e.what() << std::endl;
+    } catch (...) {
+        cfLog.fatal() << "Engine::uncrossAuction exception!!!" << std::endl;
+    }
+    m_vecAuctionOrder.clear();
+}
+
+// Every auction order takes the resting orders with the same source, they are canceled from the book.
+// All sources are handled in one scan of the orders.
+void Engine::pullAuctionOrders()
+{
+    std::unordered_map<int, size_t> unmapSourceIndex;   // key is source, value is index of m_vecAuctionOrder
+    for (size_t i = 0; i < m_vecAuctionOrder.size(); i++)
+    {
+        m_vecAuctionOrder[i].quantity = 0;
+        unmapSourceIndex.emplace(m_vecAuctionOrder[i].source, i);
+    }
+
+    auto it = m_unmapSearchOrder.begin();
+    while (it != m_unmapSearchOrder.end())
+    {
+        auto itSource = unmapSourceIndex.find(it->second.source);
+        if (unmapSourceIndex.end() != itSource)
+        {
+            OPNX::Order& auctionOrder = m_vecAuctionOrder[itSource->second];
+            OPNX::Order oldOrder(it->second);
+            auctionOrder.side = oldOrder.side;
+            auctionOrder.quantity += oldOrder.remainQuantity;
+            oldOrder.status = OPNX::Order::CANCELED_BY_PRE_AUCTION;
+            m_pCallbackManager->pulsarOrder(oldOrder);
+            it = m_unmapSearchOrder.erase(it);
+
+            OPNX::Order newOrder(oldOrder);
+            newOrder.remainQuantity = 0;
+            updateOrderBook(newOrder, oldOrder);
+        }
+        else
+        {
+            it++;
+        }
+    }
+
+    for (auto& auctionOrder: m_vecAuctionOrder)
+    {
+        auctionOrder.remainQuantity = auctionOrder.quantity;
+        auctionOrder.displayQuantity = auctionOrder.quantity;
+        if (OPNX::Order::BUY == auctionOrder.side)
+        {
+            auctionOrder.price = auctionOrder.upperBound;
+        } else {
+            auctionOrder.price = auctionOrder.lowerBound;
+        }
+    }
+}
+
+// The auction price has the maximum executable volume, then the minimum imbalance.
+// If there is still a tie, a buy surplus takes the higher price and a sell surplus the lower price.
+bool Engine::getAuctionPrice(long long& llAuctionPrice, unsigned long long& ullAuctionVolume)
+{
+    // key is price, value is <buy quantity, sell quantity>
+    std::map<long long, std::pair<unsigned long long, unsigned long long>> mapAuctionLevel;
+    unsigned long long ullTotalBuy = 0;
+    unsigned long long ullMarketSell = 0;    // sell quantity without lower bound
+    long long llMaxBuyPrice = OPNX::Order::MIN_PRICE;
+    long long llMinSellPrice = OPNX::Order::MAX_PRICE;
+    for (auto& auctionOrder: m_vecAuctionOrder)
+    {
+        if (0 == auctionOrder.remainQuantity)
+        {
+            continue;
+        }
+        if (OPNX::Order::BUY == auctionOrder.side)
+        {
+            ullTotalBuy += auctionOrder.remainQuantity;
+            if (OPNX::Order::MAX_PRICE != auctionOrder.price)
+            {
+                mapAuctionLevel[auctionOrder.price].first += auctionOrder.remainQuantity;
+            }
+            llMaxBuyPrice = std::max(llMaxBuyPrice, auctionOrder.price);
+        }
+        else
+        {
+            if (OPNX::Order::MIN_PRICE != auctionOrder.price)
+            {
+                mapAuctionLevel[auctionOrder.price].second += auctionOrder.remainQuantity;
+            }
+            else
+            {
+                ullMarketSell += auctionOrder.remainQuantity;
+            }
+            llMinSellPrice = std::min(llMinSellPrice, auctionOrder.price);
+        }
+    }
+    // The book itself is not crossed, only the levels that can cross with auction orders take part
+    for (auto it = m_bidOrderBook.begin(); m_bidOrderBook.end() != it && it->first >= llMinSellPrice; it++)
+    {
+        ullTotalBuy += it->second.obItem.quantity;
+        mapAuctionLevel[it->first].first += it->second.obItem.quantity;
+    }
+    for (auto it = m_askOrderBook.begin(); m_askOrderBook.end() != it && it->first <= llMaxBuyPrice; it++)
+    {
+        mapAuctionLevel[it->first].second += it->second.obItem.quantity;
+    }
+
+    ullAuctionVolume = 0;
+    unsigned long long ullMinImbalance = 0;
+    unsigned long long ullLowerBuy = 0;           // buy quantity below the price
+    unsigned long long ullSell = ullMarketSell;   // sell quantity at or below the price
+    for (auto& auctionLevel: mapAuctionLevel)
+    {
+        unsigned long long ullBuy = ullTotalBuy - ullLowerBuy;
+        ullSell += auctionLevel.second.second;
+        ullLowerBuy += auctionLevel.second.first;
+
+        unsigned long long ullVolume = std::min(ullBuy, ullSell);
+        unsigned long long ullImbalance = ullBuy > ullSell ? ullBuy - ullSell : ullSell - ullBuy;
+        if (0 == ullVolume)
+        {
+            continue;
+        }
+        if (ullVolume > ullAuctionVolume || (ullVolume == ullAuctionVolume && ullImbalance < ullMinImbalance))
+        {
+            ullAuctionVolume = ullVolume;
+            ullMinImbalance = ullImbalance;
+            llAuctionPrice = auctionLevel.first;
+        }
+        else if (ullVolume == ullAuctionVolume && ullImbalance == ullMinImbalance && ullBuy > ullSell)
+        {
+            llAuctionPrice = auctionLevel.first;
+        }
+    }
+    return 0 < ullAuctionVolume;
+}
+
+// Executable orders of one side in price-time priority, resting orders are ahead of auction orders at the same price
+template<class SortOrderBookMap>
+void Engine::getAuctionOrders(std::vector<OPNX::Order*>& vecOrder, SortOrderBookMap& sortOrderBookMap, OPNX::Order::OrderSide side, long long llAuctionPrice)
+{
+    typename SortOrderBookMap::key_compare isBetter;
+    std::vector<OPNX::Order*> vecAuctionOrder;
+    for (auto& auctionOrder: m_vecAuctionOrder)
+    {
+        if (side == auctionOrder.side && 0 < auctionOrder.remainQuantity && !isBetter(llAuctionPrice, auctionOrder.price))
+        {
+            vecAuctionOrder.push_back(&auctionOrder);
+        }
+    }
+    std::stable_sort(vecAuctionOrder.begin(), vecAuctionOrder.end(), [&isBetter](const OPNX::Order* pLeft, const OPNX::Order* pRight) {
+        return isBetter(pLeft->price, pRight->price);
+    });
+
+    auto itAuction = vecAuctionOrder.begin();
+    for (auto it = sortOrderBookMap.begin(); sortOrderBookMap.end() != it && !isBetter(llAuctionPrice, it->first); it++)
+    {
+        while (vecAuctionOrder.end() != itAuction && isBetter((*itAuction)->price, it->first))
+        {
+            vecOrder.push_back(*itAuction);
+            itAuction++;
+        }
+        for (auto& item: it->second.sortMapOrder)
+        {
+            vecOrder.push_back(item.second);
+        }
+    }
+    vecOrder.insert(vecOrder.end(), itAuction, vecAuctionOrder.end());
+}
+
+// Match two auction orders, neither of them is in the book
+void Engine::matchAuctionOrder(std::vector<OPNX::Order>& vecMatchedOrder, OPNX::Order& takerOrder, OPNX::Order& makerOrder,
+                               long long llMatchedPrice, unsigned long long ullMatchQuantity, unsigned long long ullMatchedId)
+{
+    unsigned long long timestamp = OPNX::Utils::getMilliTimestamp();
+    OPNX::Order* pOrders[2] = {&takerOrder, &makerOrder};
+    for (int i = 0; i < 2; i++)
+    {
+        OPNX::Order& order = *pOrders[i];
+        order.lastMatchQuantity = ullMatchQuantity;
+        order.lastMatchPrice = llMatchedPrice;
+        order.remainQuantity -= ullMatchQuantity;
+        order.matchedId = ullMatchedId;
+        order.lastMatchedOrderId = pOrders[1-i]->orderId;
+        order.lastMatchedOrderId2 = 0;
+        order.matchedType = (0 == i) ? OPNX::Order::TAKER : OPNX::Order::MAKER;
+        order.timestamp = timestamp;
+        if (m_bIsRepo)
+        {
+            order.leg2Price = g_llPerpMarkPrice;
+        }
+        order.status = (0 < order.remainQuantity) ? OPNX::Order::PARTIAL_FILL : OPNX::Order::FILLED;
+        vecMatchedOrder.push_back(order);
+    }
+}
+
 inline OPNX::Order* Engine::saveToSearchOrder(OPNX::Order& order)
 {
-    OPNX::CInOutLog cInOutLog(m_strMarketCode + " saveToSearchOrder");
+    OPNX_TRACE_SCOPE(m_strMarketCode, "saveToSearchOrder");
 
     OPNX::Order* pOrder = nullptr;
     try {
@@ -775,6 +1318,7 @@ inline OPNX::Order* Engine::saveToSearchOrder(OPNX::Order& order)
         if (item.second)
         {
             saveNewOrder(pOrder);
+            addToExpiryWheel(*pOrder);
         }
         else
         {
@@ -787,6 +1331,127 @@ inline OPNX::Order* Engine::saveToSearchOrder(OPNX::Order& order)
     }
     return pOrder;
 }
+inline void Engine::addToExpiryWheel(const OPNX::Order& order)
+{
+    if (OPNX::Order::GTT == order.timeCondition && 0 < order.expireTime)
+    {
+        m_expiryWheel.add(order.expireTime, order.orderId);
+    }
+}
+
+// The wheel keeps the orderId of a GTT order until its expireTime, the orders filled or canceled before are skipped here.
+// The orders are not canceled here: the cancels go through the journal like the cancels of the users, so the replay of
+// the journal and the standby cancel the same orders at the same place.
+void Engine::expireOrders(unsigned long long ullNow, std::vector<OPNX::Order>& vecExpired)
+{
+    try {
+        m_expiryWheel.advance(ullNow, [this, ullNow, &vecExpired](unsigned long long ullOrderId) {
+            auto it = m_unmapSearchOrder.find(ullOrderId);
+            if (m_unmapSearchOrder.end() == it || OPNX::Order::GTT != it->second.timeCondition || ullNow < it->second.expireTime)
+            {
+                // gone, or amended with another expireTime that has its own entry
+                return;
+            }
+            OPNX::Order order;
+            order.orderId = it->second.orderId;
+            order.marketId = it->second.marketId;
+            order.accountId = it->second.accountId;
+            order.clientOrderId = it->second.clientOrderId;
+            order.action = OPNX::Order::CANCEL;
+            order.status = OPNX::Order::CANCELED_BY_EXPIRY;
+            order.timestamp = ullNow;
+            order.orderCreated = ullNow;
+            vecExpired.push_back(order);
+        });
+        if (!m_vecAuctionOrder.empty() && ullNow >= m_ullAuctionCallTime + m_ullAuctionCallMillis)
+        {
+            // the call phase is over
+            OPNX::Order order;
+            order.marketId = m_ullMarketId;
+            order.action = OPNX::Order::AUCTION_UNCROSS;
+            order.timestamp = ullNow;
+            order.orderCreated = ullNow;
+            vecExpired.push_back(order);
+        }
+    } catch (...) {
+        cfLog.fatal() << "Engine::expireOrders exception!!!" << std::endl;
+    }
+}
+
+// Recovered orders are sorted by price and sortId, so each price level is created once
+// and its orders are appended in time priority
+void Engine::loadRecoveryOrders()
+{
+    OPNX_TRACE_SCOPE(m_strMarketCode, "loadRecoveryOrders");
+    try {
+        if (m_vecRecoveryOrder.empty())
+        {
+            return;
+        }
+        std::sort(m_vecRecoveryOrder.begin(), m_vecRecoveryOrder.end(), [](const OPNX::Order& a, const OPNX::Order& b) {
+            if (a.side != b.side)
+            {
+                return OPNX::Order::BUY == a.side;
+            }
+            if (a.price != b.price)
+            {
+                return OPNX::Order::BUY == a.side ? a.price > b.price : a.price < b.price;
+            }
+            return a.sortId < b.sortId;
+        });
+        auto itAsk = std::find_if(m_vecRecoveryOrder.begin(), m_vecRecoveryOrder.end(), [](const OPNX::Order& order) {
+            return OPNX::Order::BUY != order.side;
+        });
+        // the recovered orders keep their sortIds, the new orders queue behind them
+        auto itMaxSortId = std::max_element(m_vecRecoveryOrder.begin(), m_vecRecoveryOrder.end(), [](const OPNX::Order& a, const OPNX::Order& b) {
+            return a.sortId < b.sortId;
+        });
+        OPNX::Utils::raiseSortId(itMaxSortId->sortId);
+
+        m_unmapSearchOrder.reserve(m_unmapSearchOrder.size() + m_vecRecoveryOrder.size());
+        {
+            OPNX::CAutoMutex autoMutex(m_spinMutexOrderBook);
+            loadPriceLevels(m_bidOrderBook, m_vecRecoveryOrder.begin(), itAsk);
+            loadPriceLevels(m_askOrderBook, itAsk, m_vecRecoveryOrder.end());
+        }
+        cfLog.info() << m_strMarketCode << " loadRecoveryOrders: " << m_vecRecoveryOrder.size() << ", unmapSearchOrder size: " << m_unmapSearchOrder.size()
+                     << ", asks size: " << m_askOrderBook.size() << ", bids size: " << m_bidOrderBook.size() << std::endl;
+        std::vector<OPNX::Order>().swap(m_vecRecoveryOrder);
+        notifyBestChange();
+    } catch (...) {
+        cfLog.fatal() << "Engine::loadRecoveryOrders exception!!!" << std::endl;
+    }
+}
+
+template<class SortOrderBookMap>
+void Engine::loadPriceLevels(SortOrderBookMap& sortOrderBookMap, std::vector<OPNX::Order>::iterator itBegin, std::vector<OPNX::Order>::iterator itEnd)
+{
+    auto itLevel = sortOrderBookMap.end();
+    for (auto it = itBegin; it != itEnd; it++)
+    {
+        it->action = OPNX::Order::NEW;
+        auto item = m_unmapSearchOrder.emplace(std::pair<unsigned long long, OPNX::Order>(it->orderId, *it));
+        if (!item.second)
+        {
+            logErrorOrder("loadPriceLevels order existed: ", *it);
+            continue;
+        }
+        OPNX::Order* pOrder = &(item.first->second);
+        if (sortOrderBookMap.end() == itLevel || itLevel->first != pOrder->price)
+        {
+            itLevel = sortOrderBookMap.find(pOrder->price);
+            if (sortOrderBookMap.end() == itLevel)
+            {
+                OPNX::SortOrderBook sortOrderBook;
+                sortOrderBook.obItem.price = pOrder->price;
+                itLevel = sortOrderBookMap.emplace_hint(sortOrderBookMap.end(), pOrder->price, std::move(sortOrderBook));
+            }
+        }
+        addToPriceLevel(itLevel->second, pOrder);
+        addToExpiryWheel(*pOrder);
+    }
+}
+
 void Engine::saveNewOrder(OPNX::Order* pOrder)
 {
     try {
@@ -798,48 +1463,28 @@ void Engine::saveNewOrder(OPNX::Order* pOrder)
             if (OPNX::Order::BUY == pOrder->side)
             {
                 auto it = m_bidOrderBook.find(pOrder->price);
-                if (m_bidOrderBook.end() != it)
-                {
-                    unsigned long long ullQuantity = getOrderMatchableQuantity(pOrder);
-                    it->second.obItem.quantity = it->second.obItem.quantity + pOrder->remainQuantity;
-                    it->second.obItem.displayQuantity = it->second.obItem.displayQuantity + ullQuantity;
-                    it->second.sortMapOrder.emplace(std::pair<unsigned long long, OPNX::Order*>(pOrder->sortId, pOrder));
-                }
-                else
+                if (m_bidOrderBook.end() == it)
                 {
-                    unsigned long long ullQuantity = getOrderMatchableQuantity(pOrder);
                     OPNX::SortOrderBook sortOrderBook;
                     sortOrderBook.obItem.price = pOrder->price;
-                    sortOrderBook.obItem.quantity = pOrder->remainQuantity;
-                    sortOrderBook.obItem.displayQuantity = ullQuantity;
-                    sortOrderBook.sortMapOrder.emplace(std::pair<unsigned long long, OPNX::Order*>(pOrder->sortId, pOrder));
-                    m_bidOrderBook.emplace(std::pair<long long, OPNX::SortOrderBook>(pOrder->price, std::move(sortOrderBook)));
+                    it = m_bidOrderBook.emplace(std::pair<long long, OPNX::SortOrderBook>(pOrder->price, std::move(sortOrderBook))).first;
                 }
+                addToPriceLevel(it->second, pOrder);
             }
             else if (OPNX::Order::SELL == pOrder->side)
             {
                 auto it = m_askOrderBook.find(pOrder->price);
-                if (m_askOrderBook.end() != it)
+                if (m_askOrderBook.end() == it)
                 {
-                    unsigned long long ullQuantity = getOrderMatchableQuantity(pOrder);
-                    it->second.obItem.quantity = it->second.obItem.quantity + pOrder->remainQuantity;
-                    it->second.obItem.displayQuantity = it->second.obItem.displayQuantity + ullQuantity;
-                    it->second.sortMapOrder.emplace(std::pair<unsigned long long, OPNX::Order*>(pOrder->sortId, pOrder));
-                }
-                else
-                {
-                    unsigned long long ullQuantity = getOrderMatchableQuantity(pOrder);
                     OPNX::SortOrderBook sortOrderBook;
                     sortOrderBook.obItem.price = pOrder->price;
-                    sortOrderBook.obItem.quantity = pOrder->remainQuantity;
-                    sortOrderBook.obItem.displayQuantity = ullQuantity;
-                    sortOrderBook.sortMapOrder.emplace(std::pair<unsigned long long, OPNX::Order*>(pOrder->sortId, pOrder));
-                    m_askOrderBook.emplace(std::pair<long long, OPNX::SortOrderBook>(pOrder->price, std::move(sortOrderBook)));
+                    it = m_askOrderBook.emplace(std::pair<long long, OPNX::SortOrderBook>(pOrder->price, std::move(sortOrderBook))).first;
                 }
+                addToPriceLevel(it->second, pOrder);
             }
             if (bestChanged)
             {
-                m_pCallbackManager->bestOrderBookChange();
+                notifyBestChange();
             }
         }
     } catch (const std::exception &e) {
@@ -849,6 +1494,24 @@ void Engine::saveNewOrder(OPNX::Order* pOrder)
     }
 }
 
+// The order must carry the newest sortId, so it always goes to the tail of the FIFO.
+inline void Engine::addToPriceLevel(OPNX::SortOrderBook& sortOrderBook, OPNX::Order* pOrder)
+{
+    sortOrderBook.obItem.quantity += pOrder->remainQuantity;
+    sortOrderBook.obItem.displayQuantity += getOrderMatchableQuantity(pOrder);
+    sortOrderBook.addAccountOrder(pOrder->accountId, pOrder->remainQuantity);
+    sortOrderBook.sortMapOrder.emplace_hint(sortOrderBook.sortMapOrder.end(), pOrder->sortId, pOrder);
+}
+
+// Move an iceberg order whose visible tranche has just been refilled from its reserve to the tail of the FIFO.
+inline void Engine::requeueIcebergOrder(OPNX::SortOrderBook& sortOrderBook, OPNX::SortOrderMap::iterator itOrder)
+{
+    OPNX::Order* pOrder = itOrder->second;
+    sortOrderBook.sortMapOrder.erase(itOrder);
+    pOrder->sortId = OPNX::Utils::getSortId();
+    sortOrderBook.sortMapOrder.emplace_hint(sortOrderBook.sortMapOrder.end(), pOrder->sortId, pOrder);
+}
+
 inline void Engine::eraseFromSearchOrderMap(const OPNX::Order& order)
 {
     auto it = m_unmapSearchOrder.find(order.orderId);
@@ -858,6 +1521,30 @@ inline void Engine::eraseFromSearchOrderMap(const OPNX::Order& order)
     }
 }
 
+inline void Engine::notifyBestChange()
+{
+    if (m_bDeferBestChange)
+    {
+        m_bBestChanged = true;
+    }
+    else
+    {
+        m_pCallbackManager->bestOrderBookChange();
+    }
+}
+
+// Whether the order would match immediately on the own or implied book
+inline bool Engine::isCrossed(const OPNX::Order& order)
+{
+    OPNX::OrderBookItem bestAskItem = getBestAsk();
+    OPNX::OrderBookItem bestBidItem = getBestBid(&bestAskItem);
+    if (OPNX::Order::BUY == order.side)
+    {
+        return 0 < bestAskItem.quantity && bestAskItem.price <= order.price;
+    }
+    return 0 < bestBidItem.quantity && bestBidItem.price >= order.price;
+}
+
 inline bool Engine::checkBestChange(const OPNX::Order& order)
 {
     bool bestChanged = false;
@@ -915,7 +1602,7 @@ void Engine::updateOrderBook(const OPNX::Order& newOrder, const OPNX::Order& old
         }
         if (bestChanged)
         {
-            m_pCallbackManager->bestOrderBookChange();
+            notifyBestChange();
         }
 
     } catch (const std::exception &e) {
@@ -928,49 +1615,57 @@ void Engine::updateOrderBook(const OPNX::Order& newOrder, const OPNX::Order& old
 template<class SortOrderBookMap>
 void Engine::updateOrderBook(SortOrderBookMap& sortOrderBookMap, const OPNX::Order& newOrder, const OPNX::Order& oldOrder)
 {
-    OPNX::CInOutLog cInOutLog(m_strMarketCode + " updateOrderBook");
+    OPNX_TRACE_SCOPE(m_strMarketCode, "updateOrderBook");
     OPNX::CAutoMutex autoMutex(m_spinMutexOrderBook);
     try {
 
         auto itemOrderBook = sortOrderBookMap.find(oldOrder.price);
         if (sortOrderBookMap.end() != itemOrderBook)
         {
-            auto item = itemOrderBook->second.sortMapOrder.find(oldOrder.sortId);
-            if (itemOrderBook->second.sortMapOrder.end() != item)
+            OPNX::SortOrderBook& sortOrderBook = itemOrderBook->second;
+            auto item = sortOrderBook.sortMapOrder.find(oldOrder.sortId);
+            if (sortOrderBook.sortMapOrder.end() != item)
             {
                 unsigned long long ullOldQuantity = getOrderMatchableQuantity(&oldOrder);
                 if (0 == newOrder.remainQuantity)
                 {
-                    itemOrderBook->second.obItem.quantity -= oldOrder.remainQuantity;
-                    itemOrderBook->second.obItem.displayQuantity -= ullOldQuantity;
-                    itemOrderBook->second.sortMapOrder.erase(item);
+                    sortOrderBook.obItem.quantity -= oldOrder.remainQuantity;
+                    sortOrderBook.obItem.displayQuantity -= ullOldQuantity;
+                    sortOrderBook.eraseAccountOrder(oldOrder.accountId, oldOrder.remainQuantity);
+                    sortOrderBook.sortMapOrder.erase(item);
                     eraseFromSearchOrderMap(oldOrder);
                 }
                 else
                 {
-                    unsigned long long ullNewQuantity = getOrderMatchableQuantity(&newOrder);
                     if (newOrder.price == oldOrder.price && newOrder.quantity <= oldOrder.quantity)
                     {
-                        itemOrderBook->second.obItem.quantity -= (oldOrder.remainQuantity - newOrder.remainQuantity);
-                        itemOrderBook->second.obItem.displayQuantity -= (ullOldQuantity - ullNewQuantity);
+                        unsigned long long ullNewQuantity = getOrderMatchableQuantity(&newOrder);
+                        sortOrderBook.obItem.quantity = sortOrderBook.obItem.quantity - oldOrder.remainQuantity + newOrder.remainQuantity;
+                        sortOrderBook.obItem.displayQuantity = sortOrderBook.obItem.displayQuantity - ullOldQuantity + ullNewQuantity;
+                        sortOrderBook.updateAccountOrder(oldOrder.accountId, oldOrder.remainQuantity, newOrder.remainQuantity);
+
+                        // The visible tranche of an iceberg order is used up by a match and refilled from the reserve,
+                        // the refilled tranche loses its time priority.
+                        // Check it before memcpy, oldOrder may be the order in the book itself
+                        bool bRefilled = isIcebergOrder(oldOrder) && newOrder.quantity == oldOrder.quantity
+                                && ullOldQuantity <= oldOrder.remainQuantity - newOrder.remainQuantity;
 
                         OPNX::Order* pOrder = item->second;
                         memcpy(pOrder, &newOrder, sizeof(OPNX::Order));
-                        if (oldOrder.quantity >= oldOrder.displayQuantity && ullNewQuantity == newOrder.displayQuantity) // Iceberg order
+                        if (bRefilled)
                         {
-                            itemOrderBook->second.sortMapOrder.erase(item);
-                            pOrder->sortId = OPNX::Utils::getSortId();
-                            itemOrderBook->second.sortMapOrder.emplace(std::pair<unsigned long long, OPNX::Order*>(pOrder->sortId, pOrder));
+                            requeueIcebergOrder(sortOrderBook, item);
                         }
                     }
                     else
                     {
-                        itemOrderBook->second.obItem.quantity -= oldOrder.remainQuantity;
-                        itemOrderBook->second.obItem.displayQuantity -= ullOldQuantity;
+                        sortOrderBook.obItem.quantity -= oldOrder.remainQuantity;
+                        sortOrderBook.obItem.displayQuantity -= ullOldQuantity;
+                        sortOrderBook.eraseAccountOrder(oldOrder.accountId, oldOrder.remainQuantity);
 
                         OPNX::Order* pOrder = item->second;
                         memcpy(pOrder, &newOrder, sizeof(OPNX::Order));
-                        itemOrderBook->second.sortMapOrder.erase(item);
+                        sortOrderBook.sortMapOrder.erase(item);
                         saveNewOrder(pOrder);
                     }
                 }
@@ -979,22 +1674,14 @@ void Engine::updateOrderBook(SortOrderBookMap& sortOrderBookMap, const OPNX::Ord
             {
                 logErrorOrder("order not find in OrderBook: ", oldOrder);
             }
-            if (itemOrderBook->second.sortMapOrder.empty())
+            if (sortOrderBook.sortMapOrder.empty())
             {
                 sortOrderBookMap.erase(itemOrderBook);
             }
-            else if (0 == itemOrderBook->second.obItem.quantity || 0 == itemOrderBook->second.obItem.displayQuantity)
+            else if (0 == sortOrderBook.obItem.quantity || 0 == sortOrderBook.obItem.displayQuantity)
             {
-                itemOrderBook->second.obItem.quantity = 0;
-                itemOrderBook->second.obItem.displayQuantity = 0;
-                for (auto it = itemOrderBook->second.sortMapOrder.begin(); itemOrderBook->second.sortMapOrder.end() != it; it++)
-                {
-                    OPNX::Order* pOrder = it->second;
-                    unsigned long long ullQuantity = getOrderMatchableQuantity(pOrder);
-
-                    itemOrderBook->second.obItem.quantity += pOrder->remainQuantity;
-                    itemOrderBook->second.obItem.displayQuantity += ullQuantity;
-                }
+                cfLog.error() << m_strMarketCode << " updateOrderBook: price level aggregate is zero but level is not empty, price: " << sortOrderBook.obItem.price
+                              << ", quantity: " << sortOrderBook.obItem.quantity << ", displayQuantity: " << sortOrderBook.obItem.displayQuantity << std::endl;
             }
         }
         else
@@ -1043,11 +1730,59 @@ void Engine::setMarketInfo(const nlohmann::json& jsonMarketInfo)
 
 void Engine::clearOrder()
 {
+    m_vecAuctionOrder.clear();
+    m_vecRecoveryOrder.clear();
+    m_unmapAccountQuoteId.clear();
+    m_expiryWheel.clear();
     m_askOrderBook.clear();
     m_bidOrderBook.clear();
     m_unmapSearchOrder.clear();
 }
 
+// Called on the ORDER_IN thread, the orders are only copied here and the file is written by another thread
+void Engine::getSnapshot(OPNX::MarketSnapshot& snapshot)
+{
+    OPNX_TRACE_SCOPE(m_strMarketCode, "getSnapshot");
+    try {
+        snapshot.marketId = m_ullMarketId;
+        snapshot.vecOrder.reserve(m_unmapSearchOrder.size() + m_vecRecoveryOrder.size());
+        for (auto& item: m_unmapSearchOrder)
+        {
+            snapshot.vecOrder.push_back(item.second);
+        }
+        snapshot.vecOrder.insert(snapshot.vecOrder.end(), m_vecRecoveryOrder.begin(), m_vecRecoveryOrder.end());
+        snapshot.vecAuctionOrder = m_vecAuctionOrder;
+        for (auto& item: m_unmapAccountQuoteId)
+        {
+            for (auto ullOrderId: item.second)
+            {
+                snapshot.vecQuoteId.emplace_back(item.first, ullOrderId);
+            }
+        }
+    } catch (...) {
+        cfLog.fatal() << "Engine::getSnapshot exception!!!" << std::endl;
+    }
+}
+
+// The orders keep their sortId, so the bulk loader of the recovery rebuilds the same queue positions
+void Engine::loadSnapshot(OPNX::MarketSnapshot& snapshot)
+{
+    OPNX_TRACE_SCOPE(m_strMarketCode, "loadSnapshot");
+    try {
+        clearOrder();
+        m_vecRecoveryOrder.swap(snapshot.vecOrder);
+        loadRecoveryOrders();
+        m_vecAuctionOrder.swap(snapshot.vecAuctionOrder);
+        m_ullAuctionCallTime = OPNX::Utils::getMilliTimestamp();    // a restored call phase gets its whole window again
+        for (auto& item: snapshot.vecQuoteId)
+        {
+            m_unmapAccountQuoteId[item.first].push_back(item.second);
+        }
+    } catch (...) {
+        cfLog.fatal() << "Engine::loadSnapshot exception!!!" << std::endl;
+    }
+}
+
 unsigned long long Engine::getAskMatchableAmount(const OPNX::Order& order)
 {
     long long limitPrice = order.price;
@@ -1057,32 +1792,42 @@ unsigned long long Engine::getAskMatchableAmount(const OPNX::Order& order)
     {
         if (it->first <= limitPrice || OPNX::Order::MARKET == order.type || OPNX::Order::STOP_MARKET == order.type || OPNX::Order::TAKE_PROFIT_MARKET == order.type)
         {
-            if (OPNX::Order::STP_NONE == order.selfTradeProtectionType) {
+            const OPNX::LevelAccountItem* pAccountItem = nullptr;
+            if (OPNX::Order::STP_NONE != order.selfTradeProtectionType)
+            {
+                pAccountItem = it->second.findAccount(order.accountId);
+            }
+            if (nullptr == pAccountItem) {
                 ullAmount += it->second.obItem.quantity;
             } else {
-                for (auto itMap = it->second.sortMapOrder.begin(); itMap != it->second.sortMapOrder.end(); itMap++)
-                {
-                    if (order.accountId == itMap->second->accountId)
-                    {
-                        switch (order.selfTradeProtectionType) {
-                            case OPNX::Order::STP_TAKER:
-                            case OPNX::Order::STP_BOTH: {
-                                return ullAmount;
-                            }
-                            case OPNX::Order::STP_MAKER: {
-                                continue;
-                            }
-                            case OPNX::Order::STP_NONE:
+                switch (order.selfTradeProtectionType) {
+                    case OPNX::Order::STP_TAKER:
+                    case OPNX::Order::STP_BOTH: {
+                        // matching stops at the first order of the same account
+                        for (auto itMap = it->second.sortMapOrder.begin(); itMap != it->second.sortMapOrder.end(); itMap++)
+                        {
+                            if (order.accountId == itMap->second->accountId)
+                            {
                                 break;
+                            }
+                            ullAmount += itMap->second->remainQuantity;
                         }
+                        return ullAmount;
                     }
-                    else
-                    {
-                        ullAmount += itMap->second->quantity;
+                    case OPNX::Order::STP_MAKER: {
+                        // orders of the same account are canceled instead of matched
+                        ullAmount += it->second.obItem.quantity - pAccountItem->quantity;
+                        break;
                     }
+                    case OPNX::Order::STP_NONE:
+                        break;
                 }
             }
         }
+        else
+        {
+            break;
+        }
         it++;
     }
     return ullAmount;
@@ -1096,32 +1841,42 @@ unsigned long long Engine::getBidMatchableAmount(const OPNX::Order& order)
     {
         if (it->first >= limitPrice || OPNX::Order::MARKET == order.type || OPNX::Order::STOP_MARKET == order.type || OPNX::Order::TAKE_PROFIT_MARKET == order.type)
         {
-            if (OPNX::Order::STP_NONE == order.selfTradeProtectionType) {
+            const OPNX::LevelAccountItem* pAccountItem = nullptr;
+            if (OPNX::Order::STP_NONE != order.selfTradeProtectionType)
+            {
+                pAccountItem = it->second.findAccount(order.accountId);
+            }
+            if (nullptr == pAccountItem) {
                 ullAmount += it->second.obItem.quantity;
             } else {
-                for (auto itMap = it->second.sortMapOrder.begin(); itMap != it->second.sortMapOrder.end(); itMap++)
-                {
-                    if (order.accountId == itMap->second->accountId)
-                    {
-                        switch (order.selfTradeProtectionType) {
-                            case OPNX::Order::STP_TAKER:
-                            case OPNX::Order::STP_BOTH: {
-                                return ullAmount;
-                            }
-                            case OPNX::Order::STP_MAKER: {
-                                continue;
-                            }
-                            case OPNX::Order::STP_NONE:
+                switch (order.selfTradeProtectionType) {
+                    case OPNX::Order::STP_TAKER:
+                    case OPNX::Order::STP_BOTH: {
+                        // matching stops at the first order of the same account
+                        for (auto itMap = it->second.sortMapOrder.begin(); itMap != it->second.sortMapOrder.end(); itMap++)
+                        {
+                            if (order.accountId == itMap->second->accountId)
+                            {
                                 break;
+                            }
+                            ullAmount += itMap->second->remainQuantity;
                         }
+                        return ullAmount;
                     }
-                    else
-                    {
-                        ullAmount += itMap->second->quantity;
+                    case OPNX::Order::STP_MAKER: {
+                        // orders of the same account are canceled instead of matched
+                        ullAmount += it->second.obItem.quantity - pAccountItem->quantity;
+                        break;
                     }
+                    case OPNX::Order::STP_NONE:
+                        break;
                 }
             }
         }
+        else
+        {
+            break;
+        }
         it++;
     }
     return ullAmount;
@@ -1281,7 +2036,7 @@ void Engine::matchOrder(std::vector<OPNX::Order>& vecMatchedOrder, OPNX::Order&
                         long long llMatchedPrice, unsigned long long ullMatchQuantity, unsigned long long ullMatchedId,
                         OPNX::Order* pThirdOrder, bool bHandleTakerOrder, bool bHasRepo)
 {
-    OPNX::CInOutLog cInOutLog(m_strMarketCode + " matchOrder");
+    OPNX_TRACE_SCOPE(m_strMarketCode, "matchOrder");
     try {
         if (nullptr != pMakerOrder && 0 < ullMatchQuantity)
         {
@@ -1474,16 +2229,84 @@ void Engine::getDisplayBidOrderBook(BidOrderBook& bidOrderBook, int iSize, int i
     }
 }
 
+// Called by the SNAPSHOT thread, the levels are read under the order book lock and only within the band: the spread
+// grows from the best price outward, so the walk stops at the first level out of it. The resting quantity of each
+// account of a level is kept by the level for self trade protection, the orders are only read when some of them
+// may be too young.
+void Engine::getSpreadLevels(double dSpreadMax, int iOrderActiveTime, unsigned long long ullTimestamp,
+                             std::vector<OPNX::SpreadLevelItem>& vecAsk, std::vector<OPNX::SpreadLevelItem>& vecBid)
+{
+    try {
+        OPNX::CAutoMutex autoMutex(m_spinMutexOrderBook);
+        auto itAsk = m_askOrderBook.begin();
+        auto itBid = m_bidOrderBook.begin();
+        if (m_askOrderBook.end() == itAsk || m_bidOrderBook.end() == itBid
+        || 0 == itAsk->second.obItem.price || 0 == itAsk->second.obItem.quantity
+        || 0 == itBid->second.obItem.price || 0 == itBid->second.obItem.quantity)
+        {
+            return;
+        }
+        double dMidPrice = (itBid->second.obItem.price + itAsk->second.obItem.price) / 2.0;
+        getSpreadLevels(m_askOrderBook, dMidPrice, dSpreadMax, iOrderActiveTime, ullTimestamp, vecAsk);
+        getSpreadLevels(m_bidOrderBook, dMidPrice, dSpreadMax, iOrderActiveTime, ullTimestamp, vecBid);
+    } catch (...) {
+        cfLog.fatal() << "Engine::getSpreadLevels exception!!!" << std::endl;
+    }
+}
+
+template<class SortOrderBookMap>
+void Engine::getSpreadLevels(const SortOrderBookMap& sortOrderBookMap, double dMidPrice, double dSpreadMax, int iOrderActiveTime,
+                             unsigned long long ullTimestamp, std::vector<OPNX::SpreadLevelItem>& vecLevel)
+{
+    std::unordered_map<unsigned long long, unsigned long long> unmapAccountQuantity;
+    for (auto it = sortOrderBookMap.begin(); sortOrderBookMap.end() != it; it++)
+    {
+        double dSpread = (std::abs((double)it->first - dMidPrice) / dMidPrice) * 100;
+        dSpread = OPNX::Utils::doubleAccuracy(dSpread, 5);
+        if (dSpread >= dSpreadMax)
+        {
+            break;
+        }
+        OPNX::SpreadLevelItem levelItem;
+        levelItem.price = it->first;
+        levelItem.spread = dSpread;
+        const OPNX::SortOrderBook& sortOrderBook = it->second;
+        if (0 >= iOrderActiveTime)
+        {
+            levelItem.vecAccountQuantity.reserve(sortOrderBook.unmapAccountItem.size());
+            for (auto& accountItem: sortOrderBook.unmapAccountItem)
+            {
+                levelItem.vecAccountQuantity.emplace_back(accountItem.first, accountItem.second.quantity);
+            }
+        }
+        else
+        {
+            unmapAccountQuantity.clear();
+            for (auto& item: sortOrderBook.sortMapOrder)
+            {
+                if (ullTimestamp - item.second->orderCreated > (unsigned long long)iOrderActiveTime)
+                {
+                    unmapAccountQuantity[item.second->accountId] += item.second->remainQuantity;
+                }
+            }
+            levelItem.vecAccountQuantity.assign(unmapAccountQuantity.begin(), unmapAccountQuantity.end());
+        }
+        if (!levelItem.vecAccountQuantity.empty())
+        {
+            std::sort(levelItem.vecAccountQuantity.begin(), levelItem.vecAccountQuantity.end());
+            vecLevel.push_back(std::move(levelItem));
+        }
+    }
+}
+
+// An iceberg order shows displayQuantity at a time, the rest of remainQuantity is its hidden reserve.
+// The visible tranche is derived from the matched quantity, so no extra state has to be kept per order.
 unsigned long long Engine::getOrderMatchableQuantity(const OPNX::Order* pOrder)
 {
     unsigned long long quantity = pOrder->remainQuantity;
-    if (pOrder->displayQuantity < pOrder->quantity && 0 < pOrder->displayQuantity)
+    if (isIcebergOrder(*pOrder) && pOrder->displayQuantity < pOrder->remainQuantity)
     {
         quantity = pOrder->displayQuantity - (pOrder->quantity - pOrder->remainQuantity) % pOrder->displayQuantity;
-        if (0 < pOrder->remainQuantity && pOrder->remainQuantity <= pOrder->displayQuantity)
-        {
-            quantity = pOrder->remainQuantity;
-        }
     }
     return quantity;
 }
@@ -15,6 +15,7 @@
 #include "order.h"
 #include "implier.h"
 #include "spin_mutex.hpp"
+#include "timing_wheel.h"
 
 
 
@@ -34,6 +35,10 @@ private:
     , m_qtyIncrement(0)
     , m_bIsRepo(false)
     , m_iOrderGroupCount(OPNX::ORDER_COUNT)
+    , m_ullAuctionCallTime(0)
+    , m_ullAuctionCallMillis(1000)
+    , m_bDeferBestChange(false)
+    , m_bBestChanged(false)
     {
         m_ullFactor = 100000000;
         m_ullQtyFactor = 100000000;
@@ -50,6 +55,10 @@ private:
     OPNX::SearchOrderMap m_unmapSearchOrder;   // save all orders
     OPNX::OrderBookAscendMap m_askOrderBook;                 // key is price, save ask order, in ascending order
     OPNX::OrderBookDescendMap m_bidOrderBook;              // key is price, save bid order, in descending order
+    std::vector<OPNX::Order> m_vecAuctionOrder;            // AUCTION orders of the call phase, waiting for uncrossing
+    std::vector<OPNX::Order> m_vecRecoveryOrder;           // RECOVERY orders, loaded into the order book together at RECOVERY_END
+    std::unordered_map<unsigned long long, std::vector<unsigned long long>> m_unmapAccountQuoteId;   // key is accountId, value is orderId of quotes
+    OPNX::TimingWheel<unsigned long long> m_expiryWheel;    // orderId of the GTT orders by expireTime
 
     nlohmann::json m_jsonMarketInfo;
 
@@ -66,6 +75,10 @@ private:
     long long m_qtyIncrement;
     bool m_bIsRepo;
     int m_iOrderGroupCount;
+    unsigned long long m_ullAuctionCallTime;      // the time the first auction order of the call phase arrived
+    unsigned long long m_ullAuctionCallMillis;    // the call phase is uncrossed this long after its first auction order
+    bool m_bDeferBestChange;    // collect best change notifications of a mass quote, notify once
+    bool m_bBestChanged;
 
     // implier
     std::vector<OPNX::Implier>  m_vecImpliers;
@@ -76,6 +89,8 @@ public:
     static OPNX::IEngine* createEngine(const nlohmann::json& jsonMarketInfo, OPNX::ICallbackManager* pCallbackManager);
     virtual void releaseIEngine(){ delete this;};
     virtual void handleOrder(OPNX::Order& order);
+    virtual void handleMassQuote(std::vector<OPNX::Order>& vecQuote);
+    virtual void handleOrderList(std::vector<OPNX::Order>& vecOrder);
     virtual void setImplier(OPNX::Implier& implier)
     {
         if (m_vecImpliers.end() == find(m_vecImpliers.begin(), m_vecImpliers.end(), implier))
@@ -159,7 +174,13 @@ public:
     virtual void setMarketInfo(const nlohmann::json& jsonMarketInfo);
     virtual void getMarketInfo(nlohmann::json& jsonMarketInfo) { jsonMarketInfo = m_jsonMarketInfo; };
     virtual void clearOrder();
+    virtual void getSnapshot(OPNX::MarketSnapshot& snapshot);
+    virtual void loadSnapshot(OPNX::MarketSnapshot& snapshot);
     virtual void setOrderGroupCount(int iOrderGroupCount) { m_iOrderGroupCount = iOrderGroupCount; }
+    virtual void setAuctionCallMillis(unsigned long long ullAuctionCallMillis) { m_ullAuctionCallMillis = ullAuctionCallMillis; }
+    virtual void expireOrders(unsigned long long ullNow, std::vector<OPNX::Order>& vecExpired);
+    virtual void getSpreadLevels(double dSpreadMax, int iOrderActiveTime, unsigned long long ullTimestamp,
+                                 std::vector<OPNX::SpreadLevelItem>& vecAsk, std::vector<OPNX::SpreadLevelItem>& vecBid);
 
     OPNX::SortOrderBook* getBestAskSortOrderBook();
     OPNX::SortOrderBook* getBestBidSortOrderBook();
@@ -168,8 +189,26 @@ private:
     void handleNewOrder(OPNX::Order& order);
     void handleCancelOrder(OPNX::Order& order);
     void handleAmendOrder(OPNX::Order& order);
+    void handleCancelReplaceOrder(OPNX::Order& order);
+    void uncrossAuction();
+    void pullAuctionOrders();
+    bool getAuctionPrice(long long& llAuctionPrice, unsigned long long& ullAuctionVolume);
+    template<class SortOrderBookMap>
+    void getAuctionOrders(std::vector<OPNX::Order*>& vecOrder, SortOrderBookMap& sortOrderBookMap, OPNX::Order::OrderSide side, long long llAuctionPrice);
+    void matchAuctionOrder(std::vector<OPNX::Order>& vecMatchedOrder, OPNX::Order& takerOrder, OPNX::Order& makerOrder,
+                           long long llMatchedPrice, unsigned long long ullMatchQuantity, unsigned long long ullMatchedId);
     inline OPNX::Order* saveToSearchOrder(OPNX::Order& order);
+    inline void addToExpiryWheel(const OPNX::Order& order);
     void saveNewOrder(OPNX::Order* order);
+    void loadRecoveryOrders();
+    template<class SortOrderBookMap>
+    void loadPriceLevels(SortOrderBookMap& sortOrderBookMap, std::vector<OPNX::Order>::iterator itBegin, std::vector<OPNX::Order>::iterator itEnd);
+    inline void addToPriceLevel(OPNX::SortOrderBook& sortOrderBook, OPNX::Order* pOrder);
+    template<class SortOrderBookMap>
+    void getSpreadLevels(const SortOrderBookMap& sortOrderBookMap, double dMidPrice, double dSpreadMax, int iOrderActiveTime,
+                         unsigned long long ullTimestamp, std::vector<OPNX::SpreadLevelItem>& vecLevel);
+    inline void requeueIcebergOrder(OPNX::SortOrderBook& sortOrderBook, OPNX::SortOrderMap::iterator itOrder);
+    static inline bool isIcebergOrder(const OPNX::Order& order) { return 0 < order.displayQuantity && order.displayQuantity < order.quantity; }
     void handleBracketOrder(OPNX::Order* pBracketOrder);
 
     unsigned long long getAskMatchableAmount(const OPNX::Order& order);
@@ -180,6 +219,8 @@ private:
     inline void eraseFromSearchOrderMap(const OPNX::Order& order);
 
     inline bool checkBestChange(const OPNX::Order& order);
+    inline void notifyBestChange();
+    inline bool isCrossed(const OPNX::Order& order);
     void updateOrderBook(const OPNX::Order& newOrder, const OPNX::Order& oldOrder);
     template<class SortOrderBookMap>
     void updateOrderBook(SortOrderBookMap& sortOrderBookMap, const OPNX::Order& newOrder, const OPNX::Order& oldOrder);
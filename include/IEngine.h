@@ -12,6 +12,7 @@
 #include "implier.h"
 #include "order.h"
 #include "order_book_item.h"
+#include "snapshot.h"
 #include "thread_queue.h"
 
 
@@ -21,6 +22,8 @@ namespace OPNX {
         virtual ~IEngine(){}
         virtual void releaseIEngine()=0;
         virtual void handleOrder(OPNX::Order& order)=0;;
+        virtual void handleMassQuote(std::vector<OPNX::Order>& vecQuote)=0;
+        virtual void handleOrderList(std::vector<OPNX::Order>& vecOrder)=0;
         virtual void setImplier(OPNX::Implier& implier)=0;
         virtual void eraseImplier(OPNX::IEngine *pEngine)=0;
         virtual std::string getMarketCode()=0;
@@ -33,7 +36,18 @@ namespace OPNX {
         virtual void setMarketInfo(const nlohmann::json& jsonMarketInfo)=0;
         virtual void getMarketInfo(nlohmann::json& jsonMarketInfo)=0;
         virtual void clearOrder()=0;
+        virtual void getSnapshot(OPNX::MarketSnapshot& snapshot)=0;
+        virtual void loadSnapshot(OPNX::MarketSnapshot& snapshot)=0;
         virtual void setOrderGroupCount(int iOrderGroupCount)=0;
+        // The length of the call phase of the AUCTION orders, from its first order to its AUCTION_UNCROSS
+        virtual void setAuctionCallMillis(unsigned long long ullAuctionCallMillis)=0;
+        // Appends a cancel of each GTT order whose expireTime <= ullNow, and the AUCTION_UNCROSS of a call phase that is over,
+        // the caller routes them to handleOrder
+        virtual void expireOrders(unsigned long long ullNow, std::vector<OPNX::Order>& vecExpired)=0;
+        // The levels of the self order book within dSpreadMax percent of the self mid price, from the best price outward,
+        // with the orders older than iOrderActiveTime ms at ullTimestamp. Nothing without a self best bid and ask.
+        virtual void getSpreadLevels(double dSpreadMax, int iOrderActiveTime, unsigned long long ullTimestamp,
+                                     std::vector<OPNX::SpreadLevelItem>& vecAsk, std::vector<OPNX::SpreadLevelItem>& vecBid)=0;
     };
 
 }
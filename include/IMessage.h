@@ -8,6 +8,7 @@
 
 #include "threadsafe_queue.h"
 #include "thread_queue.h"
+#include "trigger_price_queue.h"
 #include "order.h"
 #include "json.hpp"
 
@@ -51,6 +52,8 @@ public:
     virtual void sendCmd(const nlohmann::json& jsonData)=0;
     virtual void sendHeartbeat(const nlohmann::json& jsonData)=0;
     virtual void sendPulsarLog(const std::string& strLog)=0;
+    // liquidity of the accounts around the best prices, sent by the commander
+    virtual void sendSpreadSnapshot(const std::string& strJsonData)=0;
 
     virtual void setRecovery(bool bRecovery)=0;
     virtual bool getRecovery()=0;
@@ -61,8 +64,15 @@ public:
 
 IMessage* createIMessage(OPNX::OrderQueue<OPNX::Order>* pOrderQueue,
                          OPNX::OrderQueue<OPNX::Order>* pTriggerOrderQueue,
-                         OPNX::OrderQueue<OPNX::TriggerPrice>* pMarkPriceQueue,
+                         OPNX::TriggerPriceQueue* pMarkPriceQueue,
                          OPNX::OrderQueue<nlohmann::json>* pCmdQueue,
                          const std::string& strServiceUrl);
 
+// Shared memory transport of a co-located gateway in front of pIMessage, see shm_proxy.h
+IMessage* createShmIMessage(IMessage* pIMessage,
+                            OPNX::OrderQueue<OPNX::Order>* pOrderQueue,
+                            OPNX::OrderQueue<OPNX::Order>* pTriggerOrderQueue,
+                            const std::string& strShmPrefix,
+                            unsigned long long ullRingSize);
+
 #endif //MATCHING_ENGINE_IMESSAGE_H
@@ -9,6 +9,7 @@
 
 #include "order.h"
 #include "order_book_item.h"
+#include "snapshot.h"
 #include "thread_queue.h"
 
 namespace OPNX {
@@ -28,6 +29,10 @@ namespace OPNX {
 
         virtual void clearOrder() = 0;
 
+        virtual void getSnapshot(OPNX::MarketSnapshot& snapshot) = 0;
+
+        virtual void loadSnapshot(OPNX::MarketSnapshot& snapshot) = 0;
+
         virtual unsigned long long getOrdersCount()=0;
     };
 }
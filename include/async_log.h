@@ -0,0 +1,298 @@
+#ifndef MATCHING_ENGINE_ASYNC_LOG_H
+#define MATCHING_ENGINE_ASYNC_LOG_H
+
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+namespace OPNX {
+    // Backend of the log for the order threads: a thread writes its records into its own single producer ring and never
+    // waits, one background thread formats the timestamps, writes the records of all rings in batches with one flush and
+    // forwards the records of the pulsar levels to the pulsar log.
+    // A record is binary: the time in nano seconds, the label of the level (a literal, it is never copied) and the message.
+    // When the ring of a thread is full the record is dropped and counted, the backend logs the number of dropped records.
+    class AsyncLog {
+    public:
+        AsyncLog(const std::string& strFile, unsigned long long ullRingSize, std::ostream* pStream,
+                 const std::function<void(const std::string&)>* pPulsarLog)
+        : m_strFile(strFile)
+        , m_ullRingSize(roundUp(ullRingSize))
+        , m_pStream(pStream)
+        , m_pPulsarLog(pPulsarLog)
+        , m_bRunning(false)
+        , m_llSecond(-1){};
+        AsyncLog(const AsyncLog &) = delete;
+        AsyncLog &operator=(const AsyncLog &) = delete;
+        ~AsyncLog()
+        {
+            stop();
+        }
+
+        bool start()
+        {
+            if (m_bRunning)
+            {
+                return true;
+            }
+            if (!m_strFile.empty())
+            {
+                m_ofs.open(m_strFile, std::ios::out | std::ios::app);
+                if (!m_ofs.is_open())
+                {
+                    return false;
+                }
+            }
+            m_bRunning = true;
+            m_thread = std::thread(AsyncLog::backendThread, this);
+            return true;
+        }
+
+        // Writes the records of the rings before it returns
+        void stop()
+        {
+            if (!m_bRunning)
+            {
+                return;
+            }
+            m_bRunning = false;
+            if (m_thread.joinable())
+            {
+                m_thread.join();
+            }
+            if (m_ofs.is_open())
+            {
+                m_ofs.close();
+            }
+        }
+
+        // szLabel must be a literal, a message longer than a quarter of the ring is truncated
+        void push(const char* szLabel, bool bPulsar, const char* pData, unsigned long long ullLength)
+        {
+            Ring* pRing = getRing();
+            if (nullptr == pRing)
+            {
+                return;
+            }
+            ullLength = std::min(ullLength, m_ullRingSize / 4);
+            Record record;
+            record.ullTimestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+            record.szLabel = szLabel;
+            record.uiLength = (unsigned int)ullLength;
+            record.bPulsar = bPulsar;
+            unsigned long long ullSize = (sizeof(Record) + ullLength + 7) & ~7ULL;
+            unsigned long long ullHead = pRing->ullHead.load(std::memory_order_relaxed);
+            if (ullHead + ullSize - pRing->ullTail.load(std::memory_order_acquire) > m_ullRingSize)
+            {
+                pRing->ullDropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            pRing->write(ullHead, &record, sizeof(Record));
+            pRing->write(ullHead + sizeof(Record), pData, ullLength);
+            pRing->ullHead.store(ullHead + ullSize, std::memory_order_release);
+        }
+
+    private:
+        struct Record {
+            unsigned long long ullTimestamp;
+            const char* szLabel;
+            unsigned int uiLength;
+            bool bPulsar;
+        };
+        struct Ring {
+            explicit Ring(unsigned long long ullSize) : pData(new char[ullSize]), ullMask(ullSize - 1), ullHead(0), ullTail(0), ullDropped(0), ullReported(0){};
+
+            void write(unsigned long long ullPosition, const void* pValue, unsigned long long ullLength)
+            {
+                unsigned long long ullOffset = ullPosition & ullMask;
+                unsigned long long ullFirst = std::min(ullLength, ullMask + 1 - ullOffset);
+                memcpy(pData.get() + ullOffset, pValue, ullFirst);
+                memcpy(pData.get(), (const char*)pValue + ullFirst, ullLength - ullFirst);
+            }
+            void read(unsigned long long ullPosition, void* pValue, unsigned long long ullLength) const
+            {
+                unsigned long long ullOffset = ullPosition & ullMask;
+                unsigned long long ullFirst = std::min(ullLength, ullMask + 1 - ullOffset);
+                memcpy(pValue, pData.get() + ullOffset, ullFirst);
+                memcpy((char*)pValue + ullFirst, pData.get(), ullLength - ullFirst);
+            }
+
+            std::unique_ptr<char[]> pData;
+            unsigned long long ullMask;
+            alignas(64) std::atomic<unsigned long long> ullHead;      // the thread of the ring
+            alignas(64) std::atomic<unsigned long long> ullTail;      // the backend
+            std::atomic<unsigned long long> ullDropped;
+            unsigned long long ullReported;                          // dropped records already logged by the backend
+        };
+        struct Line {
+            unsigned long long ullTimestamp;
+            const char* szLabel;
+            bool bPulsar;
+            std::string strMessage;
+        };
+
+        static unsigned long long roundUp(unsigned long long ullSize)
+        {
+            unsigned long long ullRound = 4096;
+            while (ullRound < ullSize)
+            {
+                ullRound <<= 1;
+            }
+            return ullRound;
+        }
+
+        // The ring of the calling thread, created on its first record. The rings live as long as the AsyncLog,
+        // the threads of the manager are not restarted.
+        Ring* getRing()
+        {
+            thread_local AsyncLog* t_pOwner = nullptr;
+            thread_local Ring* t_pRing = nullptr;
+            if (this != t_pOwner)
+            {
+                std::lock_guard<std::mutex> lock(m_mutexRing);
+                m_vecRing.emplace_back(new Ring(m_ullRingSize));
+                t_pRing = m_vecRing.back().get();
+                t_pOwner = this;
+            }
+            return t_pRing;
+        }
+
+        // Moves the records of all rings to m_vecLine, in the order of their time
+        void drain()
+        {
+            m_vecLine.clear();
+            std::vector<Ring*> vecRing;
+            {
+                std::lock_guard<std::mutex> lock(m_mutexRing);
+                for (auto& pRing: m_vecRing)
+                {
+                    vecRing.push_back(pRing.get());
+                }
+            }
+            for (auto pRing: vecRing)
+            {
+                unsigned long long ullTail = pRing->ullTail.load(std::memory_order_relaxed);
+                unsigned long long ullHead = pRing->ullHead.load(std::memory_order_acquire);
+                while (ullTail < ullHead)
+                {
+                    Record record;
+                    pRing->read(ullTail, &record, sizeof(Record));
+                    Line line;
+                    line.ullTimestamp = record.ullTimestamp;
+                    line.szLabel = record.szLabel;
+                    line.bPulsar = record.bPulsar;
+                    line.strMessage.resize(record.uiLength);
+                    pRing->read(ullTail + sizeof(Record), &line.strMessage[0], record.uiLength);
+                    m_vecLine.push_back(std::move(line));
+                    ullTail += (sizeof(Record) + record.uiLength + 7) & ~7ULL;
+                }
+                pRing->ullTail.store(ullTail, std::memory_order_release);
+                unsigned long long ullDropped = pRing->ullDropped.load(std::memory_order_relaxed);
+                if (ullDropped != pRing->ullReported)
+                {
+                    Line line;
+                    line.ullTimestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+                    line.szLabel = "WARN";
+                    line.bPulsar = false;
+                    line.strMessage = "AsyncLog dropped records of a full ring: " + std::to_string(ullDropped - pRing->ullReported) + "\n";
+                    pRing->ullReported = ullDropped;
+                    m_vecLine.push_back(std::move(line));
+                }
+            }
+            std::stable_sort(m_vecLine.begin(), m_vecLine.end(), [](const Line& left, const Line& right) {
+                return left.ullTimestamp < right.ullTimestamp;
+            });
+        }
+
+        // The prefix of LogStream: 2021-12-08T10:00:00,000000  LABEL
+        void appendPrefix(std::string& strOut, unsigned long long ullTimestamp, const char* szLabel)
+        {
+            long long llSecond = (long long)(ullTimestamp / 1000000000);
+            if (llSecond != m_llSecond)
+            {
+                m_llSecond = llSecond;
+                std::time_t time = (std::time_t)llSecond;
+                std::tm tm;
+                ::localtime_r(&time, &tm);
+                strftime(m_szSecond, sizeof(m_szSecond), "%FT%T", &tm);
+            }
+            char szPrefix[64];
+            snprintf(szPrefix, sizeof(szPrefix), "%s,%06llu  %5s  ", m_szSecond, (ullTimestamp % 1000000000) / 1000, szLabel);
+            strOut += szPrefix;
+        }
+
+        void backend()
+        {
+            std::string strBatch;
+            std::string strLine;
+            while (true)
+            {
+                bool bRunning = m_bRunning;
+                drain();
+                if (m_vecLine.empty())
+                {
+                    if (!bRunning)
+                    {
+                        break;
+                    }
+                    usleep(1000);
+                    continue;
+                }
+                strBatch.clear();
+                for (auto& line: m_vecLine)
+                {
+                    strLine.clear();
+                    appendPrefix(strLine, line.ullTimestamp, line.szLabel);
+                    strLine += line.strMessage;
+                    strBatch += strLine;
+                    if (line.bPulsar && nullptr != m_pPulsarLog && *m_pPulsarLog)
+                    {
+                        try {
+                            (*m_pPulsarLog)(strLine);
+                        } catch (...) {
+                        }
+                    }
+                }
+                std::ostream* pStream = m_ofs.is_open() ? &m_ofs : m_pStream;
+                if (nullptr != pStream)
+                {
+                    pStream->write(strBatch.data(), strBatch.size()).flush();
+                }
+            }
+        }
+        static void backendThread(AsyncLog* pAsyncLog)
+        {
+            pAsyncLog->backend();
+        }
+
+    private:
+        std::string m_strFile;
+        unsigned long long m_ullRingSize;
+        std::ostream* m_pStream;
+        const std::function<void(const std::string&)>* m_pPulsarLog;
+        std::ofstream m_ofs;
+        std::atomic<bool> m_bRunning;
+        std::thread m_thread;
+
+        std::mutex m_mutexRing;
+        std::vector<std::unique_ptr<Ring>> m_vecRing;
+
+        // the backend thread
+        std::vector<Line> m_vecLine;
+        long long m_llSecond;
+        char m_szSecond[32];
+    };
+}
+
+#endif //MATCHING_ENGINE_ASYNC_LOG_H
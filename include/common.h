@@ -15,6 +15,7 @@ namespace OPNX {
         virtual void pulsarOrder(const OPNX::Order&)=0;
         virtual void pulsarOrderList(const std::vector<OPNX::Order>&)=0;
         virtual void triggerOrderToEngine(const OPNX::Order&)=0;
+        virtual void triggerOrderListToEngine(const std::vector<OPNX::Order>&)=0;   // the orders triggered by one price
         virtual void engineOrderToTrigger(const OPNX::Order&)=0;
         virtual void bestOrderBookChange()=0;
         virtual void orderStore(OPNX::Order*)=0;
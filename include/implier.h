@@ -304,7 +304,7 @@ namespace OPNX {
 
         unsigned long long matchOrder(std::vector<OPNX::Order>& vecMatchedOrder, OPNX::Order& takerOrder, long long llMatchedPrice, unsigned long long ullMatchQuantity, OPNX::ICallbackManager* pCallbackManager, int iOrderGroupCount, bool bHasRepo = false)
         {
-            OPNX::CInOutLog cInOutLog("implied matchOrder");
+            OPNX_TRACE_SCOPE("implied matchOrder");
 
             while (0 < ullMatchQuantity)
             {
@@ -0,0 +1,488 @@
+#ifndef MATCHING_ENGINE_JOURNAL_H
+#define MATCHING_ENGINE_JOURNAL_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "order.h"
+
+
+namespace OPNX {
+    static const char JOURNAL_MAGIC[8] = {'O', 'P', 'N', 'X', 'J', 'R', 'N', 'L'};
+    static const unsigned int JOURNAL_VERSION = 3;
+    static const unsigned long long JOURNAL_FLUSH_COUNT = 1024;     // msync after this number of records
+    // The thread that handled the order of a record
+    static const unsigned int JOURNAL_ORDER_IN = 0;             // the engines
+    static const unsigned int JOURNAL_TRIGGER_ORDER_IN = 1;     // the trigger order managers
+
+    struct JournalHeader {
+        char magic[8];
+        unsigned int version;
+        unsigned int orderSize;
+        unsigned long long firstSequence;
+        unsigned long long capacity;
+        unsigned long long stateSequence;     // set by rotate: the last record of the file
+        unsigned long long stateHash;         // set by rotate: Snapshot::hash of the engines and trigger order managers after stateSequence, 0 if unknown
+    };
+    // The sequence is written after the order, a record with sequence 0 was never completely written
+    struct JournalRecord {
+        unsigned long long sequence;
+        unsigned int queue;     // JOURNAL_ORDER_IN or JOURNAL_TRIGGER_ORDER_IN
+        OPNX::Order order;
+    };
+
+    // Append-only journal of the orders in the sequence they are handled by the ORDER_IN and TRIGGER_ORDER_IN threads.
+    // A file holds a fixed number of records and is named <prefix>.<first sequence>, a full file is continued in a new one.
+    // Only one thread may append at a time.
+    class Journal {
+    public:
+        Journal()
+        : m_strPrefix("")
+        , m_ullCapacity(0)
+        , m_ullSequence(0)
+        , m_pMap(nullptr)
+        , m_ullMapSize(0)
+        , m_pRecord(nullptr)
+        , m_ullCount(0)
+        , m_ullUnflushed(0){};
+        Journal(const Journal &) = delete;
+        Journal &operator=(const Journal &) = delete;
+        ~Journal() { close(); }
+
+        // The next record gets ullSequence + 1, its file is created by the first append
+        void open(const std::string& strPrefix, unsigned long long ullCapacity, unsigned long long ullSequence)
+        {
+            close();
+            m_strPrefix = strPrefix;
+            m_ullCapacity = 0 < ullCapacity ? ullCapacity : 1;
+            m_ullSequence = ullSequence;
+        }
+        bool isOpen() const { return !m_strPrefix.empty(); }
+        unsigned long long getSequence() const { return m_ullSequence; }
+
+        bool append(const OPNX::Order& order, unsigned int uiQueue = JOURNAL_ORDER_IN)
+        {
+            if (nullptr == m_pMap || m_ullCount >= m_ullCapacity)
+            {
+                if (!openFile())
+                {
+                    return false;
+                }
+            }
+            JournalRecord* pRecord = m_pRecord + m_ullCount;
+            memcpy(&pRecord->order, &order, sizeof(OPNX::Order));
+            pRecord->queue = uiQueue;
+            std::atomic_thread_fence(std::memory_order_release);
+            pRecord->sequence = ++m_ullSequence;
+            m_ullCount++;
+            if (JOURNAL_FLUSH_COUNT <= ++m_ullUnflushed)
+            {
+                flush(false);
+            }
+            return true;
+        }
+
+        // The pages are in the page cache after append, a flush only protects against a crash of the host
+        void flush(bool bSync)
+        {
+            if (nullptr != m_pMap && 0 < m_ullUnflushed)
+            {
+                msync(m_pMap, m_ullMapSize, bSync ? MS_SYNC : MS_ASYNC);
+                m_ullUnflushed = 0;
+            }
+        }
+
+        // Close the current file, the following records go to a new file. Returns the last sequence of the closed file.
+        // ullStateHash is kept in the header, a standby compares it with its own engines at the same sequence
+        unsigned long long rotate(unsigned long long ullStateHash = 0)
+        {
+            if (nullptr != m_pMap)
+            {
+                JournalHeader* pHeader = (JournalHeader*)m_pMap;
+                pHeader->stateHash = ullStateHash;
+                pHeader->stateSequence = m_ullSequence;
+            }
+            closeFile();
+            return m_ullSequence;
+        }
+
+        void close()
+        {
+            closeFile();
+            m_strPrefix = "";
+        }
+
+        // Read the records after ullSequence of all files of the prefix, ullFirstSequence is the first one that was read
+        static unsigned long long read(const std::string& strPrefix, unsigned long long ullSequence, std::vector<JournalRecord>& vecRecord, unsigned long long& ullFirstSequence)
+        {
+            ullFirstSequence = 0;
+            unsigned long long ullLastSequence = ullSequence;
+            std::vector<std::pair<unsigned long long, std::string>> vecFile;
+            listFiles(strPrefix, vecFile);
+            for (auto& file: vecFile)
+            {
+                int fd = ::open(file.second.c_str(), O_RDONLY);
+                if (0 > fd)
+                {
+                    continue;
+                }
+                struct stat fileStat;
+                if (0 != fstat(fd, &fileStat) || sizeof(JournalHeader) > (size_t)fileStat.st_size)
+                {
+                    ::close(fd);
+                    continue;
+                }
+                size_t size = fileStat.st_size;
+                void* pMap = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+                ::close(fd);
+                if (MAP_FAILED == pMap)
+                {
+                    continue;
+                }
+                madvise(pMap, size, MADV_SEQUENTIAL);
+                const JournalHeader* pHeader = (const JournalHeader*)pMap;
+                if (0 == memcmp(pHeader->magic, JOURNAL_MAGIC, sizeof(pHeader->magic)) && JOURNAL_VERSION == pHeader->version
+                    && sizeof(OPNX::Order) == pHeader->orderSize)
+                {
+                    const JournalRecord* pRecord = (const JournalRecord*)((const char*)pMap + sizeof(JournalHeader));
+                    unsigned long long ullCount = std::min<unsigned long long>(pHeader->capacity, (size - sizeof(JournalHeader)) / sizeof(JournalRecord));
+                    for (unsigned long long i = 0; i < ullCount && 0 != pRecord[i].sequence; i++)
+                    {
+                        if (pRecord[i].sequence <= ullLastSequence)
+                        {
+                            continue;
+                        }
+                        if (0 == ullFirstSequence)
+                        {
+                            ullFirstSequence = pRecord[i].sequence;
+                        }
+                        else if (pRecord[i].sequence != ullLastSequence + 1)
+                        {
+                            break;   // a gap, the records after it can not be used
+                        }
+                        vecRecord.push_back(pRecord[i]);
+                        ullLastSequence = pRecord[i].sequence;
+                    }
+                }
+                munmap(pMap, size);
+            }
+            return ullLastSequence;
+        }
+
+        // Remove the files whose records are all covered by a snapshot at ullSequence,
+        // the records of a file end where the next file begins, so the last file is kept
+        static void remove(const std::string& strPrefix, unsigned long long ullSequence)
+        {
+            std::vector<std::pair<unsigned long long, std::string>> vecFile;
+            listFiles(strPrefix, vecFile);
+            for (size_t i = 0; i + 1 < vecFile.size(); i++)
+            {
+                if (vecFile[i + 1].first <= ullSequence + 1)
+                {
+                    unlink(vecFile[i].second.c_str());
+                }
+            }
+        }
+        static void removeAll(const std::string& strPrefix)
+        {
+            std::vector<std::pair<unsigned long long, std::string>> vecFile;
+            listFiles(strPrefix, vecFile);
+            for (auto& file: vecFile)
+            {
+                unlink(file.second.c_str());
+            }
+        }
+
+    private:
+        bool openFile()
+        {
+            closeFile();
+            if (m_strPrefix.empty())
+            {
+                return false;
+            }
+            std::string strFile = m_strPrefix + "." + std::to_string(m_ullSequence + 1);
+            int fd = ::open(strFile.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+            if (0 > fd)
+            {
+                return false;
+            }
+            size_t size = sizeof(JournalHeader) + m_ullCapacity * sizeof(JournalRecord);
+            if (0 != ftruncate(fd, size))
+            {
+                ::close(fd);
+                return false;
+            }
+            void* pMap = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            ::close(fd);
+            if (MAP_FAILED == pMap)
+            {
+                return false;
+            }
+            m_pMap = pMap;
+            m_ullMapSize = size;
+            JournalHeader* pHeader = (JournalHeader*)m_pMap;
+            memcpy(pHeader->magic, JOURNAL_MAGIC, sizeof(pHeader->magic));
+            pHeader->version = JOURNAL_VERSION;
+            pHeader->orderSize = sizeof(OPNX::Order);
+            pHeader->firstSequence = m_ullSequence + 1;
+            pHeader->capacity = m_ullCapacity;
+            pHeader->stateSequence = 0;
+            pHeader->stateHash = 0;
+            m_pRecord = (JournalRecord*)((char*)m_pMap + sizeof(JournalHeader));
+            m_ullCount = 0;
+            return true;
+        }
+        void closeFile()
+        {
+            if (nullptr != m_pMap)
+            {
+                msync(m_pMap, m_ullMapSize, MS_SYNC);
+                munmap(m_pMap, m_ullMapSize);
+            }
+            m_ullUnflushed = 0;
+            m_pMap = nullptr;
+            m_ullMapSize = 0;
+            m_pRecord = nullptr;
+            m_ullCount = 0;
+        }
+    public:
+        // The files of the prefix, sorted by their first sequence
+        static void listFiles(const std::string& strPrefix, std::vector<std::pair<unsigned long long, std::string>>& vecFile)
+        {
+            std::string strDir = ".";
+            std::string strName = strPrefix;
+            auto pos = strPrefix.rfind('/');
+            if (std::string::npos != pos)
+            {
+                strDir = 0 == pos ? "/" : strPrefix.substr(0, pos);
+                strName = strPrefix.substr(pos + 1);
+            }
+            DIR* pDir = opendir(strDir.c_str());
+            if (nullptr == pDir)
+            {
+                return;
+            }
+            strName += ".";
+            struct dirent* pEntry = nullptr;
+            while (nullptr != (pEntry = readdir(pDir)))
+            {
+                std::string strEntry = pEntry->d_name;
+                if (strName.size() < strEntry.size() && 0 == strEntry.compare(0, strName.size(), strName)
+                    && std::string::npos == strEntry.find_first_not_of("0123456789", strName.size()))
+                {
+                    vecFile.emplace_back(std::stoull(strEntry.substr(strName.size())), strDir + "/" + strEntry);
+                }
+            }
+            closedir(pDir);
+            std::sort(vecFile.begin(), vecFile.end());
+        }
+
+    private:
+        std::string m_strPrefix;
+        unsigned long long m_ullCapacity;     // records of a file
+        unsigned long long m_ullSequence;     // sequence of the last record
+        void* m_pMap;
+        size_t m_ullMapSize;
+        JournalRecord* m_pRecord;
+        unsigned long long m_ullCount;        // records in the current file
+        unsigned long long m_ullUnflushed;
+    };
+
+    // Follows the journal while another process appends to it, the records are read in sequence across the files.
+    class JournalReader {
+    public:
+        JournalReader()
+        : m_strPrefix("")
+        , m_ullSequence(0)
+        , m_pMap(nullptr)
+        , m_ullMapSize(0)
+        , m_pHeader(nullptr)
+        , m_pRecord(nullptr)
+        , m_ullIndex(0)
+        , m_ullIdleCount(0)
+        , m_bBroken(false)
+        , m_bStateHash(false)
+        , m_ullStateHash(0){};
+        JournalReader(const JournalReader &) = delete;
+        JournalReader &operator=(const JournalReader &) = delete;
+        ~JournalReader() { close(); }
+
+        // The next record to read is ullSequence + 1
+        void open(const std::string& strPrefix, unsigned long long ullSequence)
+        {
+            close();
+            m_strPrefix = strPrefix;
+            m_ullSequence = ullSequence;
+            m_bBroken = false;
+        }
+        void close()
+        {
+            closeFile();
+            m_bStateHash = false;
+        }
+        unsigned long long getSequence() const { return m_ullSequence; }
+        // The records after getSequence were removed or do not follow it, the reader can't go on
+        bool isBroken() const { return m_bBroken; }
+
+        // Returns false if the next record is not written yet
+        bool next(OPNX::Order& order, unsigned int& uiQueue)
+        {
+            if (m_bBroken)
+            {
+                return false;
+            }
+            if (nullptr != m_pMap && m_ullIndex >= m_pHeader->capacity)
+            {
+                closeFile();    // the file is full, the next record is in the next file
+            }
+            if (nullptr == m_pMap && (0 != m_ullIdleCount++ % JOURNAL_FLUSH_COUNT || !openFile()))
+            {
+                return false;
+            }
+            const volatile JournalRecord* pRecord = (const volatile JournalRecord*)(m_pRecord + m_ullIndex);
+            unsigned long long ullSequence = pRecord->sequence;
+            if (0 == ullSequence)
+            {
+                // a rotated file is not continued, look for the next file from time to time
+                if (0 == ++m_ullIdleCount % JOURNAL_FLUSH_COUNT)
+                {
+                    std::vector<std::pair<unsigned long long, std::string>> vecFile;
+                    Journal::listFiles(m_strPrefix, vecFile);
+                    for (auto& file: vecFile)
+                    {
+                        if (file.first > m_pHeader->firstSequence)
+                        {
+                            if (file.first == m_ullSequence + 1)
+                            {
+                                closeFile();
+                            }
+                            else
+                            {
+                                m_bBroken = true;   // the writer skipped sequences
+                            }
+                            break;
+                        }
+                    }
+                }
+                return false;
+            }
+            if (ullSequence != m_ullSequence + 1)
+            {
+                m_bBroken = true;
+                return false;
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            memcpy(&order, (const void*)&pRecord->order, sizeof(OPNX::Order));
+            uiQueue = pRecord->queue;
+            m_ullSequence = ullSequence;
+            m_ullIndex++;
+            m_ullIdleCount = 0;
+            return true;
+        }
+
+        // After a file is left, its state hash if the writer rotated it at the sequence the reader is at
+        bool getStateHash(unsigned long long& ullStateHash)
+        {
+            if (!m_bStateHash)
+            {
+                return false;
+            }
+            m_bStateHash = false;
+            ullStateHash = m_ullStateHash;
+            return true;
+        }
+
+    private:
+        // Open the last file beginning at or before the next record
+        bool openFile()
+        {
+            std::vector<std::pair<unsigned long long, std::string>> vecFile;
+            Journal::listFiles(m_strPrefix, vecFile);
+            auto it = std::upper_bound(vecFile.begin(), vecFile.end(), m_ullSequence + 1,
+                                       [](unsigned long long ullSequence, const std::pair<unsigned long long, std::string>& file) { return ullSequence < file.first; });
+            if (vecFile.begin() == it)
+            {
+                m_bBroken = !vecFile.empty();   // all files begin after the next record
+                return false;
+            }
+            --it;
+            int fd = ::open(it->second.c_str(), O_RDONLY);
+            if (0 > fd)
+            {
+                return false;
+            }
+            struct stat fileStat;
+            if (0 != fstat(fd, &fileStat) || sizeof(JournalHeader) > (size_t)fileStat.st_size)
+            {
+                ::close(fd);
+                return false;   // the file is being created
+            }
+            size_t size = fileStat.st_size;
+            void* pMap = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+            ::close(fd);
+            if (MAP_FAILED == pMap)
+            {
+                return false;
+            }
+            const JournalHeader* pHeader = (const JournalHeader*)pMap;
+            if (0 != memcmp(pHeader->magic, JOURNAL_MAGIC, sizeof(pHeader->magic)) || JOURNAL_VERSION != pHeader->version
+                || sizeof(OPNX::Order) != pHeader->orderSize || it->first != pHeader->firstSequence
+                || size < sizeof(JournalHeader) + pHeader->capacity * sizeof(JournalRecord)
+                || m_ullSequence + 1 - pHeader->firstSequence >= pHeader->capacity)
+            {
+                // not written yet, or full and the next file is not created yet
+                munmap(pMap, size);
+                return false;
+            }
+            m_pMap = pMap;
+            m_ullMapSize = size;
+            m_pHeader = pHeader;
+            m_pRecord = (const JournalRecord*)((const char*)pMap + sizeof(JournalHeader));
+            m_ullIndex = m_ullSequence + 1 - pHeader->firstSequence;
+            return true;
+        }
+        void closeFile()
+        {
+            if (nullptr != m_pMap)
+            {
+                const volatile JournalHeader* pHeader = m_pHeader;
+                if (m_ullSequence == pHeader->stateSequence && 0 != pHeader->stateHash)
+                {
+                    m_bStateHash = true;
+                    m_ullStateHash = pHeader->stateHash;
+                }
+                munmap(m_pMap, m_ullMapSize);
+            }
+            m_pMap = nullptr;
+            m_ullMapSize = 0;
+            m_pHeader = nullptr;
+            m_pRecord = nullptr;
+            m_ullIndex = 0;
+            m_ullIdleCount = 0;
+        }
+
+    private:
+        std::string m_strPrefix;
+        unsigned long long m_ullSequence;     // sequence of the last record read
+        void* m_pMap;
+        size_t m_ullMapSize;
+        const JournalHeader* m_pHeader;
+        const JournalRecord* m_pRecord;
+        unsigned long long m_ullIndex;        // index of the next record in the current file
+        unsigned long long m_ullIdleCount;
+        bool m_bBroken;
+        bool m_bStateHash;
+        unsigned long long m_ullStateHash;
+    };
+}
+
+#endif //MATCHING_ENGINE_JOURNAL_H
@@ -0,0 +1,158 @@
+#ifndef MATCHING_ENGINE_LATENCY_H
+#define MATCHING_ENGINE_LATENCY_H
+
+#include <algorithm>
+#include <atomic>
+#include <string>
+
+#include "json.hpp"
+
+
+namespace OPNX {
+    // Log linear histogram of nano seconds like HdrHistogram: LATENCY_SUB_COUNT buckets for each power of two, a value is
+    // counted in a bucket less than 1/LATENCY_SUB_COUNT wider than the value. Values of more than LATENCY_MAX_BITS + 1 bits are
+    // counted in the last bucket. record is a relaxed increment, the threads of a stage don't wait for each other
+    // or for the reader, a reader may see a value in the count before it is in the max.
+    static const unsigned int LATENCY_SUB_BITS = 4;
+    static const unsigned int LATENCY_SUB_COUNT = 1 << LATENCY_SUB_BITS;
+    static const unsigned int LATENCY_MAX_BITS = 40;        // about 18 minutes
+    static const unsigned int LATENCY_BUCKET_COUNT = (LATENCY_MAX_BITS - LATENCY_SUB_BITS + 2) * LATENCY_SUB_COUNT;
+
+    class LatencyHistogram {
+    public:
+        LatencyHistogram() : m_ullMax(0)
+        {
+            for (auto& bucket: m_buckets)
+            {
+                bucket.store(0, std::memory_order_relaxed);
+            }
+        }
+        LatencyHistogram(const LatencyHistogram &) = delete;
+        LatencyHistogram &operator=(const LatencyHistogram &) = delete;
+
+        inline void record(unsigned long long ullNanos)
+        {
+            m_buckets[index(ullNanos)].fetch_add(1, std::memory_order_relaxed);
+            unsigned long long ullMax = m_ullMax.load(std::memory_order_relaxed);
+            while (ullNanos > ullMax && !m_ullMax.compare_exchange_weak(ullMax, ullNanos, std::memory_order_relaxed));
+        }
+
+        // {"count", "p50", "p90", "p99", "p999", "max"}, a percentile is the highest value of its bucket
+        nlohmann::json toJson() const
+        {
+            unsigned long long arrCount[LATENCY_BUCKET_COUNT];
+            unsigned long long ullTotal = 0;
+            for (unsigned int i = 0; i < LATENCY_BUCKET_COUNT; i++)
+            {
+                arrCount[i] = m_buckets[i].load(std::memory_order_relaxed);
+                ullTotal += arrCount[i];
+            }
+            unsigned long long ullMax = m_ullMax.load(std::memory_order_relaxed);
+            static const char* arrName[] = {"p50", "p90", "p99", "p999"};
+            static const unsigned long long arrPermille[] = {500, 900, 990, 999};
+            nlohmann::json jsonHistogram;
+            jsonHistogram["count"] = ullTotal;
+            for (unsigned int i = 0; i < sizeof(arrPermille) / sizeof(arrPermille[0]); i++)
+            {
+                // the bucket of the value with the rank of the percentile, 1 based and rounded up
+                unsigned long long ullRank = std::max(1ULL, (ullTotal * arrPermille[i] + 999) / 1000);
+                unsigned long long ullSeen = 0;
+                unsigned int uiBucket = 0;
+                for (; uiBucket < LATENCY_BUCKET_COUNT - 1; uiBucket++)
+                {
+                    ullSeen += arrCount[uiBucket];
+                    if (ullSeen >= ullRank)
+                    {
+                        break;
+                    }
+                }
+                jsonHistogram[arrName[i]] = 0 == ullTotal ? 0 : std::min(highest(uiBucket), ullMax);
+            }
+            jsonHistogram["max"] = ullMax;
+            return jsonHistogram;
+        }
+
+    private:
+        static inline unsigned int index(unsigned long long ullNanos)
+        {
+            if (ullNanos < LATENCY_SUB_COUNT)
+            {
+                return (unsigned int)ullNanos;
+            }
+            unsigned int uiBits = 63 - __builtin_clzll(ullNanos);
+            if (uiBits > LATENCY_MAX_BITS)
+            {
+                return LATENCY_BUCKET_COUNT - 1;
+            }
+            unsigned int uiShift = uiBits - LATENCY_SUB_BITS;
+            return (uiShift + 1) * LATENCY_SUB_COUNT + (unsigned int)(ullNanos >> uiShift) - LATENCY_SUB_COUNT;
+        }
+        static inline unsigned long long highest(unsigned int uiIndex)
+        {
+            if (uiIndex < LATENCY_SUB_COUNT)
+            {
+                return uiIndex;
+            }
+            unsigned int uiShift = uiIndex / LATENCY_SUB_COUNT - 1;
+            unsigned long long ullLowest = (unsigned long long)(LATENCY_SUB_COUNT + uiIndex % LATENCY_SUB_COUNT) << uiShift;
+            return ullLowest + (1ULL << uiShift) - 1;
+        }
+
+    private:
+        std::atomic<unsigned long long> m_buckets[LATENCY_BUCKET_COUNT];
+        std::atomic<unsigned long long> m_ullMax;
+    };
+
+    // The stages of the orders of one market, in nano seconds:
+    // DECODE     received by the proxy -> pushed to the queue of the manager
+    // QUEUE      pushed -> the ORDER_IN or TRIGGER_ORDER_IN thread starts to handle it, including the journal
+    // ENGINE     handled by the engine or the trigger order manager
+    // OUT_QUEUE  a report is pushed by the engine -> popped by an ORDER_OUT or ORDERS_OUT thread
+    // ENCODE     json of the report
+    // SEND       the proxy sends the report
+    // TOTAL      received by the proxy -> the report of the order is sent, the orders of the engine itself have none
+    class MarketLatency {
+    public:
+        enum Stage {
+            DECODE,
+            QUEUE,
+            ENGINE,
+            OUT_QUEUE,
+            ENCODE,
+            SEND,
+            TOTAL,
+            STAGE_COUNT,
+        };
+
+        MarketLatency(const std::string& strMarketCode) : m_strMarketCode(strMarketCode){};
+        MarketLatency(const MarketLatency &) = delete;
+        MarketLatency &operator=(const MarketLatency &) = delete;
+
+        const std::string& getMarketCode() const { return m_strMarketCode; }
+
+        inline void record(Stage stage, unsigned long long ullBegin, unsigned long long ullEnd)
+        {
+            if (0 != ullBegin && ullEnd >= ullBegin)
+            {
+                m_histograms[stage].record(ullEnd - ullBegin);
+            }
+        }
+
+        nlohmann::json toJson() const
+        {
+            static const char* arrName[] = {"decode", "queue", "engine", "outQueue", "encode", "send", "total"};
+            nlohmann::json jsonLatency;
+            for (int i = 0; i < STAGE_COUNT; i++)
+            {
+                jsonLatency[arrName[i]] = m_histograms[i].toJson();
+            }
+            return jsonLatency;
+        }
+
+    private:
+        std::string m_strMarketCode;
+        LatencyHistogram m_histograms[STAGE_COUNT];
+    };
+}
+
+#endif //MATCHING_ENGINE_LATENCY_H
@@ -8,6 +8,13 @@
 #include <iostream>
 #include <sstream>
 
+#include "async_log.h"
+
+// The most verbose level compiled in, the macros of a higher level compile to nothing, 6 is TRACE and 4 is INFO
+#ifndef OPNX_LOG_COMPILE_LEVEL
+#define OPNX_LOG_COMPILE_LEVEL 6
+#endif
+
 using CallBackPulsarLog = std::function<void(const std::string&)>;
 
 namespace OPNX {
@@ -17,14 +24,21 @@ namespace OPNX {
     private:
         std::ostream *stream_ptr;
         CallBackPulsarLog* pulsarLog;
+        AsyncLog* asyncLog;
+        const char* label;
 
     private:
-        explicit LogBuf(std::ostream *stream_ptr, CallBackPulsarLog *pulsarLog) noexcept: stream_ptr(stream_ptr), pulsarLog(pulsarLog) {}
+        explicit LogBuf(std::ostream *stream_ptr, CallBackPulsarLog *pulsarLog, AsyncLog *asyncLog, const char label[]) noexcept
+        : stream_ptr(stream_ptr), pulsarLog(pulsarLog), asyncLog(asyncLog), label(label) {}
 
     protected:
         int sync() override {
             auto ret = this->std::stringbuf::sync();
-            if (stream_ptr) {
+            if (stream_ptr && asyncLog) {
+                // the backend adds the prefix, writes and forwards it
+                asyncLog->push(label, nullptr != pulsarLog, pbase(), pptr() - pbase());
+                this->str("");
+            } else if (stream_ptr) {
                 auto str = this->str();
                 stream_ptr->write(str.data(), str.size()).flush();
 
@@ -45,8 +59,9 @@ namespace OPNX {
         LogBuf buf;
 
     private:
-        explicit LogStream(std::ostream *stream_ptr, CallBackPulsarLog *pulsarLog, const char label[]) : std::ostream(stream_ptr ? &buf : nullptr), buf(stream_ptr, pulsarLog) {
-            if (stream_ptr) {
+        explicit LogStream(std::ostream *stream_ptr, CallBackPulsarLog *pulsarLog, const char label[], AsyncLog *asyncLog = nullptr)
+        : std::ostream(stream_ptr ? &buf : nullptr), buf(stream_ptr, pulsarLog, asyncLog, label) {
+            if (stream_ptr && !asyncLog) {
                 auto now = std::chrono::system_clock::now();
                 std::time_t time = std::chrono::system_clock::to_time_t(now);
                 std::tm tm;
@@ -72,12 +87,35 @@ namespace OPNX {
         std::ostream *m_pLogStream;
         Log::Level m_level1;
         CallBackPulsarLog m_pPulsarLog;
+        std::atomic<AsyncLog*> m_pAsyncLog;      // nullptr: the records are written by the logging thread
+        AsyncLog* m_pAsyncLogBackend;
 
     public:
-        Log(CallBackPulsarLog &pulsarLog) : m_pLogStream(&std::clog), m_level1(INFO), m_pPulsarLog(pulsarLog) {}
-        Log(Level level, CallBackPulsarLog &pulsarLog) : m_pLogStream(&std::clog), m_level1(level), m_pPulsarLog(pulsarLog) {}
+        Log(CallBackPulsarLog &pulsarLog) : m_pLogStream(&std::clog), m_level1(INFO), m_pPulsarLog(pulsarLog), m_pAsyncLog(nullptr), m_pAsyncLogBackend(nullptr) {}
+        Log(Level level, CallBackPulsarLog &pulsarLog) : m_pLogStream(&std::clog), m_level1(level), m_pPulsarLog(pulsarLog), m_pAsyncLog(nullptr), m_pAsyncLogBackend(nullptr) {}
+        ~Log() { stopAsync(); delete m_pAsyncLogBackend; }
         void setPulsarLog(CallBackPulsarLog &pPulsarLog) { m_pPulsarLog = pPulsarLog; }
 
+        // Moves the writing of the records to the backend thread of an AsyncLog, strFile empty: m_pLogStream.
+        // The file and the ring size of the first call are kept.
+        bool startAsync(const std::string& strFile, unsigned long long ullRingSize) {
+            if (nullptr == m_pAsyncLogBackend) {
+                m_pAsyncLogBackend = new AsyncLog(strFile, ullRingSize, m_pLogStream, &m_pPulsarLog);
+            }
+            if (!m_pAsyncLogBackend->start()) {
+                return false;
+            }
+            m_pAsyncLog = m_pAsyncLogBackend;
+            return true;
+        }
+        // Back to the synchronous log after the records of the rings are written
+        void stopAsync() {
+            m_pAsyncLog = nullptr;
+            if (nullptr != m_pAsyncLogBackend) {
+                m_pAsyncLogBackend->stop();
+            }
+        }
+
     public:
         inline void setLogLevel(Level level) { m_level1 = level; }
         inline bool enabledLevel(Level level) { return m_level1 >= level ? true : false; }
@@ -89,37 +127,71 @@ namespace OPNX {
         inline bool enabledError() { return m_level1 >= ERROR ? true : false; }
         inline bool enabledFatal() { return m_level1 >= FATAL ? true : false; }
 
-        LogStream trace() { return m_level1 >= TRACE ? LogStream(m_pLogStream, nullptr, "TRACE") : LogStream(nullptr, nullptr, "TRACE"); }
-        LogStream debug() { return m_level1 >= DEBUG ? LogStream(m_pLogStream, nullptr, "DEBUG") : LogStream(nullptr, nullptr, "DEBUG"); }
-        LogStream info() { return m_level1 >= INFO ? LogStream(m_pLogStream, &m_pPulsarLog, "INFO") : LogStream(nullptr, nullptr, "INFO"); }
-        LogStream warn() { return m_level1 >= WARN ? LogStream(m_pLogStream, &m_pPulsarLog, "WARN") : LogStream(nullptr, nullptr, "WARN"); }
-        LogStream error() { return m_level1 >= ERROR ? LogStream(m_pLogStream, &m_pPulsarLog, "ERROR") : LogStream(nullptr, nullptr, "ERROR"); }
-        LogStream fatal() { return m_level1 >= FATAL ? LogStream(m_pLogStream, &m_pPulsarLog, "FATAL") : LogStream(nullptr, nullptr, "FATAL"); }
-        LogStream printInfo() { return m_level1 >= FATAL ? LogStream(m_pLogStream, &m_pPulsarLog, "INFO") : LogStream(nullptr, nullptr, "INFO"); }
+        LogStream trace() { return m_level1 >= TRACE ? LogStream(m_pLogStream, nullptr, "TRACE", m_pAsyncLog.load(std::memory_order_relaxed)) : LogStream(nullptr, nullptr, "TRACE"); }
+        LogStream debug() { return m_level1 >= DEBUG ? LogStream(m_pLogStream, nullptr, "DEBUG", m_pAsyncLog.load(std::memory_order_relaxed)) : LogStream(nullptr, nullptr, "DEBUG"); }
+        LogStream info() { return m_level1 >= INFO ? LogStream(m_pLogStream, &m_pPulsarLog, "INFO", m_pAsyncLog.load(std::memory_order_relaxed)) : LogStream(nullptr, nullptr, "INFO"); }
+        LogStream warn() { return m_level1 >= WARN ? LogStream(m_pLogStream, &m_pPulsarLog, "WARN", m_pAsyncLog.load(std::memory_order_relaxed)) : LogStream(nullptr, nullptr, "WARN"); }
+        LogStream error() { return m_level1 >= ERROR ? LogStream(m_pLogStream, &m_pPulsarLog, "ERROR", m_pAsyncLog.load(std::memory_order_relaxed)) : LogStream(nullptr, nullptr, "ERROR"); }
+        LogStream fatal() { return m_level1 >= FATAL ? LogStream(m_pLogStream, &m_pPulsarLog, "FATAL", m_pAsyncLog.load(std::memory_order_relaxed)) : LogStream(nullptr, nullptr, "FATAL"); }
+        LogStream printInfo() { return m_level1 >= FATAL ? LogStream(m_pLogStream, &m_pPulsarLog, "INFO", m_pAsyncLog.load(std::memory_order_relaxed)) : LogStream(nullptr, nullptr, "INFO"); }
 
     };
 }
 
 extern OPNX::Log cfLog;   // Declare a global log object, please define it in the main.cpp file to ensure that the log object is available
 
+// The arguments of the stream are evaluated only if the level is compiled in and enabled,
+// use them instead of cfLog.debug() << ... on the order paths
+#define OPNX_LOG_LEVEL(level, stream) \
+    if (OPNX_LOG_COMPILE_LEVEL < OPNX::Log::level || !cfLog.enabledLevel(OPNX::Log::level)) {} else cfLog.stream()
+
+#define OPNX_LOG_TRACE OPNX_LOG_LEVEL(TRACE, trace)
+#define OPNX_LOG_DEBUG OPNX_LOG_LEVEL(DEBUG, debug)
+#define OPNX_LOG_INFO OPNX_LOG_LEVEL(INFO, info)
+#define OPNX_LOG_WARN OPNX_LOG_LEVEL(WARN, warn)
+#define OPNX_LOG_ERROR OPNX_LOG_LEVEL(ERROR, error)
+
 namespace OPNX {
+    // Logs the flag at DEBUG when the scope is entered and left. The flag is kept by pointer and the prefix by reference,
+    // nothing is copied or formatted while DEBUG is disabled, so both must outlive the scope.
     class CInOutLog {
     public:
-        CInOutLog(const char *szFlag) {
-            m_strFlag = szFlag;
-            cfLog.debug() << " CInOutLog: " << m_strFlag << " in " << std::endl;
+        CInOutLog(const char *szFlag) : m_pStrPrefix(nullptr), m_szFlag(szFlag), m_bEnabled(cfLog.enabledDebug()) {
+            if (m_bEnabled) {
+                cfLog.debug() << " CInOutLog: " << m_szFlag << " in " << std::endl;
+            }
         }
-        CInOutLog(const std::string& strFlag) {
-            m_strFlag = strFlag;
-            cfLog.debug() << " CInOutLog: " << m_strFlag << " in " << std::endl;
+        CInOutLog(const std::string& strPrefix, const char *szFlag) : m_pStrPrefix(&strPrefix), m_szFlag(szFlag), m_bEnabled(cfLog.enabledDebug()) {
+            if (m_bEnabled) {
+                cfLog.debug() << " CInOutLog: " << *m_pStrPrefix << " " << m_szFlag << " in " << std::endl;
+            }
         }
+        CInOutLog(const CInOutLog &) = delete;
+        CInOutLog &operator=(const CInOutLog &) = delete;
 
         ~CInOutLog() {
-            cfLog.debug() << " CInOutLog: " << m_strFlag << " out " << std::endl;
+            if (!m_bEnabled) {
+                return;
+            }
+            if (m_pStrPrefix) {
+                cfLog.debug() << " CInOutLog: " << *m_pStrPrefix << " " << m_szFlag << " out " << std::endl;
+            } else {
+                cfLog.debug() << " CInOutLog: " << m_szFlag << " out " << std::endl;
+            }
         }
 
     private:
-        std::string m_strFlag;
+        const std::string* m_pStrPrefix;
+        const char* m_szFlag;
+        bool m_bEnabled;
     };
 }
-#endif  // __OPNX_LOG_H__
\ No newline at end of file
+
+// OPNX_TRACE_SCOPE("flag") or OPNX_TRACE_SCOPE(m_strMarketCode, "flag"), nothing when DEBUG is not compiled in
+#if OPNX_LOG_COMPILE_LEVEL >= 5
+#define OPNX_TRACE_SCOPE(...) OPNX::CInOutLog cInOutLog(__VA_ARGS__)
+#else
+#define OPNX_TRACE_SCOPE(...) do {} while (0)
+#endif
+
+#endif  // __OPNX_LOG_H__
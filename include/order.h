@@ -19,6 +19,7 @@ namespace OPNX {
     // json key of order response
     static const char* key_payloadType = "pt";            // json key is pt
     static const char* key_orderList = "ol";              // json key is mid
+    static const char* key_quoteList = "ql";              // json key is ql, quotes of MASS_QUOTE
     // json key of order
     static const char* key_accountId = "aid";             // json key is aid
     static const char* key_marketId = "mid";              // json key is mid
@@ -54,6 +55,7 @@ namespace OPNX {
     static const char* key_matchedType = "mt";            // json key is mt
     static const char* key_timestamp = "t";               // json key is t
     static const char* key_orderCreated = "oc";           // json key is oc
+    static const char* key_expireTime = "et";             // json key is et
     static const char* key_source = "sc";                 // json key is sc
     static const char* key_tag = "tag";                   // json key is tag
     static const char* key_selfTradeProtection = "stp";   // json key is stp
@@ -87,6 +89,9 @@ namespace OPNX {
             RECOVERY = 0x03,
             RECOVERY_END = 0x04,
             TRIGGER_BRACKET = 0x05,
+            AUCTION_UNCROSS = 0x06,
+            MASS_QUOTE = 0x07,
+            CANCEL_REPLACE = 0x08,
         };
         enum OrderTimeCondition : unsigned char {
             GTC = 0x00,
@@ -95,6 +100,7 @@ namespace OPNX {
             MAKER_ONLY = 0x03,
             MAKER_ONLY_REPRICE = 0x04,
             AUCTION = 0x05,
+            GTT = 0x06,     // good till expireTime, GTC without an expireTime
         };
         enum TriggerType : unsigned char {
             MARK_PRICE,
@@ -125,6 +131,7 @@ namespace OPNX {
             CANCELED_BY_PRE_AUCTION,
             CANCELED_BY_BRACKET_ORDER,
             CANCELED_BY_SELF_TRADE_PROTECTION,
+            CANCELED_BY_EXPIRY,
             REJECT_CANCEL_ORDER_ID_NOT_FOUND,
             REJECT_AMEND_ORDER_ID_NOT_FOUND,
             REJECT_DISPLAY_QUANTITY_ZERO,
@@ -142,6 +149,8 @@ namespace OPNX {
             REJECT_QUANTITY_AND_AMOUNT_LARGER_ZERO,
             REJECT_AMEND_ORDER_IS_TRIGGERED,
             REJECT_AMEND_NEW_QUANTITY_IS_LESS_THAN_MATCHED_QUANTITY,
+            REJECT_QUOTE_ORDER_ID_ZERO,     // a quote of a MASS_QUOTE is known by its orderId
+            REJECT_MASS_QUOTE_INCOMPLETE,   // the quotes of a MASS_QUOTE did not arrive together
         };
         enum OrderMatchedType : unsigned char {
             MAKER = 0x00,
@@ -173,7 +182,11 @@ namespace OPNX {
         long long triggerPrice;
         unsigned long long timestamp;
         unsigned long long orderCreated;   // order created timestamp
+        unsigned long long expireTime;     // GTT: milli seconds, the order is canceled by the engine at this time
+        unsigned long long receivedTime;   // nano seconds: received by the proxy, 0 for the orders of the manager and the engine
+        unsigned long long queuedTime;     // nano seconds: pushed to a queue of the manager
         int source; // unused, leslie generation
+        unsigned int quoteCount;   // MASS_QUOTE: quotes left in the same mass quote, including this one
         bool isTriggered;
         TriggerType triggerType;
         OrderSide side;
@@ -213,7 +226,11 @@ namespace OPNX {
                 triggerPrice(MAX_PRICE),
                 timestamp(0),
                 orderCreated(0),
+                expireTime(0),
+                receivedTime(0),
+                queuedTime(0),
                 source(0),
+                quoteCount(0),
                 isTriggered(false),
                 triggerType(TriggerType::TRIGGER_NONE),
                 side(OrderSide::BUY),
@@ -270,7 +287,7 @@ namespace OPNX {
 
         static void orderToJsonString0(const OPNX::Order& order, std::string& jsonOrderString)
         {
-            OPNX::CInOutLog cInOutLog("orderToJsonString");
+            OPNX_TRACE_SCOPE("orderToJsonString");
 
             std::string triggerType = "";
             switch (order.triggerType) {
@@ -314,6 +331,9 @@ namespace OPNX {
                 case RECOVERY    : action = "RECOVERY"    ; break;
                 case RECOVERY_END: action = "RECOVERY_END"; break;
                 case TRIGGER_BRACKET: action = "TRIGGER_BRACKET"; break;
+                case AUCTION_UNCROSS: action = "AUCTION_UNCROSS"; break;
+                case MASS_QUOTE: action = "MASS_QUOTE"; break;
+                case CANCEL_REPLACE: action = "CANCEL_REPLACE"; break;
                 default: break;
             }
 
@@ -325,6 +345,7 @@ namespace OPNX {
                 case MAKER_ONLY        : timeCondition = "MAKER_ONLY"; break;
                 case MAKER_ONLY_REPRICE: timeCondition = "MAKER_ONLY_REPRICE"; break;
                 case AUCTION           : timeCondition = "AUCTION"; break;
+                case GTT               : timeCondition = "GTT"; break;
                 default: break;
             }
 
@@ -355,6 +376,7 @@ namespace OPNX {
                 case CANCELED_BY_NO_AUCTION                         : status = "CANCELED_BY_NO_AUCTION"; break;
                 case CANCELED_BY_PRE_AUCTION                        : status = "CANCELED_BY_PRE_AUCTION"; break;
                 case CANCELED_BY_BRACKET_ORDER                      : status = "CANCELED_BY_BRACKET_ORDER"; break;
+                case CANCELED_BY_EXPIRY                             : status = "CANCELED_BY_EXPIRY"; break;
                 case REJECT_CANCEL_ORDER_ID_NOT_FOUND               : status = "REJECT_CANCEL_ORDER_ID_NOT_FOUND"; break;
                 case REJECT_AMEND_ORDER_ID_NOT_FOUND                : status = "REJECT_AMEND_ORDER_ID_NOT_FOUND"; break;
                 case REJECT_DISPLAY_QUANTITY_ZERO                   : status = "REJECT_DISPLAY_QUANTITY_ZERO"; break;
@@ -370,6 +392,8 @@ namespace OPNX {
                 case REJECT_STOP_CONDITION_IS_NONE                  : status = "REJECT_STOP_CONDITION_IS_NONE"; break;
                 case REJECT_STOP_TRIGGER_PRICE_IS_NONE              : status = "REJECT_STOP_TRIGGER_PRICE_IS_NONE"; break;
                 case REJECT_QUANTITY_AND_AMOUNT_LARGER_ZERO         : status = "REJECT_QUANTITY_AND_AMOUNT_LARGER_ZERO"; break;
+                case REJECT_QUOTE_ORDER_ID_ZERO                     : status = "REJECT_QUOTE_ORDER_ID_ZERO"; break;
+                case REJECT_MASS_QUOTE_INCOMPLETE                   : status = "REJECT_MASS_QUOTE_INCOMPLETE"; break;
                 default: break;
             }
 
@@ -395,7 +419,7 @@ namespace OPNX {
                     << ",\"bid\":" << order.bracketOrderId << ",\"tpid\":" << order.takeProfitOrderId
                     << ",\"slid\":" << order.stopLossOrderId
                     << ",\"tp\":" << order.triggerPrice << ",\"it\":" << isTriggered
-                    << ",\"t\":" << timestamp << ",\"oc\":" << order.orderCreated
+                    << ",\"t\":" << timestamp << ",\"oc\":" << order.orderCreated << ",\"et\":" << order.expireTime
                     << ",\"sc\":" << order.source << ",\"tag\":\"" << order.tag
                     << "\",\"tt\":\"" << triggerType << "\",\"s\":\"" << side
                     << "\",\"ty\":\"" << type << "\",\"stc\":\"" << stopCondition
@@ -471,6 +495,9 @@ namespace OPNX {
                 case RECOVERY    : action = "RECOVERY"    ; break;
                 case RECOVERY_END: action = "RECOVERY_END"; break;
                 case TRIGGER_BRACKET: action = "TRIGGER_BRACKET"; break;
+                case AUCTION_UNCROSS: action = "AUCTION_UNCROSS"; break;
+                case MASS_QUOTE: action = "MASS_QUOTE"; break;
+                case CANCEL_REPLACE: action = "CANCEL_REPLACE"; break;
                 default: break;
             }
 
@@ -482,6 +509,7 @@ namespace OPNX {
                 case MAKER_ONLY        : timeCondition = "MAKER_ONLY"; break;
                 case MAKER_ONLY_REPRICE: timeCondition = "MAKER_ONLY_REPRICE"; break;
                 case AUCTION           : timeCondition = "AUCTION"; break;
+                case GTT               : timeCondition = "GTT"; break;
                 default: break;
             }
 
@@ -513,6 +541,7 @@ namespace OPNX {
                 case CANCELED_BY_PRE_AUCTION                        : status = "CANCELED_BY_PRE_AUCTION"; break;
                 case CANCELED_BY_BRACKET_ORDER                      : status = "CANCELED_BY_BRACKET_ORDER"; break;
                 case CANCELED_BY_SELF_TRADE_PROTECTION              : status = "CANCELED_BY_SELF_TRADE_PROTECTION"; break;
+                case CANCELED_BY_EXPIRY                             : status = "CANCELED_BY_EXPIRY"; break;
                 case REJECT_CANCEL_ORDER_ID_NOT_FOUND               : status = "REJECT_CANCEL_ORDER_ID_NOT_FOUND"; break;
                 case REJECT_AMEND_ORDER_ID_NOT_FOUND                : status = "REJECT_AMEND_ORDER_ID_NOT_FOUND"; break;
                 case REJECT_DISPLAY_QUANTITY_ZERO                   : status = "REJECT_DISPLAY_QUANTITY_ZERO"; break;
@@ -528,6 +557,8 @@ namespace OPNX {
                 case REJECT_STOP_CONDITION_IS_NONE                  : status = "REJECT_STOP_CONDITION_IS_NONE"; break;
                 case REJECT_STOP_TRIGGER_PRICE_IS_NONE              : status = "REJECT_STOP_TRIGGER_PRICE_IS_NONE"; break;
                 case REJECT_QUANTITY_AND_AMOUNT_LARGER_ZERO         : status = "REJECT_QUANTITY_AND_AMOUNT_LARGER_ZERO"; break;
+                case REJECT_QUOTE_ORDER_ID_ZERO                     : status = "REJECT_QUOTE_ORDER_ID_ZERO"; break;
+                case REJECT_MASS_QUOTE_INCOMPLETE                   : status = "REJECT_MASS_QUOTE_INCOMPLETE"; break;
                 default: break;
             }
 
@@ -555,7 +586,7 @@ namespace OPNX {
                      "\"mtid\":%llu,\"sid\":%llu,"
                      "\"bid\":%llu,\"tpid\":%llu,\"slid\":%llu,"
                      "\"tp\":%lld,\"it\":%s,"
-                     "\"t\":%llu,\"oc\":%llu,"
+                     "\"t\":%llu,\"oc\":%llu,\"et\":%llu,"
                      "\"sc\":%d,\"tag\":\"%s\","
                      "\"tt\":\"%s\",\"s\":\"%s\","
                      "\"ty\":\"%s\",\"stc\":\"%s\","
@@ -572,7 +603,7 @@ namespace OPNX {
                      order.matchedId, order.sortId,
                      order.bracketOrderId, order.takeProfitOrderId, order.stopLossOrderId,
                      order.triggerPrice, isTriggered.c_str(),
-                     timestamp, order.orderCreated,
+                     timestamp, order.orderCreated, order.expireTime,
                      order.source, order.tag,
                      triggerType.c_str(), side.c_str(),
                      type.c_str(), stopCondition.c_str(),
@@ -619,7 +650,7 @@ namespace OPNX {
 
         static void orderToJson(const OPNX::Order& order, nlohmann::json& jsonOrder)
         {
-            OPNX::CInOutLog cInOutLog("orderToJson");
+            OPNX_TRACE_SCOPE("orderToJson");
 
             jsonOrder[key_accountId] = order.accountId;
             jsonOrder[key_marketId] = order.marketId;
@@ -647,6 +678,7 @@ namespace OPNX {
             jsonOrder[key_isTriggered] = order.isTriggered;
             jsonOrder[key_timestamp] = 0 != order.timestamp ? order.timestamp : Utils::getMilliTimestamp();
             jsonOrder[key_orderCreated] = order.orderCreated;
+            jsonOrder[key_expireTime] = order.expireTime;
             jsonOrder[key_source] = order.source;
             jsonOrder[key_tag] = std::string(order.tag);
 
@@ -687,6 +719,9 @@ namespace OPNX {
                 case RECOVERY    : jsonOrder[key_action] = "RECOVERY"    ; break;
                 case RECOVERY_END: jsonOrder[key_action] = "RECOVERY_END"; break;
                 case TRIGGER_BRACKET: jsonOrder[key_action] = "TRIGGER_BRACKET"; break;
+                case AUCTION_UNCROSS: jsonOrder[key_action] = "AUCTION_UNCROSS"; break;
+                case MASS_QUOTE: jsonOrder[key_action] = "MASS_QUOTE"; break;
+                case CANCEL_REPLACE: jsonOrder[key_action] = "CANCEL_REPLACE"; break;
                 default: break;
             }
 
@@ -697,6 +732,7 @@ namespace OPNX {
                 case MAKER_ONLY        : jsonOrder[key_timeCondition] = "MAKER_ONLY"; break;
                 case MAKER_ONLY_REPRICE: jsonOrder[key_timeCondition] = "MAKER_ONLY_REPRICE"; break;
                 case AUCTION           : jsonOrder[key_timeCondition] = "AUCTION"; break;
+                case GTT               : jsonOrder[key_timeCondition] = "GTT"; break;
                 default: break;
             }
 
@@ -726,6 +762,7 @@ namespace OPNX {
                 case CANCELED_BY_PRE_AUCTION                        : jsonOrder[key_status] = "CANCELED_BY_PRE_AUCTION"; break;
                 case CANCELED_BY_BRACKET_ORDER                      : jsonOrder[key_status] = "CANCELED_BY_BRACKET_ORDER"; break;
                 case CANCELED_BY_SELF_TRADE_PROTECTION              : jsonOrder[key_status] = "CANCELED_BY_SELF_TRADE_PROTECTION"; break;
+                case CANCELED_BY_EXPIRY                             : jsonOrder[key_status] = "CANCELED_BY_EXPIRY"; break;
                 case REJECT_CANCEL_ORDER_ID_NOT_FOUND               : jsonOrder[key_status] = "REJECT_CANCEL_ORDER_ID_NOT_FOUND"; break;
                 case REJECT_AMEND_ORDER_ID_NOT_FOUND                : jsonOrder[key_status] = "REJECT_AMEND_ORDER_ID_NOT_FOUND"; break;
                 case REJECT_DISPLAY_QUANTITY_ZERO                   : jsonOrder[key_status] = "REJECT_DISPLAY_QUANTITY_ZERO"; break;
@@ -741,6 +778,8 @@ namespace OPNX {
                 case REJECT_STOP_CONDITION_IS_NONE                  : jsonOrder[key_status] = "REJECT_STOP_CONDITION_IS_NONE"; break;
                 case REJECT_STOP_TRIGGER_PRICE_IS_NONE              : jsonOrder[key_status] = "REJECT_STOP_TRIGGER_PRICE_IS_NONE"; break;
                 case REJECT_QUANTITY_AND_AMOUNT_LARGER_ZERO         : jsonOrder[key_status] = "REJECT_QUANTITY_AND_AMOUNT_LARGER_ZERO"; break;
+                case REJECT_QUOTE_ORDER_ID_ZERO                     : jsonOrder[key_status] = "REJECT_QUOTE_ORDER_ID_ZERO"; break;
+                case REJECT_MASS_QUOTE_INCOMPLETE                   : jsonOrder[key_status] = "REJECT_MASS_QUOTE_INCOMPLETE"; break;
                 default: break;
             }
 
@@ -753,7 +792,7 @@ namespace OPNX {
 
         static void jsonToOrder(const nlohmann::json& jsonOrder, OPNX::Order& order)
         {
-            OPNX::CInOutLog cInOutLog("jsonToOrder");
+            OPNX_TRACE_SCOPE("jsonToOrder");
 
             auto it = jsonOrder.find(key_accountId);
             if (jsonOrder.end() != it)
@@ -897,6 +936,11 @@ namespace OPNX {
             {
                 order.orderCreated = it->get<unsigned long long>();
             }
+            it = jsonOrder.find(key_expireTime);
+            if (jsonOrder.end() != it)
+            {
+                order.expireTime = it->get<unsigned long long>();
+            }
             it = jsonOrder.find(key_source);
             if (jsonOrder.end() != it)
             {
@@ -1036,6 +1080,18 @@ namespace OPNX {
                 {
                     order.action = OrderActionType::TRIGGER_BRACKET;
                 }
+                else if ("AUCTION_UNCROSS" == action)
+                {
+                    order.action = OrderActionType::AUCTION_UNCROSS;
+                }
+                else if ("MASS_QUOTE" == action)
+                {
+                    order.action = OrderActionType::MASS_QUOTE;
+                }
+                else if ("CANCEL_REPLACE" == action)
+                {
+                    order.action = OrderActionType::CANCEL_REPLACE;
+                }
             }
             it = jsonOrder.find(key_timeCondition);
             if (jsonOrder.end() != it)
@@ -1065,6 +1121,10 @@ namespace OPNX {
                 {
                     order.timeCondition = OrderTimeCondition::AUCTION;
                 }
+                else if ("GTT" == timeCondition)
+                {
+                    order.timeCondition = OrderTimeCondition::GTT;
+                }
             }
 
             it = jsonOrder.find(key_selfTradeProtection);
@@ -1174,6 +1234,10 @@ namespace OPNX {
                 {
                     order.status = OrderStatusType::CANCELED_BY_SELF_TRADE_PROTECTION;
                 }
+                else if ("CANCELED_BY_EXPIRY" == status)
+                {
+                    order.status = OrderStatusType::CANCELED_BY_EXPIRY;
+                }
                 else if ("REJECT_CANCEL_ORDER_ID_NOT_FOUND" == status)
                 {
                     order.status = OrderStatusType::REJECT_CANCEL_ORDER_ID_NOT_FOUND;
@@ -1234,11 +1298,19 @@ namespace OPNX {
                 {
                     order.status = OrderStatusType::REJECT_QUANTITY_AND_AMOUNT_LARGER_ZERO;
                 }
+                else if ("REJECT_QUOTE_ORDER_ID_ZERO" == status)
+                {
+                    order.status = OrderStatusType::REJECT_QUOTE_ORDER_ID_ZERO;
+                }
+                else if ("REJECT_MASS_QUOTE_INCOMPLETE" == status)
+                {
+                    order.status = OrderStatusType::REJECT_MASS_QUOTE_INCOMPLETE;
+                }
             }
 
         }
 
-        static void rapidjsonToOrder(const rapidjson::Document& jsonOrder, OPNX::Order& order)
+        static void rapidjsonToOrder(const rapidjson::Value& jsonOrder, OPNX::Order& order)
         {
 //            OPNX::CInOutLog cInOutLog("rapidjsonToOrder");
 
@@ -1384,6 +1456,11 @@ namespace OPNX {
             {
                 order.orderCreated = it->value.GetUint64();
             }
+            it = jsonOrder.FindMember(key_expireTime);
+            if (jsonOrder.MemberEnd() != it)
+            {
+                order.expireTime = it->value.GetUint64();
+            }
             it = jsonOrder.FindMember(key_source);
             if (jsonOrder.MemberEnd() != it)
             {
@@ -1523,6 +1600,18 @@ namespace OPNX {
                 {
                     order.action = OrderActionType::TRIGGER_BRACKET;
                 }
+                else if ("AUCTION_UNCROSS" == action)
+                {
+                    order.action = OrderActionType::AUCTION_UNCROSS;
+                }
+                else if ("MASS_QUOTE" == action)
+                {
+                    order.action = OrderActionType::MASS_QUOTE;
+                }
+                else if ("CANCEL_REPLACE" == action)
+                {
+                    order.action = OrderActionType::CANCEL_REPLACE;
+                }
             }
             it = jsonOrder.FindMember(key_timeCondition);
             if (jsonOrder.MemberEnd() != it)
@@ -1552,6 +1641,10 @@ namespace OPNX {
                 {
                     order.timeCondition = OrderTimeCondition::AUCTION;
                 }
+                else if ("GTT" == timeCondition)
+                {
+                    order.timeCondition = OrderTimeCondition::GTT;
+                }
             }
 
             it = jsonOrder.FindMember(key_selfTradeProtection);
@@ -1661,6 +1754,10 @@ namespace OPNX {
                 {
                     order.status = OrderStatusType::CANCELED_BY_SELF_TRADE_PROTECTION;
                 }
+                else if ("CANCELED_BY_EXPIRY" == status)
+                {
+                    order.status = OrderStatusType::CANCELED_BY_EXPIRY;
+                }
                 else if ("REJECT_CANCEL_ORDER_ID_NOT_FOUND" == status)
                 {
                     order.status = OrderStatusType::REJECT_CANCEL_ORDER_ID_NOT_FOUND;
@@ -1721,6 +1818,14 @@ namespace OPNX {
                 {
                     order.status = OrderStatusType::REJECT_QUANTITY_AND_AMOUNT_LARGER_ZERO;
                 }
+                else if ("REJECT_QUOTE_ORDER_ID_ZERO" == status)
+                {
+                    order.status = OrderStatusType::REJECT_QUOTE_ORDER_ID_ZERO;
+                }
+                else if ("REJECT_MASS_QUOTE_INCOMPLETE" == status)
+                {
+                    order.status = OrderStatusType::REJECT_MASS_QUOTE_INCOMPLETE;
+                }
             }
 
         }
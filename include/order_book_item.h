@@ -5,6 +5,12 @@
 #ifndef MATCHING_ENGINE_ORDER_BOOK_ITEM_H
 #define MATCHING_ENGINE_ORDER_BOOK_ITEM_H
 
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+#include "order.h"
+
 
 namespace OPNX {
     class OrderBookItem {
@@ -46,10 +52,72 @@ namespace OPNX {
         }
     };
 
+    // Orders of one account resting at a price level, used by self trade protection
+    class LevelAccountItem {
+    public:
+        unsigned long long orderCount;
+        unsigned long long quantity;       // sum of remainQuantity
+
+        LevelAccountItem()
+        : orderCount(0)
+        , quantity(0)
+        {}
+    };
+
     class SortOrderBook {
     public:
         OrderBookItem obItem;
         OPNX::SortOrderMap sortMapOrder;
+        std::unordered_map<unsigned long long, LevelAccountItem> unmapAccountItem;   // key is accountId
+
+        inline void addAccountOrder(unsigned long long accountId, unsigned long long remainQuantity)
+        {
+            LevelAccountItem& accountItem = unmapAccountItem[accountId];
+            accountItem.orderCount++;
+            accountItem.quantity += remainQuantity;
+        }
+        inline void eraseAccountOrder(unsigned long long accountId, unsigned long long remainQuantity)
+        {
+            auto it = unmapAccountItem.find(accountId);
+            if (unmapAccountItem.end() != it)
+            {
+                if (1 >= it->second.orderCount)
+                {
+                    unmapAccountItem.erase(it);
+                }
+                else
+                {
+                    it->second.orderCount--;
+                    it->second.quantity -= remainQuantity;
+                }
+            }
+        }
+        inline void updateAccountOrder(unsigned long long accountId, unsigned long long oldRemainQuantity, unsigned long long newRemainQuantity)
+        {
+            auto it = unmapAccountItem.find(accountId);
+            if (unmapAccountItem.end() != it)
+            {
+                it->second.quantity = it->second.quantity - oldRemainQuantity + newRemainQuantity;
+            }
+        }
+        inline const LevelAccountItem* findAccount(unsigned long long accountId) const
+        {
+            auto it = unmapAccountItem.find(accountId);
+            return unmapAccountItem.end() != it ? &(it->second) : nullptr;
+        }
+    };
+
+    // A price level of the spread snapshot: the resting quantity of each account at the price
+    class SpreadLevelItem {
+    public:
+        long long price;
+        double spread;                  // percent of the mid price
+        std::vector<std::pair<unsigned long long, unsigned long long>> vecAccountQuantity;    // accountId, quantity
+
+        SpreadLevelItem()
+        : price(0)
+        , spread(0)
+        {}
     };
 
     using OrderBookAscendMap = std::map<long long, SortOrderBook, std::less<long long>>;    // key is price
@@ -0,0 +1,157 @@
+#ifndef MATCHING_ENGINE_ORDER_ROUTER_H
+#define MATCHING_ENGINE_ORDER_ROUTER_H
+
+#include <vector>
+
+#include "thread_queue.h"
+#include "order.h"
+#include "utils.h"
+
+
+namespace OPNX {
+    // Checks the orders of a transport and pushes them into the queues of the manager, the same way as the pulsar proxy:
+    // orders that wait for a trigger and cancel all go to the trigger order queue, the others to the order queue.
+    // A rejected order gets its status, the transport sends the report.
+    class OrderRouter {
+    public:
+        OrderRouter(OPNX::OrderQueue<OPNX::Order>* pOrderQueue, OPNX::OrderQueue<OPNX::Order>* pTriggerOrderQueue)
+        : m_pOrderQueue(pOrderQueue)
+        , m_pTriggerOrderQueue(pTriggerOrderQueue){};
+
+        static bool checkOrder(OPNX::Order& order)
+        {
+            if (OPNX::Order::AUCTION == order.timeCondition || OPNX::Order::AUCTION_UNCROSS == order.action || OPNX::Order::CANCEL == order.action)  // don't check AUCTION order and CANCEL order
+            {
+                return true;
+            }
+            if (0 == order.quantity && 0 == order.amount
+                && (OPNX::Order::NEW == order.action || OPNX::Order::AMEND == order.action || OPNX::Order::CANCEL_REPLACE == order.action
+                    || OPNX::Order::RECOVERY == order.action))
+            {
+                order.status = OPNX::Order::REJECT_QUANTITY_AND_AMOUNT_ZERO;
+                return false;
+            }
+            if (0 < order.quantity && 0 < order.amount)
+            {
+                order.status = OPNX::Order::REJECT_QUANTITY_AND_AMOUNT_LARGER_ZERO;
+                return false;
+            }
+            if (OPNX::Order::STOP_LIMIT == order.type || OPNX::Order::STOP_MARKET == order.type)
+            {
+                if (OPNX::Order::NONE == order.stopCondition)
+                {
+                    order.status = OPNX::Order::REJECT_STOP_CONDITION_IS_NONE;
+                    return false;
+                }
+                if (OPNX::Order::MAX_PRICE == order.triggerPrice)
+                {
+                    order.status = OPNX::Order::REJECT_STOP_TRIGGER_PRICE_IS_NONE;
+                    return false;
+                }
+            }
+            if (0 < order.quantity && order.quantity < order.displayQuantity)
+            {
+                order.status = OPNX::Order::REJECT_DISPLAY_QUANTITY_LARGER_THAN_QUANTITY;
+                return false;
+            }
+            if (0 >= order.displayQuantity && 0 == order.amount)
+            {
+                order.status = OPNX::Order::REJECT_DISPLAY_QUANTITY_ZERO;
+                return false;
+            }
+            if (OPNX::Order::LIMIT == order.type && OPNX::Order::MAX_PRICE == order.price)
+            {
+                order.status = OPNX::Order::REJECT_LIMIT_ORDER_WITH_MARKET_PRICE;
+                return false;
+            }
+            return true;
+        }
+
+        // Returns false if the order is rejected
+        bool pushOrder(OPNX::Order& order)
+        {
+            if (!checkOrder(order))
+            {
+                return false;
+            }
+            order.queuedTime = OPNX::Utils::getNanoTimestamp();
+            if ((!order.isTriggered && (OPNX::Order::STOP_LIMIT == order.type || OPNX::Order::STOP_MARKET == order.type
+                                        || OPNX::Order::TAKE_PROFIT_LIMIT == order.type || OPNX::Order::TAKE_PROFIT_MARKET == order.type))
+                || (OPNX::Order::CANCEL == order.action && 0 == order.orderId))
+            {
+                if (m_pTriggerOrderQueue)
+                {
+                    m_pTriggerOrderQueue->push(order);
+                }
+            }
+            else
+            {
+                if (m_pOrderQueue)
+                {
+                    m_pOrderQueue->push(order);
+                }
+            }
+            return true;
+        }
+
+        // vecQuote are the quotes of one mass quote, a single quote without quantity cancels all quotes of the account.
+        // The rejected quotes are moved to vecReject and the others are counted again, all quotes rejected cancels all quotes.
+        void pushMassQuote(std::vector<OPNX::Order>& vecQuote, std::vector<OPNX::Order>& vecReject)
+        {
+            if (vecQuote.empty())
+            {
+                return;
+            }
+            OPNX::Order massQuote(vecQuote[0]);
+            size_t count = 0;
+            for (size_t i = 0; i < vecQuote.size(); i++)
+            {
+                OPNX::Order& quote = vecQuote[i];
+                if (0 == quote.quantity && 1 == vecQuote.size())
+                {
+                    break;
+                }
+                quote.action = OPNX::Order::NEW;
+                bool bOk = checkOrder(quote);
+                quote.action = OPNX::Order::MASS_QUOTE;
+                if (bOk && 0 == quote.orderId)
+                {
+                    // the engine diffs the quotes of the account by orderId
+                    quote.status = OPNX::Order::REJECT_QUOTE_ORDER_ID_ZERO;
+                    bOk = false;
+                }
+                if (bOk)
+                {
+                    vecQuote[count++] = quote;
+                }
+                else
+                {
+                    vecReject.push_back(quote);
+                }
+            }
+            if (0 == count)
+            {
+                massQuote.quantity = 0;
+                massQuote.remainQuantity = 0;
+                vecQuote[count++] = massQuote;
+            }
+            vecQuote.resize(count);
+            unsigned long long ullQueuedTime = OPNX::Utils::getNanoTimestamp();
+            for (size_t i = 0; i < vecQuote.size(); i++)
+            {
+                vecQuote[i].quoteCount = vecQuote.size() - i;
+                vecQuote[i].queuedTime = ullQueuedTime;
+            }
+            if (m_pOrderQueue)
+            {
+                m_pOrderQueue->push_batch(vecQuote);
+            }
+        }
+
+    private:
+        OPNX::OrderQueue<OPNX::Order> * m_pOrderQueue;
+        OPNX::OrderQueue<OPNX::Order> * m_pTriggerOrderQueue;
+    };
+}
+
+#endif //MATCHING_ENGINE_ORDER_ROUTER_H
@@ -0,0 +1,417 @@
+#ifndef MATCHING_ENGINE_SHM_RING_H
+#define MATCHING_ENGINE_SHM_RING_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <new>
+#include <string>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+
+namespace OPNX {
+    static const char SHM_RING_MAGIC[8] = {'O', 'P', 'N', 'X', 'R', 'I', 'N', 'G'};
+    static const unsigned int SHM_RING_VERSION = 1;
+    static const unsigned int SHM_SLOT_DATA_SIZE = 232;     // a ShmBroadcastSlot is 256 bytes
+
+    // Head of a ring in a POSIX shared memory object, the slots follow at offset sizeof(ShmRingHeader).
+    // The engine creates the rings. When it creates them again or exits, it sets closed in the old ones and unlinks them,
+    // an attached process that sees closed has to attach again.
+    struct ShmRingHeader {
+        char magic[8];
+        unsigned int version;
+        unsigned int slotSize;
+        unsigned long long slotCount;
+        std::atomic<unsigned int> closed;
+        alignas(64) std::atomic<unsigned long long> writeSequence;    // next slot to claim
+        alignas(64) std::atomic<unsigned long long> readSequence;     // next slot to consume, ShmQueue only
+    };
+    static_assert(std::atomic<unsigned long long>::is_always_lock_free, "shared memory rings need lock free atomics");
+
+    template <typename T>
+    struct alignas(64) ShmQueueSlot {
+        std::atomic<unsigned long long> sequence;
+        T value;
+    };
+
+    // One part of a broadcast message, a message longer than SHM_SLOT_DATA_SIZE takes consecutive slots.
+    // sequence is 2 * position + 1 while the slot is written and 2 * position + 2 when it is complete.
+    struct alignas(64) ShmBroadcastSlot {
+        std::atomic<unsigned long long> sequence;
+        unsigned int length;      // length of the whole message
+        unsigned int count;       // slots of the whole message
+        unsigned int index;       // of this slot in the message
+        char data[SHM_SLOT_DATA_SIZE];
+    };
+
+    // Maps a shared memory object of a ShmRingHeader and slotCount slots of slotSize bytes
+    class ShmRegion {
+    public:
+        ShmRegion()
+        : m_strName("")
+        , m_pMap(nullptr)
+        , m_ullMapSize(0)
+        , m_pHeader(nullptr)
+        , m_ullMask(0){};
+        ShmRegion(const ShmRegion &) = delete;
+        ShmRegion &operator=(const ShmRegion &) = delete;
+        ~ShmRegion() { close(); }
+
+        bool isOpen() const { return nullptr != m_pMap; }
+        const std::string& getName() const { return m_strName; }
+        unsigned long long getSlotCount() const { return nullptr == m_pHeader ? 0 : m_ullMask + 1; }
+        bool isClosed() const { return nullptr == m_pHeader || 0 != m_pHeader->closed.load(std::memory_order_acquire); }
+
+        // The creator marks the ring closed and removes its name, the memory is freed when the last process unmaps it
+        void destroy()
+        {
+            if (nullptr != m_pHeader)
+            {
+                m_pHeader->closed.store(1, std::memory_order_release);
+                shm_unlink(m_strName.c_str());
+            }
+            close();
+        }
+
+        void close()
+        {
+            if (nullptr != m_pMap)
+            {
+                munmap(m_pMap, m_ullMapSize);
+            }
+            m_pMap = nullptr;
+            m_ullMapSize = 0;
+            m_pHeader = nullptr;
+            m_ullMask = 0;
+        }
+
+    protected:
+        // A ring left by a previous run is closed and replaced by a new object, the processes attached to it never see
+        // its memory shrink. The slot count is rounded up to a power of 2.
+        bool create(const std::string& strName, unsigned int uiSlotSize, unsigned long long ullSlotCount)
+        {
+            close();
+            if (attach(strName, uiSlotSize))
+            {
+                destroy();
+            }
+            shm_unlink(strName.c_str());
+            m_strName = strName;
+            unsigned long long ullCount = 2;
+            while (ullCount < ullSlotCount)
+            {
+                ullCount <<= 1;
+            }
+            int fd = shm_open(strName.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+            if (0 > fd)
+            {
+                return false;
+            }
+            size_t size = sizeof(ShmRingHeader) + uiSlotSize * ullCount;
+            if (0 != ftruncate(fd, size))
+            {
+                ::close(fd);
+                return false;
+            }
+            void* pMap = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            ::close(fd);
+            if (MAP_FAILED == pMap)
+            {
+                return false;
+            }
+            m_pMap = pMap;
+            m_ullMapSize = size;
+            m_pHeader = new (pMap) ShmRingHeader();
+            m_pHeader->version = SHM_RING_VERSION;
+            m_pHeader->slotSize = uiSlotSize;
+            m_pHeader->slotCount = ullCount;
+            m_pHeader->closed.store(0, std::memory_order_relaxed);
+            m_pHeader->writeSequence.store(0, std::memory_order_relaxed);
+            m_pHeader->readSequence.store(0, std::memory_order_relaxed);
+            m_ullMask = ullCount - 1;
+            return true;
+        }
+
+        // The magic is written last by the creator, a ring that is not completely initialized is not attached
+        bool attach(const std::string& strName, unsigned int uiSlotSize)
+        {
+            close();
+            m_strName = strName;
+            int fd = shm_open(strName.c_str(), O_RDWR, 0600);
+            if (0 > fd)
+            {
+                return false;
+            }
+            struct stat fileStat;
+            if (0 != fstat(fd, &fileStat) || sizeof(ShmRingHeader) > (size_t)fileStat.st_size)
+            {
+                ::close(fd);
+                return false;
+            }
+            size_t size = fileStat.st_size;
+            void* pMap = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            ::close(fd);
+            if (MAP_FAILED == pMap)
+            {
+                return false;
+            }
+            ShmRingHeader* pHeader = (ShmRingHeader*)pMap;
+            if (0 != memcmp(pHeader->magic, SHM_RING_MAGIC, sizeof(pHeader->magic)) || SHM_RING_VERSION != pHeader->version
+                || uiSlotSize != pHeader->slotSize || size < sizeof(ShmRingHeader) + uiSlotSize * pHeader->slotCount)
+            {
+                munmap(pMap, size);
+                return false;
+            }
+            m_pMap = pMap;
+            m_ullMapSize = size;
+            m_pHeader = pHeader;
+            m_ullMask = pHeader->slotCount - 1;
+            return true;
+        }
+
+        void publish()
+        {
+            std::atomic_thread_fence(std::memory_order_release);
+            memcpy(m_pHeader->magic, SHM_RING_MAGIC, sizeof(m_pHeader->magic));
+        }
+
+        char* slots() { return (char*)m_pMap + sizeof(ShmRingHeader); }
+
+    protected:
+        std::string m_strName;
+        void* m_pMap;
+        unsigned long long m_ullMapSize;
+        ShmRingHeader* m_pHeader;
+        unsigned long long m_ullMask;
+    };
+
+    // Bounded lock-free queue of trivially copyable values: any number of processes may push, one thread pops.
+    // push fails when the queue is full, nothing is overwritten.
+    template <typename T>
+    class ShmQueue: public ShmRegion {
+    public:
+        typedef ShmQueueSlot<T> Slot;
+
+        bool create(const std::string& strName, unsigned long long ullSlotCount)
+        {
+            if (!ShmRegion::create(strName, sizeof(Slot), ullSlotCount))
+            {
+                return false;
+            }
+            for (unsigned long long i = 0; i <= m_ullMask; i++)
+            {
+                new (slot(i)) Slot();
+                slot(i)->sequence.store(i, std::memory_order_relaxed);
+            }
+            publish();
+            return true;
+        }
+        bool attach(const std::string& strName)
+        {
+            return ShmRegion::attach(strName, sizeof(Slot));
+        }
+
+        // All values take consecutive slots, so the consumer sees them together, like a mass quote
+        bool push(const T* pValue, unsigned long long ullCount)
+        {
+            if (nullptr == m_pHeader || 0 == ullCount || ullCount > m_ullMask + 1)
+            {
+                return false;
+            }
+            unsigned long long ullPosition = m_pHeader->writeSequence.load(std::memory_order_relaxed);
+            while (true)
+            {
+                // the last slot is free when a consumer has released it for this round
+                Slot* pLast = slot(ullPosition + ullCount - 1);
+                long long llDiff = (long long)(pLast->sequence.load(std::memory_order_acquire) - (ullPosition + ullCount - 1));
+                if (0 == llDiff)
+                {
+                    if (m_pHeader->writeSequence.compare_exchange_weak(ullPosition, ullPosition + ullCount, std::memory_order_relaxed))
+                    {
+                        break;
+                    }
+                }
+                else if (0 > llDiff)
+                {
+                    return false;
+                }
+                else
+                {
+                    ullPosition = m_pHeader->writeSequence.load(std::memory_order_relaxed);
+                }
+            }
+            for (unsigned long long i = 0; i < ullCount; i++)
+            {
+                Slot* pSlot = slot(ullPosition + i);
+                memcpy((void*)&pSlot->value, pValue + i, sizeof(T));
+                pSlot->sequence.store(ullPosition + i + 1, std::memory_order_release);
+            }
+            return true;
+        }
+        bool push(const T& value)
+        {
+            return push(&value, 1);
+        }
+
+        bool pop(T& value)
+        {
+            if (nullptr == m_pHeader)
+            {
+                return false;
+            }
+            unsigned long long ullPosition = m_pHeader->readSequence.load(std::memory_order_relaxed);
+            Slot* pSlot = slot(ullPosition);
+            if (pSlot->sequence.load(std::memory_order_acquire) != ullPosition + 1)
+            {
+                return false;
+            }
+            memcpy((void*)&value, &pSlot->value, sizeof(T));
+            pSlot->sequence.store(ullPosition + m_ullMask + 1, std::memory_order_release);
+            m_pHeader->readSequence.store(ullPosition + 1, std::memory_order_relaxed);
+            return true;
+        }
+
+    private:
+        Slot* slot(unsigned long long ullPosition) { return (Slot*)slots() + (ullPosition & m_ullMask); }
+    };
+
+    // Lock-free ring of messages for any number of readers: writers never wait for the readers, the oldest messages are overwritten.
+    // Every reader keeps its own position, a reader that falls a whole ring behind loses messages and is told so.
+    class ShmBroadcast: public ShmRegion {
+    public:
+        enum ReadResult
+        {
+            READ_OK,
+            READ_EMPTY,
+            READ_LOST
+        };
+
+        bool create(const std::string& strName, unsigned long long ullSlotCount)
+        {
+            if (!ShmRegion::create(strName, sizeof(ShmBroadcastSlot), ullSlotCount))
+            {
+                return false;
+            }
+            for (unsigned long long i = 0; i <= m_ullMask; i++)
+            {
+                new (slot(i)) ShmBroadcastSlot();
+                slot(i)->sequence.store(0, std::memory_order_relaxed);
+            }
+            publish();
+            return true;
+        }
+        bool attach(const std::string& strName)
+        {
+            return ShmRegion::attach(strName, sizeof(ShmBroadcastSlot));
+        }
+
+        // The position a new reader starts with, it only gets the messages written after attach
+        unsigned long long getWritePosition() const
+        {
+            return nullptr != m_pHeader ? m_pHeader->writeSequence.load(std::memory_order_acquire) : 0;
+        }
+
+        bool write(const char* pData, unsigned int uiLength)
+        {
+            if (nullptr == m_pHeader)
+            {
+                return false;
+            }
+            unsigned int uiCount = 0 == uiLength ? 1 : (uiLength + SHM_SLOT_DATA_SIZE - 1) / SHM_SLOT_DATA_SIZE;
+            if (uiCount > (m_ullMask + 1) / 2)
+            {
+                return false;
+            }
+            unsigned long long ullPosition = m_pHeader->writeSequence.fetch_add(uiCount, std::memory_order_acq_rel);
+            for (unsigned int i = 0; i < uiCount; i++)
+            {
+                ShmBroadcastSlot* pSlot = slot(ullPosition + i);
+                unsigned int uiOffset = i * SHM_SLOT_DATA_SIZE;
+                unsigned int uiSize = std::min(SHM_SLOT_DATA_SIZE, uiLength - uiOffset);
+                pSlot->sequence.store((ullPosition + i) * 2 + 1, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_release);
+                pSlot->length = uiLength;
+                pSlot->count = uiCount;
+                pSlot->index = i;
+                memcpy(pSlot->data, pData + uiOffset, uiSize);
+                pSlot->sequence.store((ullPosition + i) * 2 + 2, std::memory_order_release);
+            }
+            return true;
+        }
+        bool write(const std::string& strData)
+        {
+            return write(strData.data(), strData.size());
+        }
+
+        // Reads the message at ullPosition and moves ullPosition to the next one.
+        // READ_LOST: the message was overwritten, ullPosition is moved to the older half of the messages still in the ring.
+        ReadResult read(unsigned long long& ullPosition, std::string& strData)
+        {
+            if (nullptr == m_pHeader)
+            {
+                return READ_EMPTY;
+            }
+            ShmBroadcastSlot* pSlot = slot(ullPosition);
+            unsigned long long ullSequence = pSlot->sequence.load(std::memory_order_acquire);
+            if (ullSequence < ullPosition * 2 + 2)
+            {
+                // not written yet, or written right now
+                return READ_EMPTY;
+            }
+            if (ullSequence > ullPosition * 2 + 2)
+            {
+                return lost(ullPosition);
+            }
+            unsigned int uiLength = pSlot->length;
+            unsigned int uiCount = pSlot->count;
+            unsigned int uiIndex = pSlot->index;
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (pSlot->sequence.load(std::memory_order_relaxed) != ullSequence)
+            {
+                return lost(ullPosition);
+            }
+            if (0 != uiIndex)
+            {
+                // a lost reader starts in the middle of a message, go on with the next one
+                ullPosition += uiCount - uiIndex;
+                return read(ullPosition, strData);
+            }
+            strData.resize(uiLength);
+            for (unsigned int i = 0; i < uiCount; i++)
+            {
+                pSlot = slot(ullPosition + i);
+                unsigned long long ullExpected = (ullPosition + i) * 2 + 2;
+                ullSequence = pSlot->sequence.load(std::memory_order_acquire);
+                if (ullSequence < ullExpected)
+                {
+                    // the writer is still busy with a later part of the message, read it again from the beginning
+                    return READ_EMPTY;
+                }
+                unsigned int uiOffset = i * SHM_SLOT_DATA_SIZE;
+                memcpy(&strData[uiOffset], pSlot->data, std::min(SHM_SLOT_DATA_SIZE, uiLength - uiOffset));
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (ullExpected != ullSequence || pSlot->sequence.load(std::memory_order_relaxed) != ullSequence)
+                {
+                    return lost(ullPosition);
+                }
+            }
+            ullPosition += uiCount;
+            return READ_OK;
+        }
+
+    private:
+        ShmBroadcastSlot* slot(unsigned long long ullPosition) { return (ShmBroadcastSlot*)slots() + (ullPosition & m_ullMask); }
+
+        ReadResult lost(unsigned long long& ullPosition)
+        {
+            unsigned long long ullWrite = m_pHeader->writeSequence.load(std::memory_order_acquire);
+            ullPosition = ullWrite > m_ullMask + 1 ? ullWrite - (m_ullMask + 1) / 2 : 0;
+            return READ_LOST;
+        }
+    };
+}
+
+#endif //MATCHING_ENGINE_SHM_RING_H
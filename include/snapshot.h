@@ -0,0 +1,216 @@
+#ifndef MATCHING_ENGINE_SNAPSHOT_H
+#define MATCHING_ENGINE_SNAPSHOT_H
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "order.h"
+
+
+namespace OPNX {
+    static const char SNAPSHOT_MAGIC[8] = {'O', 'P', 'N', 'X', 'S', 'N', 'A', 'P'};
+    static const unsigned int SNAPSHOT_VERSION = 3;
+
+    // The state of one market: resting orders of the engine, auction orders of the call phase,
+    // quote orderIds of each account and the orders of the trigger order manager
+    class MarketSnapshot {
+    public:
+        unsigned long long marketId = 0;
+        std::vector<OPNX::Order> vecOrder;
+        std::vector<OPNX::Order> vecAuctionOrder;
+        std::vector<std::pair<unsigned long long, unsigned long long>> vecQuoteId;   // accountId, orderId
+        std::vector<OPNX::Order> vecTriggerOrder;           // the orders of the trigger ladders by sortId
+        std::vector<OPNX::Order> vecPendingTriggerOrder;    // the bracket orders waiting for the fill of their parent, in no ladder
+    };
+
+    // Binary layout of the file:
+    // SnapshotHeader, then marketCount times SnapshotMarket followed by its orders, auction orders, quote ids, trigger orders
+    // and pending trigger orders.
+    // Orders are stored as they are in memory, orderSize in the header rejects a file written with another Order layout.
+    struct SnapshotHeader {
+        char magic[8];
+        unsigned int version;
+        unsigned int orderSize;
+        unsigned long long sortId;
+        unsigned long long matchId;
+        unsigned long long sequenceNumber;
+        unsigned long long timestamp;
+        unsigned long long journalSequence;     // the last journal record in the snapshot
+        unsigned long long marketCount;
+    };
+    struct SnapshotMarket {
+        unsigned long long marketId;
+        unsigned long long orderCount;
+        unsigned long long auctionOrderCount;
+        unsigned long long quoteCount;
+        unsigned long long triggerOrderCount;
+        unsigned long long pendingTriggerOrderCount;
+    };
+
+    class Snapshot {
+    public:
+        // Write to a temporary file and rename it, a crash while writing keeps the previous snapshot
+        static bool write(const std::string& strFile, SnapshotHeader& header, const std::vector<MarketSnapshot>& vecMarket)
+        {
+            std::string strTmpFile = strFile + ".tmp";
+            FILE* pFile = fopen(strTmpFile.c_str(), "wb");
+            if (nullptr == pFile)
+            {
+                return false;
+            }
+            memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+            header.version = SNAPSHOT_VERSION;
+            header.orderSize = sizeof(OPNX::Order);
+            header.marketCount = vecMarket.size();
+            bool bOk = 1 == fwrite(&header, sizeof(header), 1, pFile);
+            for (auto& market: vecMarket)
+            {
+                SnapshotMarket snapshotMarket = {market.marketId, market.vecOrder.size(), market.vecAuctionOrder.size(),
+                                                 market.vecQuoteId.size(), market.vecTriggerOrder.size(), market.vecPendingTriggerOrder.size()};
+                bOk = bOk && 1 == fwrite(&snapshotMarket, sizeof(snapshotMarket), 1, pFile);
+                bOk = bOk && writeVector(market.vecOrder, pFile);
+                bOk = bOk && writeVector(market.vecAuctionOrder, pFile);
+                bOk = bOk && writeVector(market.vecQuoteId, pFile);
+                bOk = bOk && writeVector(market.vecTriggerOrder, pFile);
+                bOk = bOk && writeVector(market.vecPendingTriggerOrder, pFile);
+            }
+            bOk = bOk && 0 == fflush(pFile) && 0 == fsync(fileno(pFile));
+            bOk = 0 == fclose(pFile) && bOk;
+            if (!bOk || 0 != rename(strTmpFile.c_str(), strFile.c_str()))
+            {
+                unlink(strTmpFile.c_str());
+                return false;
+            }
+            return true;
+        }
+
+        // The file is mapped and its sections are copied into the vectors directly, nothing is parsed
+        static bool load(const std::string& strFile, SnapshotHeader& header, std::vector<MarketSnapshot>& vecMarket)
+        {
+            int fd = open(strFile.c_str(), O_RDONLY);
+            if (0 > fd)
+            {
+                return false;
+            }
+            struct stat fileStat;
+            if (0 != fstat(fd, &fileStat) || sizeof(SnapshotHeader) > (size_t)fileStat.st_size)
+            {
+                close(fd);
+                return false;
+            }
+            size_t size = fileStat.st_size;
+            void* pMap = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            close(fd);
+            if (MAP_FAILED == pMap)
+            {
+                return false;
+            }
+            madvise(pMap, size, MADV_SEQUENTIAL);
+
+            const char* pBegin = (const char*)pMap;
+            const char* pEnd = pBegin + size;
+            const char* p = pBegin;
+            memcpy(&header, p, sizeof(header));
+            p += sizeof(header);
+            bool bOk = 0 == memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic))
+                    && SNAPSHOT_VERSION == header.version && sizeof(OPNX::Order) == header.orderSize;
+            vecMarket.clear();
+            for (unsigned long long i = 0; bOk && i < header.marketCount; i++)
+            {
+                SnapshotMarket snapshotMarket;
+                bOk = readValue(snapshotMarket, p, pEnd);
+                if (!bOk)
+                {
+                    break;
+                }
+                MarketSnapshot market;
+                market.marketId = snapshotMarket.marketId;
+                bOk = readVector(market.vecOrder, snapshotMarket.orderCount, p, pEnd)
+                        && readVector(market.vecAuctionOrder, snapshotMarket.auctionOrderCount, p, pEnd)
+                        && readVector(market.vecQuoteId, snapshotMarket.quoteCount, p, pEnd)
+                        && readVector(market.vecTriggerOrder, snapshotMarket.triggerOrderCount, p, pEnd)
+                        && readVector(market.vecPendingTriggerOrder, snapshotMarket.pendingTriggerOrderCount, p, pEnd);
+                vecMarket.push_back(std::move(market));
+            }
+            munmap(pMap, size);
+            if (!bOk)
+            {
+                vecMarket.clear();
+            }
+            return bOk;
+        }
+
+        // FNV-1a of the resting and auction orders in book order and of the trigger orders, a standby has the same hash as the primary
+        // at the same journal sequence. Ids from the global counters and timestamps are left out, they are not the same in both processes
+        static unsigned long long hash(const std::vector<MarketSnapshot>& vecMarket)
+        {
+            unsigned long long ullHash = 14695981039346656037ULL;
+            auto hashValue = [&](unsigned long long ullValue) {
+                for (int i = 0; i < 8; i++)
+                {
+                    ullHash = (ullHash ^ ((ullValue >> (i * 8)) & 0xff)) * 1099511628211ULL;
+                }
+            };
+            auto hashOrders = [&](const std::vector<OPNX::Order>& vecOrder) {
+                hashValue(vecOrder.size());
+                for (auto& order: vecOrder)
+                {
+                    hashValue(order.orderId);
+                    hashValue(order.accountId);
+                    hashValue(order.price);
+                    hashValue(order.remainQuantity);
+                    hashValue(order.displayQuantity);
+                    hashValue(order.triggerPrice);
+                    hashValue(order.side);
+                }
+            };
+            for (auto& market: vecMarket)
+            {
+                hashValue(market.marketId);
+                hashOrders(market.vecOrder);
+                hashOrders(market.vecAuctionOrder);
+                hashOrders(market.vecTriggerOrder);
+                hashOrders(market.vecPendingTriggerOrder);
+            }
+            return ullHash;
+        }
+
+    private:
+        template <typename T>
+        static inline bool writeVector(const std::vector<T>& vecValue, FILE* pFile)
+        {
+            return vecValue.empty() || vecValue.size() == fwrite(vecValue.data(), sizeof(T), vecValue.size(), pFile);
+        }
+        template <typename T>
+        static inline bool readValue(T& value, const char*& p, const char* pEnd)
+        {
+            if ((size_t)(pEnd - p) < sizeof(T))
+            {
+                return false;
+            }
+            memcpy(&value, p, sizeof(T));
+            p += sizeof(T);
+            return true;
+        }
+        template <typename T>
+        static inline bool readVector(std::vector<T>& vecValue, unsigned long long ullCount, const char*& p, const char* pEnd)
+        {
+            if ((size_t)(pEnd - p) / sizeof(T) < ullCount)
+            {
+                return false;
+            }
+            vecValue.resize(ullCount);
+            memcpy((void*)vecValue.data(), p, ullCount * sizeof(T));
+            p += ullCount * sizeof(T);
+            return true;
+        }
+    };
+}
+
+#endif //MATCHING_ENGINE_SNAPSHOT_H
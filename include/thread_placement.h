@@ -0,0 +1,247 @@
+#ifndef MATCHING_ENGINE_THREAD_PLACEMENT_H
+#define MATCHING_ENGINE_THREAD_PLACEMENT_H
+
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#endif
+
+#include "json.hpp"
+#include "log.h"
+#include "wait_strategy.h"
+
+
+namespace OPNX {
+    // Cpus, SCHED_FIFO priority, numa node and wait strategy of the threads of the manager by their name: the ThreadType names of
+    // Manager::handleThread, MAIN for the thread of Manager::run and ORDER_CONSUMER for the threads of the proxies that
+    // read the orders. A thread inherits the placement of the thread that created it, so the threads without a placement
+    // run where MAIN runs.
+    //
+    // "threadPlacement": {
+    //     "isolatedCpus": [2, 3, 4, 5],
+    //     "numaNode": 0,
+    //     "ORDER_OUT": {"cpus": [4, 5], "priority": 0, "numaNode": 0, "wait": "spinPark", "spinCount": 1000, "parkMicros": 10}
+    // }
+    // isolatedCpus are the cpus kept for the order path (isolcpus/nohz_full cpus), by default ORDER_IN gets the first one
+    // alone with SCHED_FIFO 80, TRIGGER_ORDER_IN the second with SCHED_FIFO 70, ORDER_CONSUMER the third, ORDER_OUT and
+    // ORDERS_OUT share the rest. MAIN and all the other threads run on the cpus of the process that are not isolated,
+    // so the matching thread never shares a cpu with the publishers. An entry of a name replaces the defaults of its
+    // keys, a priority of 0 is SCHED_OTHER. numaNode is the preferred node of the memory allocated by the thread,
+    // the top level one is the default of all the threads, the engines are created by MAIN.
+    // wait is the WaitStrategy of the thread when its queue is empty: busySpin, spinYield, spinPark or blocking. The threads
+    // on isolated cpus busy spin by default, ORDER_CONSUMER (one thread per market on the same cpu), ORDER_OUT and ORDERS_OUT
+    // spin then park, the others block as before.
+    class ThreadPlacement {
+    public:
+        struct Placement {
+            std::vector<int> vecCpu;    // empty: inherited
+            int iPriority;              // SCHED_FIFO priority, 0: SCHED_OTHER, -1: inherited
+            int iNumaNode;              // -1: inherited
+            std::string strWait;        // empty: the default of the thread
+            int iSpinCount;             // -1: the default of the thread
+            int iParkMicros;            // -1: the default of the thread
+
+            Placement() : iPriority(-1), iNumaNode(-1), strWait(""), iSpinCount(-1), iParkMicros(-1){};
+        };
+
+        static ThreadPlacement& instance()
+        {
+            static ThreadPlacement threadPlacement;
+            return threadPlacement;
+        }
+        ThreadPlacement(const ThreadPlacement &) = delete;
+        ThreadPlacement &operator=(const ThreadPlacement &) = delete;
+
+        void load(const nlohmann::json& jsonPlacement)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_mapPlacement.clear();
+            try {
+                std::vector<int> vecIsolated;
+                if (jsonPlacement.contains("isolatedCpus"))
+                {
+                    vecIsolated = jsonPlacement["isolatedCpus"].get<std::vector<int>>();
+                }
+                int iNumaNode = -1;
+                if (jsonPlacement.contains("numaNode"))
+                {
+                    iNumaNode = jsonPlacement["numaNode"].get<int>();
+                }
+                if (!vecIsolated.empty())
+                {
+                    std::vector<int> vecShared = getSharedCpus(vecIsolated);
+                    m_mapPlacement["MAIN"].vecCpu = vecShared;
+                    m_mapPlacement["ORDER_IN"].vecCpu = {vecIsolated[0]};
+                    m_mapPlacement["ORDER_IN"].iPriority = 80;
+                    m_mapPlacement["ORDER_IN"].strWait = "busySpin";
+                    if (1 < vecIsolated.size())
+                    {
+                        m_mapPlacement["TRIGGER_ORDER_IN"].vecCpu = {vecIsolated[1]};
+                        m_mapPlacement["TRIGGER_ORDER_IN"].iPriority = 70;
+                        m_mapPlacement["TRIGGER_ORDER_IN"].strWait = "busySpin";
+                    }
+                    if (2 < vecIsolated.size())
+                    {
+                        // the consumers of all the markets share the cpu, a busy spinning one would starve the others
+                        m_mapPlacement["ORDER_CONSUMER"].vecCpu = {vecIsolated[2]};
+                        m_mapPlacement["ORDER_CONSUMER"].strWait = "spinPark";
+                    }
+                    if (3 < vecIsolated.size())
+                    {
+                        std::vector<int> vecOut(vecIsolated.begin() + 3, vecIsolated.end());
+                        m_mapPlacement["ORDER_OUT"].vecCpu = vecOut;
+                        m_mapPlacement["ORDERS_OUT"].vecCpu = vecOut;
+                        m_mapPlacement["ORDER_OUT"].strWait = "spinPark";
+                        m_mapPlacement["ORDERS_OUT"].strWait = "spinPark";
+                    }
+                }
+                if (-1 != iNumaNode)
+                {
+                    m_mapPlacement["MAIN"].iNumaNode = iNumaNode;
+                }
+                for (auto it = jsonPlacement.begin(); jsonPlacement.end() != it; it++)
+                {
+                    if (!it.value().is_object())
+                    {
+                        continue;
+                    }
+                    Placement& placement = m_mapPlacement[it.key()];
+                    if (it.value().contains("cpus"))
+                    {
+                        placement.vecCpu = it.value()["cpus"].get<std::vector<int>>();
+                    }
+                    if (it.value().contains("priority"))
+                    {
+                        placement.iPriority = it.value()["priority"].get<int>();
+                    }
+                    if (it.value().contains("numaNode"))
+                    {
+                        placement.iNumaNode = it.value()["numaNode"].get<int>();
+                    }
+                    if (it.value().contains("wait"))
+                    {
+                        placement.strWait = it.value()["wait"].get<std::string>();
+                    }
+                    if (it.value().contains("spinCount"))
+                    {
+                        placement.iSpinCount = it.value()["spinCount"].get<int>();
+                    }
+                    if (it.value().contains("parkMicros"))
+                    {
+                        placement.iParkMicros = it.value()["parkMicros"].get<int>();
+                    }
+                }
+            } catch (const std::exception &e) {
+                cfLog.error() << "ThreadPlacement::load exception: " << e.what() << std::endl;
+            }
+        }
+
+        // Places the calling thread, nothing for a name without a placement
+        void apply(const std::string& strName)
+        {
+            Placement placement;
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                auto it = m_mapPlacement.find(strName);
+                if (m_mapPlacement.end() == it)
+                {
+                    return;
+                }
+                placement = it->second;
+            }
+#ifdef __linux__
+            if (!placement.vecCpu.empty())
+            {
+                cpu_set_t cpuSet;
+                CPU_ZERO(&cpuSet);
+                for (int iCpu: placement.vecCpu)
+                {
+                    CPU_SET(iCpu, &cpuSet);
+                }
+                if (0 != pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuSet))
+                {
+                    cfLog.warn() << "ThreadPlacement " << strName << " set the cpus failed" << std::endl;
+                }
+            }
+            if (-1 != placement.iPriority)
+            {
+                sched_param param;
+                param.sched_priority = placement.iPriority;
+                if (0 != pthread_setschedparam(pthread_self(), 0 < placement.iPriority ? SCHED_FIFO : SCHED_OTHER, &param))
+                {
+                    cfLog.warn() << "ThreadPlacement " << strName << " set SCHED_FIFO " << placement.iPriority << " failed, it needs CAP_SYS_NICE" << std::endl;
+                }
+            }
+            if (-1 != placement.iNumaNode)
+            {
+                // MPOL_PREFERRED of <linux/mempolicy.h>, without a dependency on libnuma
+                static const int MEMORY_POLICY_PREFERRED = 1;
+                unsigned long ulNodeMask = 1UL << placement.iNumaNode;
+                if (0 != syscall(SYS_set_mempolicy, MEMORY_POLICY_PREFERRED, &ulNodeMask, sizeof(ulNodeMask) * 8))
+                {
+                    cfLog.warn() << "ThreadPlacement " << strName << " set the numa node " << placement.iNumaNode << " failed" << std::endl;
+                }
+            }
+#endif
+            cfLog.info() << "ThreadPlacement " << strName << " cpus: " << nlohmann::json(placement.vecCpu).dump()
+                         << " priority: " << placement.iPriority << " numaNode: " << placement.iNumaNode << " wait: " << placement.strWait << std::endl;
+        }
+
+        // The wait strategy of the thread of strName, waitStrategy for the keys that are not in its placement
+        WaitStrategy getWaitStrategy(const std::string& strName, const WaitStrategy& waitStrategy = WaitStrategy())
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto it = m_mapPlacement.find(strName);
+            if (m_mapPlacement.end() == it)
+            {
+                return waitStrategy;
+            }
+            WaitStrategy::Type type = waitStrategy.getType();
+            if (!it->second.strWait.empty() && !WaitStrategy::parse(it->second.strWait, type))
+            {
+                cfLog.warn() << "ThreadPlacement " << strName << " unknown wait: " << it->second.strWait << std::endl;
+            }
+            return WaitStrategy(type,
+                                -1 == it->second.iSpinCount ? waitStrategy.getSpinCount() : it->second.iSpinCount,
+                                -1 == it->second.iParkMicros ? waitStrategy.getParkMicros() : it->second.iParkMicros);
+        }
+
+    private:
+        ThreadPlacement() = default;
+
+        // The cpus of the process that are not isolated
+        static std::vector<int> getSharedCpus(const std::vector<int>& vecIsolated)
+        {
+            std::vector<int> vecShared;
+#ifdef __linux__
+            std::set<int> setIsolated(vecIsolated.begin(), vecIsolated.end());
+            cpu_set_t cpuSet;
+            CPU_ZERO(&cpuSet);
+            if (0 == sched_getaffinity(0, sizeof(cpu_set_t), &cpuSet))
+            {
+                for (int iCpu = 0; iCpu < CPU_SETSIZE; iCpu++)
+                {
+                    if (CPU_ISSET(iCpu, &cpuSet) && 0 == setIsolated.count(iCpu))
+                    {
+                        vecShared.push_back(iCpu);
+                    }
+                }
+            }
+#endif
+            return vecShared;
+        }
+
+    private:
+        std::mutex m_mutex;
+        std::map<std::string, Placement> m_mapPlacement;
+    };
+}
+
+#endif //MATCHING_ENGINE_THREAD_PLACEMENT_H
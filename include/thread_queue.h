@@ -3,10 +3,13 @@
 #define THREAD_QUEUE_H
 
 #include <queue>
+#include <vector>
 #include <mutex>
 #include <condition_variable>
 #include <unistd.h>
 
+#include "wait_strategy.h"
+
 namespace OPNX {
     /*
     * threadsafe queue
@@ -22,6 +25,7 @@ namespace OPNX {
         mutable std::condition_variable m_condition;
         using queue_type = std::queue<T>;
         queue_type m_queueData;
+        bool m_bWake = false;
 
     public:
         using value_type = typename queue_type::value_type;
@@ -50,6 +54,19 @@ namespace OPNX {
             m_condition.notify_all();
         }
 
+        /*
+        * Push elements under one lock, so they stay adjacent in the queue
+        * */
+        void push_batch(const std::vector<value_type> &new_values)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            for (auto &new_value : new_values)
+            {
+                m_queueData.push(new_value);
+            }
+            m_condition.notify_all();
+        }
+
         /*
         * Pop an element from the queue and block if the queue is empty
         * */
@@ -65,8 +82,10 @@ namespace OPNX {
         bool wait_and_pop(value_type &value, int iTimeout=1)
         {
             std::unique_lock<std::mutex> lock(m_mutex);
-            if (!m_condition.wait_for(lock, std::chrono::seconds(iTimeout), [this]{ return !this->m_queueData.empty(); }))
+            m_condition.wait_for(lock, std::chrono::seconds(iTimeout), [this]{ return !this->m_queueData.empty() || this->m_bWake; });
+            if (m_queueData.empty())
             {
+                m_bWake = false;
                 return false;
             }
 
@@ -75,6 +94,34 @@ namespace OPNX {
             return true;
         }
         /*
+        * Pop an element with the wait strategy of the calling thread: BLOCKING waits on the condition variable,
+        * the others poll once and call idle if the queue is empty
+        * */
+        bool wait_and_pop(value_type &value, WaitStrategy &waitStrategy)
+        {
+            if (WaitStrategy::BLOCKING == waitStrategy.getType())
+            {
+                return wait_and_pop(value);
+            }
+            if (try_pop(value))
+            {
+                waitStrategy.reset();
+                return true;
+            }
+            waitStrategy.idle();
+            return false;
+        }
+        /*
+        * The wait_and_pop with a timeout that is waiting, or the next one, returns at once, false if the queue is empty,
+        * so the consumer can look at another queue
+        * */
+        void wake()
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_bWake = true;
+            m_condition.notify_all();
+        }
+        /*
         * Pop an element from the queue, and return false if the queue is empty
         * */
         bool try_pop(value_type &value)
@@ -0,0 +1,191 @@
+#ifndef MATCHING_ENGINE_TIMING_WHEEL_H
+#define MATCHING_ENGINE_TIMING_WHEEL_H
+
+#include <algorithm>
+#include <vector>
+
+
+namespace OPNX {
+    // Hierarchical timing wheel of milli second ticks, for the timers of the thread that owns it. An entry is in the
+    // lowest level whose bits above its slot are the same as the current tick, the level 0 slots are single ticks and
+    // the slots of a level are the whole level below. When the current tick crosses the end of a slot of a level, the
+    // entries of the next slot move to the lower levels, the entries of more than 2^32 ticks wait in the overflow.
+    // add is O(1), an entry moves down at most TIMING_WHEEL_LEVEL_COUNT times and advance jumps over the empty levels,
+    // so the expiry is O(1) amortized. An entry is never removed, the owner ignores the timers that are already gone.
+    static const unsigned int TIMING_WHEEL_SLOT_BITS = 8;
+    static const unsigned int TIMING_WHEEL_SLOT_COUNT = 1 << TIMING_WHEEL_SLOT_BITS;
+    static const unsigned int TIMING_WHEEL_LEVEL_COUNT = 4;
+
+    template <typename T>
+    class TimingWheel {
+    public:
+        TimingWheel() : m_ullCurrent(0), m_ullSize(0)
+        {
+            std::fill(std::begin(m_arrLevelSize), std::end(m_arrLevelSize), 0);
+        }
+        TimingWheel(const TimingWheel &) = delete;
+        TimingWheel &operator=(const TimingWheel &) = delete;
+
+        // A time before the current tick expires at the next advance
+        void add(unsigned long long ullTime, const T& value)
+        {
+            place(Entry{std::max(ullTime, m_ullCurrent), value});
+            m_ullSize++;
+        }
+
+        // Calls onExpire with the value of each entry of a time <= ullNow, in the order of their ticks.
+        // onExpire must not add to the wheel.
+        template <typename F>
+        void advance(unsigned long long ullNow, F onExpire)
+        {
+            while (m_ullCurrent <= ullNow)
+            {
+                if (0 == m_ullSize)
+                {
+                    m_ullCurrent = ullNow + 1;
+                    break;
+                }
+                if (0 != m_arrLevelSize[0])
+                {
+                    std::vector<Entry>& vecSlot = m_arrSlot[0][m_ullCurrent & (TIMING_WHEEL_SLOT_COUNT - 1)];
+                    if (!vecSlot.empty())
+                    {
+                        m_vecEntry.clear();
+                        m_vecEntry.swap(vecSlot);
+                        m_arrLevelSize[0] -= m_vecEntry.size();
+                        m_ullSize -= m_vecEntry.size();
+                        for (auto& entry: m_vecEntry)
+                        {
+                            onExpire(entry.value);
+                        }
+                    }
+                    m_ullCurrent++;
+                }
+                else
+                {
+                    // the levels below the lowest non empty one have nothing to expire before its next slot
+                    unsigned int uiLevel = 1;
+                    while (uiLevel < TIMING_WHEEL_LEVEL_COUNT && 0 == m_arrLevelSize[uiLevel])
+                    {
+                        uiLevel++;
+                    }
+                    unsigned int uiShift = uiLevel * TIMING_WHEEL_SLOT_BITS;
+                    unsigned long long ullNext = ((m_ullCurrent >> uiShift) + 1) << uiShift;
+                    if (TIMING_WHEEL_LEVEL_COUNT == uiLevel)
+                    {
+                        ullNext = std::max(ullNext, (getOverflowMin() >> uiShift) << uiShift);
+                    }
+                    if (ullNext > ullNow + 1)
+                    {
+                        m_ullCurrent = ullNow + 1;
+                        break;
+                    }
+                    m_ullCurrent = ullNext;
+                }
+                if (0 == (m_ullCurrent & (TIMING_WHEEL_SLOT_COUNT - 1)))
+                {
+                    cascade();
+                }
+            }
+        }
+
+        void clear()
+        {
+            for (auto& arrSlot: m_arrSlot)
+            {
+                for (auto& vecSlot: arrSlot)
+                {
+                    vecSlot.clear();
+                }
+            }
+            m_vecOverflow.clear();
+            std::fill(std::begin(m_arrLevelSize), std::end(m_arrLevelSize), 0);
+            m_ullSize = 0;
+        }
+
+        unsigned long long size() const { return m_ullSize; }
+        bool empty() const { return 0 == m_ullSize; }
+
+    private:
+        struct Entry {
+            unsigned long long ullTime;
+            T value;
+        };
+
+        void place(const Entry& entry)
+        {
+            for (unsigned int uiLevel = 0; uiLevel < TIMING_WHEEL_LEVEL_COUNT; uiLevel++)
+            {
+                unsigned int uiShift = (uiLevel + 1) * TIMING_WHEEL_SLOT_BITS;
+                if ((entry.ullTime >> uiShift) == (m_ullCurrent >> uiShift))
+                {
+                    m_arrSlot[uiLevel][(entry.ullTime >> (uiLevel * TIMING_WHEEL_SLOT_BITS)) & (TIMING_WHEEL_SLOT_COUNT - 1)].push_back(entry);
+                    m_arrLevelSize[uiLevel]++;
+                    return;
+                }
+            }
+            m_vecOverflow.push_back(entry);
+        }
+
+        // m_ullCurrent is the first tick of a level 0 round: moves the entries of the slots that start at m_ullCurrent
+        // down, from the highest level whose slot changed
+        void cascade()
+        {
+            unsigned int uiLevel = 1;
+            while (uiLevel <= TIMING_WHEEL_LEVEL_COUNT && 0 == (m_ullCurrent & ((1ULL << (uiLevel * TIMING_WHEEL_SLOT_BITS)) - 1)))
+            {
+                uiLevel++;
+            }
+            uiLevel--;
+            if (TIMING_WHEEL_LEVEL_COUNT == uiLevel)
+            {
+                m_vecEntry.clear();
+                m_vecEntry.swap(m_vecOverflow);
+                for (auto& entry: m_vecEntry)
+                {
+                    place(entry);
+                }
+                uiLevel--;
+            }
+            for (; 0 < uiLevel; uiLevel--)
+            {
+                std::vector<Entry>& vecSlot = m_arrSlot[uiLevel][(m_ullCurrent >> (uiLevel * TIMING_WHEEL_SLOT_BITS)) & (TIMING_WHEEL_SLOT_COUNT - 1)];
+                if (vecSlot.empty())
+                {
+                    continue;
+                }
+                m_vecEntry.clear();
+                m_vecEntry.swap(vecSlot);
+                m_arrLevelSize[uiLevel] -= m_vecEntry.size();
+                for (auto& entry: m_vecEntry)
+                {
+                    place(entry);
+                }
+            }
+        }
+
+        unsigned long long getOverflowMin() const
+        {
+            unsigned long long ullMin = m_ullCurrent;
+            if (!m_vecOverflow.empty())
+            {
+                ullMin = m_vecOverflow[0].ullTime;
+                for (auto& entry: m_vecOverflow)
+                {
+                    ullMin = std::min(ullMin, entry.ullTime);
+                }
+            }
+            return ullMin;
+        }
+
+    private:
+        unsigned long long m_ullCurrent;                // the next tick to expire
+        unsigned long long m_ullSize;
+        unsigned long long m_arrLevelSize[TIMING_WHEEL_LEVEL_COUNT];
+        std::vector<Entry> m_arrSlot[TIMING_WHEEL_LEVEL_COUNT][TIMING_WHEEL_SLOT_COUNT];
+        std::vector<Entry> m_vecOverflow;
+        std::vector<Entry> m_vecEntry;                  // the entries of the slot being expired or moved down
+    };
+}
+
+#endif //MATCHING_ENGINE_TIMING_WHEEL_H
@@ -0,0 +1,137 @@
+#ifndef MATCHING_ENGINE_TRIGGER_LADDER_H
+#define MATCHING_ENGINE_TRIGGER_LADDER_H
+
+#include <algorithm>
+#include <vector>
+
+#include "order.h"
+
+
+namespace OPNX {
+    // The trigger orders of one stop condition and one trigger type: a sorted array of the trigger prices, each with the
+    // orders of the price in the order of their sortId. The price that triggers first is at the back, so the back is
+    // the cursor at the current price: a price that triggers nothing looks at one level, a triggered level is popped
+    // with its orders, and the new stops, mostly close to the current price, are inserted close to the back.
+    // LESS_EQUAL: triggered when the price <= the trigger price, the highest trigger price first.
+    // GREATER_EQUAL: triggered when the price >= the trigger price, the lowest trigger price first.
+    class TriggerLadder {
+    public:
+        explicit TriggerLadder(OPNX::Order::OrderStopCondition stopCondition) : m_bLessEqual(OPNX::Order::LESS_EQUAL == stopCondition), m_ullSize(0){};
+        TriggerLadder(const TriggerLadder &) = delete;
+        TriggerLadder &operator=(const TriggerLadder &) = delete;
+
+        // The sortId of the order is the highest of its price
+        void add(OPNX::Order* pOrder)
+        {
+            auto it = findLevel(pOrder->triggerPrice);
+            if (m_vecLevel.end() == it || it->llPrice != pOrder->triggerPrice)
+            {
+                it = m_vecLevel.insert(it, Level{pOrder->triggerPrice, {}});
+            }
+            it->vecOrder.push_back(pOrder);
+            m_ullSize++;
+        }
+
+        void erase(const OPNX::Order& order)
+        {
+            auto it = findLevel(order.triggerPrice);
+            if (m_vecLevel.end() == it || it->llPrice != order.triggerPrice)
+            {
+                return;
+            }
+            auto itOrder = std::lower_bound(it->vecOrder.begin(), it->vecOrder.end(), order.sortId, [](const OPNX::Order* pOrder, unsigned long long ullSortId) {
+                return pOrder->sortId < ullSortId;
+            });
+            if (it->vecOrder.end() == itOrder || (*itOrder)->sortId != order.sortId)
+            {
+                return;
+            }
+            it->vecOrder.erase(itOrder);
+            m_ullSize--;
+            if (it->vecOrder.empty())
+            {
+                m_vecLevel.erase(it);
+            }
+        }
+
+        // Calls onTrigger with each order triggered by llPrice and removes them, by trigger price then sortId
+        template <typename F>
+        void trigger(long long llPrice, F onTrigger)
+        {
+            while (!m_vecLevel.empty() && isTriggered(m_vecLevel.back().llPrice, llPrice))
+            {
+                Level& level = m_vecLevel.back();
+                for (auto pOrder: level.vecOrder)
+                {
+                    onTrigger(pOrder);
+                }
+                m_ullSize -= level.vecOrder.size();
+                m_vecLevel.pop_back();
+            }
+        }
+
+        // Calls onOrder with each order, in the order they trigger
+        template <typename F>
+        void forEach(F onOrder) const
+        {
+            for (auto it = m_vecLevel.rbegin(); m_vecLevel.rend() != it; it++)
+            {
+                for (auto pOrder: it->vecOrder)
+                {
+                    onOrder(pOrder);
+                }
+            }
+        }
+
+        void clear()
+        {
+            m_vecLevel.clear();
+            m_ullSize = 0;
+        }
+
+        unsigned long long size() const { return m_ullSize; }
+        bool empty() const { return 0 == m_ullSize; }
+
+    private:
+        struct Level {
+            long long llPrice;
+            std::vector<OPNX::Order*> vecOrder;
+        };
+
+        inline bool isTriggered(long long llTriggerPrice, long long llPrice) const
+        {
+            return m_bLessEqual ? llPrice <= llTriggerPrice : llPrice >= llTriggerPrice;
+        }
+
+        // The level of llPrice, or where it is inserted. The levels are ascending for LESS_EQUAL, descending for GREATER_EQUAL.
+        // The search starts at the back, where most of the prices are
+        std::vector<Level>::iterator findLevel(long long llPrice)
+        {
+            auto before = [this](const Level& level, long long llValue) {
+                return m_bLessEqual ? level.llPrice < llValue : level.llPrice > llValue;
+            };
+            // gallop from the back, then a binary search in the last step
+            size_t size = m_vecLevel.size();
+            size_t step = 1;
+            size_t low = size;
+            while (0 < low && !before(m_vecLevel[low - 1], llPrice))
+            {
+                size_t next = low > step ? low - step : 0;
+                if (0 == next || before(m_vecLevel[next - 1], llPrice))
+                {
+                    return std::lower_bound(m_vecLevel.begin() + next, m_vecLevel.begin() + low, llPrice, before);
+                }
+                low = next;
+                step <<= 1;
+            }
+            return m_vecLevel.begin() + low;
+        }
+
+    private:
+        bool m_bLessEqual;
+        unsigned long long m_ullSize;
+        std::vector<Level> m_vecLevel;
+    };
+}
+
+#endif //MATCHING_ENGINE_TRIGGER_LADDER_H
@@ -0,0 +1,111 @@
+#ifndef MATCHING_ENGINE_TRIGGER_PRICE_QUEUE_H
+#define MATCHING_ENGINE_TRIGGER_PRICE_QUEUE_H
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+
+#include "order.h"
+#include "wait_strategy.h"
+
+
+namespace OPNX {
+    // The trigger prices of the markets for the thread that evaluates them, with the interface of OrderQueue. Only the
+    // latest price of a market matters to its trigger orders, so a market has one slot that a push overwrites, and is
+    // in the queue at most once: a pop returns the freshest price of the market that waits the longest. The queue is
+    // never longer than the number of markets, the consumer evaluates a price once however fast the prices come.
+    class TriggerPriceQueue {
+    public:
+        TriggerPriceQueue() = default;
+        TriggerPriceQueue(const TriggerPriceQueue &) = delete;
+        TriggerPriceQueue &operator=(const TriggerPriceQueue &) = delete;
+
+        void push(const TriggerPrice& triggerPrice)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            Slot& slot = m_unmapSlot[triggerPrice.marketId];
+            slot.llPrice = triggerPrice.price;
+            if (!slot.bQueued)
+            {
+                slot.bQueued = true;
+                m_dequeMarketId.push_back(triggerPrice.marketId);
+                m_condition.notify_all();
+            }
+        }
+
+        bool wait_and_pop(TriggerPrice& triggerPrice, int iTimeout=1)
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_condition.wait_for(lock, std::chrono::seconds(iTimeout), [this]{ return !this->m_dequeMarketId.empty(); });
+            return pop(triggerPrice);
+        }
+
+        // As OrderQueue::wait_and_pop with the wait strategy of the calling thread
+        bool wait_and_pop(TriggerPrice& triggerPrice, WaitStrategy& waitStrategy)
+        {
+            if (WaitStrategy::BLOCKING == waitStrategy.getType())
+            {
+                return wait_and_pop(triggerPrice);
+            }
+            if (try_pop(triggerPrice))
+            {
+                waitStrategy.reset();
+                return true;
+            }
+            waitStrategy.idle();
+            return false;
+        }
+
+        bool try_pop(TriggerPrice& triggerPrice)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return pop(triggerPrice);
+        }
+
+        bool empty() const
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return m_dequeMarketId.empty();
+        }
+
+        // The number of markets with a price to evaluate
+        size_t size() const
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return m_dequeMarketId.size();
+        }
+
+    private:
+        struct Slot {
+            long long llPrice;
+            bool bQueued;
+
+            Slot() : llPrice(Order::MAX_PRICE), bQueued(false){};
+        };
+
+        // m_mutex is locked
+        bool pop(TriggerPrice& triggerPrice)
+        {
+            if (m_dequeMarketId.empty())
+            {
+                return false;
+            }
+            triggerPrice.marketId = m_dequeMarketId.front();
+            m_dequeMarketId.pop_front();
+            Slot& slot = m_unmapSlot[triggerPrice.marketId];
+            slot.bQueued = false;
+            triggerPrice.price = slot.llPrice;
+            return true;
+        }
+
+    private:
+        mutable std::mutex m_mutex;
+        std::condition_variable m_condition;
+        std::unordered_map<unsigned long long, Slot> m_unmapSlot;   // key is marketId, the latest price of the market
+        std::deque<unsigned long long> m_dequeMarketId;             // the markets with a price to evaluate, each once
+    };
+}
+
+#endif //MATCHING_ENGINE_TRIGGER_PRICE_QUEUE_H
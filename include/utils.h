@@ -20,6 +20,10 @@ extern std::atomic<unsigned long long> g_ullSortId;
 extern std::atomic<unsigned long long> g_ullMatchId;
 extern std::atomic<unsigned long long> g_ullSequenceNumber;
 extern unsigned long long g_ullNodeId;
+#ifdef __VIRTUAL_CLOCK__
+// Set by the replay tool, the timestamps of the engine follow the replayed messages
+extern std::atomic<unsigned long long> g_ullVirtualMilliTimestamp;
+#endif
 
 namespace OPNX {
     class Utils {
@@ -32,9 +36,13 @@ namespace OPNX {
         }
         static inline unsigned long long getMilliTimestamp()
         {
+#ifdef __VIRTUAL_CLOCK__
+            return g_ullVirtualMilliTimestamp.load(std::memory_order_relaxed);
+#else
             auto now = std::chrono::system_clock::now();
             auto milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()).count();
             return milliseconds;
+#endif
         }
         static inline unsigned long long getMicroTimestamp()
         {
@@ -64,6 +72,14 @@ namespace OPNX {
             // 4 bits were reserved as the nodeID
             return g_ullSortId.fetch_add(1, std::memory_order_relaxed);
         }
+        // The next sortId is after ullSortId, for the orders that keep a sortId of an earlier process
+        static inline void raiseSortId(unsigned long long ullSortId)
+        {
+            unsigned long long ullNext = g_ullSortId.load(std::memory_order_relaxed);
+            while (ullNext <= ullSortId && !g_ullSortId.compare_exchange_weak(ullNext, ullSortId + 1, std::memory_order_relaxed))
+            {
+            }
+        }
         static inline unsigned long long getMatchId()
         {
             // 4 bits were reserved as the nodeID
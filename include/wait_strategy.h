@@ -0,0 +1,100 @@
+#ifndef MATCHING_ENGINE_WAIT_STRATEGY_H
+#define MATCHING_ENGINE_WAIT_STRATEGY_H
+
+#include <string>
+#include <sched.h>
+#include <unistd.h>
+
+
+namespace OPNX {
+    // How a polling thread waits when it finds no work. idle is called after each empty poll and reset after work,
+    // an object belongs to one thread.
+    // BUSY_SPIN   a pause instruction between the polls, for a thread alone on an isolated cpu
+    // SPIN_YIELD  uiSpinCount pauses, then sched_yield between the polls
+    // SPIN_PARK   uiSpinCount pauses, then sleeps uiParkMicros between the polls
+    // BLOCKING    the queues block on their condition variable, other waits sleep uiParkMicros
+    class WaitStrategy {
+    public:
+        enum Type {
+            BUSY_SPIN,
+            SPIN_YIELD,
+            SPIN_PARK,
+            BLOCKING,
+        };
+
+        explicit WaitStrategy(Type type = BLOCKING, unsigned int uiSpinCount = 1000, unsigned int uiParkMicros = 10)
+        : m_type(type)
+        , m_uiSpinCount(uiSpinCount)
+        , m_uiParkMicros(uiParkMicros)
+        , m_uiIdleCount(0){};
+
+        // busySpin, spinYield, spinPark or blocking
+        static bool parse(const std::string& strType, Type& type)
+        {
+            if ("busySpin" == strType)
+            {
+                type = BUSY_SPIN;
+            }
+            else if ("spinYield" == strType)
+            {
+                type = SPIN_YIELD;
+            }
+            else if ("spinPark" == strType)
+            {
+                type = SPIN_PARK;
+            }
+            else if ("blocking" == strType)
+            {
+                type = BLOCKING;
+            }
+            else
+            {
+                return false;
+            }
+            return true;
+        }
+
+        inline Type getType() const { return m_type; }
+        inline unsigned int getSpinCount() const { return m_uiSpinCount; }
+        inline unsigned int getParkMicros() const { return m_uiParkMicros; }
+
+        inline void idle()
+        {
+            if (BUSY_SPIN == m_type)
+            {
+                pause();
+            }
+            else if (BLOCKING != m_type && m_uiIdleCount < m_uiSpinCount)
+            {
+                m_uiIdleCount++;
+                pause();
+            }
+            else if (SPIN_YIELD == m_type)
+            {
+                sched_yield();
+            }
+            else
+            {
+                usleep(m_uiParkMicros);
+            }
+        }
+        inline void reset() { m_uiIdleCount = 0; }
+
+        static inline void pause()
+        {
+#if defined(__x86_64__) || defined(__i386__)
+            __builtin_ia32_pause();
+#elif defined(__aarch64__)
+            asm volatile("yield");
+#endif
+        }
+
+    private:
+        Type m_type;
+        unsigned int m_uiSpinCount;
+        unsigned int m_uiParkMicros;
+        unsigned int m_uiIdleCount;
+    };
+}
+
+#endif //MATCHING_ENGINE_WAIT_STRATEGY_H
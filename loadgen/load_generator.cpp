@@ -0,0 +1,657 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unistd.h>
+
+#include "load_generator.h"
+#include "manager.h"
+#include "loopback_proxy.h"
+#include "log.h"
+#include "utils.h"
+#include "rapidjson/document.h"
+
+static const int READ_SPIN_COUNT = 10000;                  // empty reads of an outbound ring before the reader sleeps
+static const unsigned long long START_TIMEOUT_MS = 60000;  // the manager sends its markets CMD after 5 seconds
+static const unsigned long long DRAIN_TIMEOUT_MS = 10000;
+static const unsigned long long ACCOUNT_COUNT = 1000;
+
+// The markets of the generator, their mids are consistent with each other so that the implied orders reach the touch:
+// PERP - SPOT = REPO and FUTURE - PERP = SPREAD
+struct LoadMarket {
+    const char* pszMarketCode;
+    const char* pszType;
+    double dTickSize;
+    long long llOffset;
+    bool bFollowSpot;
+    double dWeight;
+};
+static const LoadMarket LOAD_MARKETS[] = {
+    {"BTC-USD-SWAP-LIN", "PERP", 1.0, 1000, true, 0.4},
+    {"BTC-USD", "SPOT", 1.0, 0, true, 0.2},
+    {"BTC-USD-240329-LIN", "FUTURE", 1.0, 10000, true, 0.2},
+    {"BTC-USD-REPO-LIN", "REPO", 0.1, 1000, false, 0.1},
+    {"BTC-USD-SPR-240329-LIN", "SPREAD", 0.1, 9000, false, 0.1},
+};
+
+
+LoadGenerator::LoadGenerator(nlohmann::json& jsonConfig, const LoadProfile& profile)
+: m_jsonConfig(jsonConfig)
+, m_profile(profile)
+, m_pManager(nullptr)
+, m_random(profile.seed)
+, m_llSpotMid(SPOT_MID)
+, m_dExcitation(0)
+, m_ullOrderId(0)
+, m_ullNextMark(0)
+, m_bRunning(false)
+, m_bMarketsRequested(false)
+, m_bReady(false)
+, m_pSendTime(new std::atomic<unsigned long long>[SEND_TIME_SLOTS])
+, m_ullAckCount(0)
+, m_ullReportCount(0)
+, m_ullMatchCount(0)
+, m_ullRejectCount(0)
+, m_ullLostCount(0)
+{
+    for (unsigned long long i = 0; i < SEND_TIME_SLOTS; i++)
+    {
+        m_pSendTime[i].store(0, std::memory_order_relaxed);
+    }
+    // nothing of the run may outlive it, the rings of another generator on the host have other names
+    m_jsonConfig["journalFile"] = "";
+    m_jsonConfig["snapshotFile"] = "";
+    m_jsonConfig["messageTransport"] = ("shm" == m_profile.transport) ? "shm" : "pulsar";
+    m_jsonConfig["shmPrefix"] = "/opnx-loadgen-" + std::to_string(getpid()) + "-";
+    addMarkets();
+}
+
+LoadGenerator::~LoadGenerator()
+{
+    stop();
+    for (auto pMarket: m_vecMarket)
+    {
+        delete pMarket;
+    }
+    m_vecMarket.clear();
+}
+
+void LoadGenerator::addMarkets()
+{
+    int iCount = std::max(1, std::min(m_profile.markets, (int)(sizeof(LOAD_MARKETS) / sizeof(LOAD_MARKETS[0]))));
+    double dWeight = 0;
+    for (int i = 0; i < iCount; i++)
+    {
+        dWeight += LOAD_MARKETS[i].dWeight;
+    }
+    for (int i = 0; i < iCount; i++)
+    {
+        Market* pMarket = new Market();
+        pMarket->marketId = i + 1;
+        pMarket->strMarketCode = LOAD_MARKETS[i].pszMarketCode;
+        pMarket->strType = LOAD_MARKETS[i].pszType;
+        pMarket->dTickSize = LOAD_MARKETS[i].dTickSize;
+        pMarket->llTick = std::llround(LOAD_MARKETS[i].dTickSize * PRICE_FACTOR);
+        pMarket->llOffset = LOAD_MARKETS[i].llOffset;
+        pMarket->bFollowSpot = LOAD_MARKETS[i].bFollowSpot;
+        pMarket->dWeight = LOAD_MARKETS[i].dWeight / dWeight;
+        pMarket->vecLive.reserve(m_profile.maxLive);
+        m_vecMarket.push_back(pMarket);
+    }
+}
+
+nlohmann::json LoadGenerator::getMarketInfo(const Market* pMarket)
+{
+    nlohmann::json jsonMarketInfo;
+    jsonMarketInfo["marketCode"] = pMarket->strMarketCode;
+    jsonMarketInfo["type"] = pMarket->strType;
+    jsonMarketInfo["referencePair"] = "BTC/USD";
+    jsonMarketInfo["marketId"] = pMarket->marketId;
+    jsonMarketInfo["factor"] = PRICE_FACTOR;
+    jsonMarketInfo["qtyFactor"] = 1;
+    jsonMarketInfo["makerFee"] = 0;
+    jsonMarketInfo["tickSize"] = pMarket->dTickSize;
+    jsonMarketInfo["qtyIncrement"] = 1.0;
+    return jsonMarketInfo;
+}
+
+bool LoadGenerator::waitFor(const std::function<bool()>& condition, unsigned long long ullTimeoutMs)
+{
+    unsigned long long ullEnd = OPNX::Utils::getMilliTimestamp() + ullTimeoutMs;
+    while (!condition())
+    {
+        if (OPNX::Utils::getMilliTimestamp() > ullEnd)
+        {
+            return false;
+        }
+        usleep(1000);
+    }
+    return true;
+}
+
+bool LoadGenerator::start()
+{
+    try {
+        LoopbackBus::instance().setCallback([this](unsigned long long ullMarketId, IMessage::ProxyType proxyType, const std::string& strData) {
+            onMessage(ullMarketId, proxyType, strData);
+        });
+        m_bRunning = true;
+        m_pManager = new Manager("", "BTC/USD", m_jsonConfig);
+        m_managerThread = std::thread([this]() { m_pManager->run(); });
+
+        if (!waitFor([this]() { return m_bMarketsRequested.load(); }, START_TIMEOUT_MS))
+        {
+            cfLog.error() << "LoadGenerator::start the manager did not ask for the markets" << std::endl;
+            return false;
+        }
+        nlohmann::json jsonCmd;
+        jsonCmd["action"] = "markets";
+        jsonCmd["pair"] = "BTC/USD";
+        jsonCmd["data"] = nlohmann::json::array();
+        for (auto pMarket: m_vecMarket)
+        {
+            jsonCmd["data"].push_back(getMarketInfo(pMarket));
+        }
+        LoopbackBus::instance().sendCmd(jsonCmd);
+
+        for (auto pMarket: m_vecMarket)
+        {
+            unsigned long long ullMarketId = pMarket->marketId;
+            if (!waitFor([ullMarketId]() { return LoopbackBus::instance().hasMarket(ullMarketId); }, START_TIMEOUT_MS))
+            {
+                cfLog.error() << "LoadGenerator::start the manager did not create the market: " << pMarket->strMarketCode << std::endl;
+                return false;
+            }
+            if ("shm" == m_profile.transport && !attachRings(pMarket))
+            {
+                cfLog.error() << "LoadGenerator::start attach the rings failed, market: " << pMarket->strMarketCode << std::endl;
+                return false;
+            }
+            OPNX::Order recoveryEnd;
+            recoveryEnd.action = OPNX::Order::RECOVERY_END;
+            recoveryEnd.marketId = ullMarketId;
+            LoopbackBus::instance().sendOrder(recoveryEnd);
+        }
+        if (!waitFor([this]() { return m_bReady.load(); }, START_TIMEOUT_MS))
+        {
+            cfLog.error() << "LoadGenerator::start the manager is not READY" << std::endl;
+            return false;
+        }
+        return true;
+    } catch (...) {
+        cfLog.fatal() << "LoadGenerator::start exception!!!" << std::endl;
+    }
+    return false;
+}
+
+// The manager creates the rings right after it registered the market on the bus, the inbound ring last
+bool LoadGenerator::attachRings(Market* pMarket)
+{
+    std::string strName = m_jsonConfig["shmPrefix"].get<std::string>() + std::to_string(pMarket->marketId);
+    if (!waitFor([&]() { return pMarket->orderIn.attach(strName + "-order-in"); }, START_TIMEOUT_MS)
+        || !pMarket->orderOut.attach(strName + "-order-out"))
+    {
+        return false;
+    }
+    pMarket->readThread = std::thread(readOrderOutThread, this, pMarket);
+    return true;
+}
+
+void LoadGenerator::stop()
+{
+    if (nullptr == m_pManager)
+    {
+        return;
+    }
+    m_pManager->exit();
+    if (m_managerThread.joinable())
+    {
+        m_managerThread.join();
+    }
+    m_bRunning = false;
+    for (auto pMarket: m_vecMarket)
+    {
+        if (pMarket->readThread.joinable())
+        {
+            pMarket->readThread.join();
+        }
+        pMarket->orderIn.close();
+        pMarket->orderOut.close();
+    }
+    delete m_pManager;
+    m_pManager = nullptr;
+    LoopbackBus::instance().setCallback(nullptr);
+}
+
+void LoadGenerator::run()
+{
+    double dRate = m_profile.rate;
+    double dSustained = 0;
+    int iStep = 1;
+    for (; iStep <= m_profile.maxSteps; iStep++)
+    {
+        StepResult result;
+        runStep(dRate, result);
+
+        std::sort(result.vecLatency.begin(), result.vecLatency.end());
+        double dAckRate = result.ullAck / result.dSeconds;
+        unsigned long long ullP99 = result.vecLatency.empty() ? 0 : result.vecLatency[result.vecLatency.size() * 99 / 100];
+        bool bSaturated = !result.bDrained || dAckRate < 0.9 * (result.ullNew / result.dSeconds)
+                          || ullP99 > m_profile.maxLatency * 1000;
+        printStep(iStep, dRate, result, bSaturated);
+        if (bSaturated)
+        {
+            break;
+        }
+        dSustained = result.ullSent / result.dSeconds;
+        dRate *= m_profile.stepFactor;
+        if (0 < m_profile.maxRate && dRate > m_profile.maxRate)
+        {
+            break;
+        }
+    }
+    nlohmann::json jsonSummary;
+    jsonSummary["summary"] = "saturation";
+    jsonSummary["transport"] = m_profile.transport;
+    jsonSummary["markets"] = m_vecMarket.size();
+    jsonSummary["seed"] = m_profile.seed;
+    jsonSummary["steps"] = std::min(iStep, m_profile.maxSteps);
+    jsonSummary["sustainedRate"] = std::llround(dSustained);
+    cfLog.printInfo() << jsonSummary.dump() << std::endl;
+}
+
+// Sends the events of one step on their scheduled times, then waits until every new order has its first report
+void LoadGenerator::runStep(double dRate, StepResult& result)
+{
+    result.ullSent = 0;
+    result.ullNew = 0;
+    unsigned long long ullAckBase = m_ullAckCount.load();
+    unsigned long long ullReportBase = m_ullReportCount.load();
+    unsigned long long ullMatchBase = m_ullMatchCount.load();
+    unsigned long long ullRejectBase = m_ullRejectCount.load();
+    unsigned long long ullLostBase = m_ullLostCount.load();
+    {
+        std::lock_guard<std::mutex> lock(m_mutexLatency);
+        m_vecLatency.clear();
+    }
+
+    m_dExcitation = 0;
+    unsigned long long ullDuration = (unsigned long long)(m_profile.duration * 1e9);
+    unsigned long long ullBegin = OPNX::Utils::getNanoTimestamp();
+    double dOffset = nextArrival(dRate);
+    unsigned long long ullNow = ullBegin;
+    while (dOffset * 1e9 < ullDuration)
+    {
+        unsigned long long ullScheduled = ullBegin + (unsigned long long)(dOffset * 1e9);
+        ullNow = OPNX::Utils::getNanoTimestamp();
+        while (ullNow < ullScheduled)
+        {
+            if (ullScheduled - ullNow > 200000)
+            {
+                usleep(50);
+            }
+            ullNow = OPNX::Utils::getNanoTimestamp();
+        }
+        if (ullNow >= m_ullNextMark)
+        {
+            sendMarkPrices();
+            m_ullNextMark = ullNow + m_profile.markInterval * 1000000;
+        }
+        sendEvent(ullScheduled, result);
+        dOffset += nextArrival(dRate);
+    }
+    ullNow = OPNX::Utils::getNanoTimestamp();
+    result.dSeconds = std::max(ullNow - ullBegin, ullDuration) / 1e9;
+    result.ullAck = m_ullAckCount.load() - ullAckBase;
+
+    unsigned long long ullExpected = ullAckBase + result.ullNew;
+    result.bDrained = waitFor([this, ullExpected]() { return m_ullAckCount.load() >= ullExpected; }, DRAIN_TIMEOUT_MS);
+    result.ullReports = m_ullReportCount.load() - ullReportBase;
+    result.ullMatches = m_ullMatchCount.load() - ullMatchBase;
+    result.ullRejects = m_ullRejectCount.load() - ullRejectBase;
+    result.ullLost = m_ullLostCount.load() - ullLostBase;
+    std::lock_guard<std::mutex> lock(m_mutexLatency);
+    result.vecLatency.swap(m_vecLatency);
+}
+
+// One event of a market: amend, stop, aggressive IOC/FOK, cancel or passive order.
+// A passive order is added for each cancel and each aggressive order, so the books keep their size.
+void LoadGenerator::sendEvent(unsigned long long ullScheduled, StepResult& result)
+{
+    Market* pMarket = pickMarket();
+    if (uniform() < m_profile.driftShare)
+    {
+        m_llSpotMid += (m_random() & 1) ? PRICE_FACTOR : -PRICE_FACTOR;
+        m_llSpotMid = std::max(m_llSpotMid, SPOT_MID / 2);
+    }
+    long long llMid = getMid(pMarket);
+    OPNX::Order::OrderSide side = (m_random() & 1) ? OPNX::Order::SELL : OPNX::Order::BUY;
+    long long llDirection = (OPNX::Order::BUY == side) ? 1 : -1;
+    double dAggressiveShare = std::max(0.0, 1 - m_profile.amendShare - m_profile.stopShare) / (2 + 2 * m_profile.cancelRatio);
+    double dEvent = uniform();
+    result.ullSent++;
+
+    if (dEvent < m_profile.amendShare + m_profile.stopShare + dAggressiveShare * (1 + m_profile.cancelRatio)
+        && dEvent >= m_profile.amendShare + m_profile.stopShare + dAggressiveShare && !pMarket->vecLive.empty())
+    {
+        unsigned long long index = m_random() % pMarket->vecLive.size();
+        LiveOrder& liveOrder = pMarket->vecLive[index];
+        OPNX::Order order = createOrder(pMarket, liveOrder.side, liveOrder.price, liveOrder.quantity);
+        order.action = OPNX::Order::CANCEL;
+        order.orderId = liveOrder.orderId;
+        order.accountId = liveOrder.accountId;
+        liveOrder = pMarket->vecLive.back();
+        pMarket->vecLive.pop_back();
+        sendOrder(pMarket, order);
+        return;
+    }
+    if (dEvent < m_profile.amendShare && !pMarket->vecLive.empty())
+    {
+        // a smaller quantity keeps the priority, an order with nothing left to take off is canceled
+        unsigned long long index = m_random() % pMarket->vecLive.size();
+        LiveOrder& liveOrder = pMarket->vecLive[index];
+        OPNX::Order order = createOrder(pMarket, liveOrder.side, liveOrder.price, liveOrder.quantity - 1);
+        order.orderId = liveOrder.orderId;
+        order.accountId = liveOrder.accountId;
+        if (1 < liveOrder.quantity)
+        {
+            order.action = OPNX::Order::AMEND;
+            order.displayQuantity = std::min(liveOrder.displayQuantity, order.quantity);
+            liveOrder.quantity = order.quantity;
+            liveOrder.displayQuantity = order.displayQuantity;
+        }
+        else
+        {
+            order.action = OPNX::Order::CANCEL;
+            liveOrder = pMarket->vecLive.back();
+            pMarket->vecLive.pop_back();
+        }
+        sendOrder(pMarket, order);
+        return;
+    }
+    if (dEvent >= m_profile.amendShare && dEvent < m_profile.amendShare + m_profile.stopShare)
+    {
+        // a stop a few ticks away from the mid on the side it protects, the drift of the mid triggers it
+        long long llTriggerPrice = llMid + llDirection * (2 + placement()) * pMarket->llTick;
+        OPNX::Order order = createOrder(pMarket, side, llTriggerPrice + llDirection * 2 * pMarket->llTick, 1 + m_random() % 10);
+        order.type = OPNX::Order::STOP_LIMIT;
+        order.triggerPrice = llTriggerPrice;
+        order.triggerType = (m_random() & 1) ? OPNX::Order::LAST_PRICE : OPNX::Order::MARK_PRICE;
+        order.stopCondition = (OPNX::Order::BUY == side) ? OPNX::Order::GREATER_EQUAL : OPNX::Order::LESS_EQUAL;
+        sendNew(pMarket, order, ullScheduled, result);
+        return;
+    }
+    if (dEvent >= m_profile.amendShare + m_profile.stopShare && dEvent < m_profile.amendShare + m_profile.stopShare + dAggressiveShare)
+    {
+        OPNX::Order order = createOrder(pMarket, side, llMid + llDirection * (1 + placement()) * pMarket->llTick, 1 + m_random() % 10);
+        order.timeCondition = (uniform() < m_profile.fokShare) ? OPNX::Order::FOK : OPNX::Order::IOC;
+        sendNew(pMarket, order, ullScheduled, result);
+        return;
+    }
+
+    // passive, the distance to the touch is geometric
+    OPNX::Order order = createOrder(pMarket, side, llMid - llDirection * (1 + placement()) * pMarket->llTick, 1 + m_random() % 20);
+    if (uniform() < m_profile.icebergShare)
+    {
+        order.quantity = 100 + m_random() % 200;
+        order.remainQuantity = order.quantity;
+        order.displayQuantity = 10;
+    }
+    LiveOrder liveOrder{order.orderId, order.accountId, order.price, order.quantity, order.displayQuantity, side};
+    if (pMarket->vecLive.size() < m_profile.maxLive)
+    {
+        pMarket->vecLive.push_back(liveOrder);
+    }
+    else
+    {
+        pMarket->vecLive[m_random() % pMarket->vecLive.size()] = liveOrder;
+    }
+    sendNew(pMarket, order, ullScheduled, result);
+}
+
+void LoadGenerator::sendNew(Market* pMarket, OPNX::Order& order, unsigned long long ullScheduled, StepResult& result)
+{
+    m_pSendTime[order.orderId % SEND_TIME_SLOTS].store(ullScheduled, std::memory_order_release);
+    result.ullNew++;
+    sendOrder(pMarket, order);
+}
+
+void LoadGenerator::sendOrder(Market* pMarket, OPNX::Order& order)
+{
+    if ("shm" != m_profile.transport)
+    {
+        LoopbackBus::instance().sendOrder(order);
+        return;
+    }
+    // a full inbound ring is the back pressure of the engine, the waiting time is part of the latency
+    while (!pMarket->orderIn.push(order))
+    {
+        std::this_thread::yield();
+    }
+}
+
+void LoadGenerator::sendMarkPrices()
+{
+    for (auto pMarket: m_vecMarket)
+    {
+        LoopbackBus::instance().sendMarkPrice(pMarket->marketId, getMid(pMarket));
+    }
+}
+
+void LoadGenerator::printStep(int iStep, double dRate, StepResult& result, bool bSaturated)
+{
+    auto percentile = [&result](unsigned long long ullPermille) -> double {
+        if (result.vecLatency.empty())
+        {
+            return 0;
+        }
+        unsigned long long index = std::min<unsigned long long>(result.vecLatency.size() - 1, result.vecLatency.size() * ullPermille / 1000);
+        return std::round(result.vecLatency[index] / 100.0) / 10;   // micro seconds with one decimal
+    };
+    nlohmann::json jsonStep;
+    jsonStep["step"] = iStep;
+    jsonStep["transport"] = m_profile.transport;
+    jsonStep["markets"] = m_vecMarket.size();
+    jsonStep["seed"] = m_profile.seed;
+    jsonStep["targetRate"] = std::llround(dRate);
+    jsonStep["sentRate"] = std::llround(result.ullSent / result.dSeconds);
+    jsonStep["newRate"] = std::llround(result.ullNew / result.dSeconds);
+    jsonStep["ackRate"] = std::llround(result.ullAck / result.dSeconds);
+    jsonStep["backlog"] = result.ullNew - std::min(result.ullNew, result.ullAck);
+    jsonStep["reports"] = result.ullReports;
+    jsonStep["matches"] = result.ullMatches;
+    jsonStep["rejects"] = result.ullRejects;
+    jsonStep["lost"] = result.ullLost;
+    jsonStep["p50"] = percentile(500);
+    jsonStep["p90"] = percentile(900);
+    jsonStep["p99"] = percentile(990);
+    jsonStep["p999"] = percentile(999);
+    jsonStep["max"] = percentile(1000);
+    jsonStep["saturated"] = bSaturated;
+    cfLog.printInfo() << jsonStep.dump() << std::endl;
+}
+
+// Seconds to the next event. Poisson for hawkes 0, otherwise Ogata thinning of a hawkes process whose base rate is
+// dRate * (1 - hawkes), so that its mean rate is dRate: each event raises the intensity by hawkes * hawkesDecay.
+double LoadGenerator::nextArrival(double dRate)
+{
+    if (0 >= m_profile.hawkes || 1 <= m_profile.hawkes)
+    {
+        return -std::log(1 - uniform()) / dRate;
+    }
+    double dBase = dRate * (1 - m_profile.hawkes);
+    double dWait = 0;
+    while (true)
+    {
+        double dUpper = dBase + m_dExcitation;
+        double dStep = -std::log(1 - uniform()) / dUpper;
+        dWait += dStep;
+        m_dExcitation *= std::exp(-m_profile.hawkesDecay * dStep);
+        if (uniform() * dUpper <= dBase + m_dExcitation)
+        {
+            m_dExcitation += m_profile.hawkes * m_profile.hawkesDecay;
+            return dWait;
+        }
+    }
+}
+
+double LoadGenerator::uniform()
+{
+    return (m_random() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// Ticks behind the touch, P(k) = 2^-(k+1)
+unsigned long long LoadGenerator::placement()
+{
+    unsigned long long ullTicks = 0;
+    while (ullTicks < 50 && (m_random() & 1))
+    {
+        ullTicks++;
+    }
+    return ullTicks;
+}
+
+LoadGenerator::Market* LoadGenerator::pickMarket()
+{
+    double dPick = uniform();
+    for (auto pMarket: m_vecMarket)
+    {
+        if (dPick < pMarket->dWeight)
+        {
+            return pMarket;
+        }
+        dPick -= pMarket->dWeight;
+    }
+    return m_vecMarket.back();
+}
+
+long long LoadGenerator::getMid(const Market* pMarket)
+{
+    return pMarket->bFollowSpot ? m_llSpotMid + pMarket->llOffset : pMarket->llOffset;
+}
+
+OPNX::Order LoadGenerator::createOrder(Market* pMarket, OPNX::Order::OrderSide side, long long llPrice, unsigned long long ullQuantity)
+{
+    OPNX::Order order;
+    order.action = OPNX::Order::NEW;
+    order.type = OPNX::Order::LIMIT;
+    order.timeCondition = OPNX::Order::GTC;
+    order.side = side;
+    order.price = std::max(llPrice, pMarket->llTick);
+    order.quantity = ullQuantity;
+    order.displayQuantity = ullQuantity;
+    order.remainQuantity = ullQuantity;
+    order.accountId = 1 + m_random() % ACCOUNT_COUNT;
+    order.marketId = pMarket->marketId;
+    order.orderId = ++m_ullOrderId;
+    order.clientOrderId = order.orderId;
+    order.timestamp = OPNX::Utils::getMilliTimestamp();
+    return order;
+}
+
+void LoadGenerator::onMessage(unsigned long long ullMarketId, IMessage::ProxyType proxyType, const std::string& strData)
+{
+    try {
+        if (IMessage::COMMAND == proxyType)
+        {
+            nlohmann::json jsonCmd = nlohmann::json::parse(strData);
+            std::string strAction = "";
+            OPNX::Utils::getJsonValue<std::string>(strAction, jsonCmd, "action");
+            if ("markets" == strAction)
+            {
+                m_bMarketsRequested = true;
+            }
+            else if ("queryStatus" == strAction && jsonCmd.contains("data") && "READY" == jsonCmd["data"])
+            {
+                m_bReady = true;
+            }
+        }
+        else if ((IMessage::ORDER == proxyType || IMessage::ORDERS == proxyType) && "shm" != m_profile.transport)
+        {
+            // with shm the same reports come through the outbound rings
+            handleReport(strData.c_str());
+        }
+    } catch (...) {
+        cfLog.fatal() << "LoadGenerator::onMessage exception!!!" << std::endl;
+    }
+}
+
+// {"pt":"Order","im":bool,"ii":bool,"ol":[orders]}, the first report of a new order is its ack
+void LoadGenerator::handleReport(const char* pszData)
+{
+    unsigned long long ullNow = OPNX::Utils::getNanoTimestamp();
+    rapidjson::Document document;
+    document.Parse(pszData);
+    if (document.HasParseError() || !document.IsObject())
+    {
+        return;
+    }
+    m_ullReportCount++;
+    auto itMatched = document.FindMember("im");
+    if (document.MemberEnd() != itMatched && itMatched->value.IsBool() && itMatched->value.GetBool())
+    {
+        m_ullMatchCount++;
+    }
+    auto itOrderList = document.FindMember(OPNX::key_orderList);
+    if (document.MemberEnd() == itOrderList || !itOrderList->value.IsArray())
+    {
+        return;
+    }
+    for (auto& order: itOrderList->value.GetArray())
+    {
+        auto itStatus = order.FindMember(OPNX::key_status);
+        if (order.MemberEnd() != itStatus && itStatus->value.IsString() && 0 == strncmp(itStatus->value.GetString(), "REJECT", 6))
+        {
+            m_ullRejectCount++;
+        }
+        auto itOrderId = order.FindMember(OPNX::key_orderId);
+        if (order.MemberEnd() == itOrderId || !itOrderId->value.IsUint64())
+        {
+            continue;
+        }
+        unsigned long long ullScheduled = m_pSendTime[itOrderId->value.GetUint64() % SEND_TIME_SLOTS].exchange(0, std::memory_order_acq_rel);
+        if (0 == ullScheduled)
+        {
+            continue;
+        }
+        m_ullAckCount++;
+        std::lock_guard<std::mutex> lock(m_mutexLatency);
+        m_vecLatency.push_back(ullNow > ullScheduled ? ullNow - ullScheduled : 0);
+    }
+}
+
+void LoadGenerator::readOrderOutThread(LoadGenerator* pLoadGenerator, Market* pMarket)
+{
+    if (nullptr != pLoadGenerator)
+    {
+        pLoadGenerator->readOrderOut(pMarket);
+    }
+}
+
+// Busy reads the outbound ring of the market like a co-located gateway, a reader that is overwritten counts it as lost
+void LoadGenerator::readOrderOut(Market* pMarket)
+{
+    unsigned long long ullPosition = pMarket->orderOut.getWritePosition();
+    std::string strData;
+    int iEmptyCount = 0;
+    while (m_bRunning)
+    {
+        OPNX::ShmBroadcast::ReadResult readResult = pMarket->orderOut.read(ullPosition, strData);
+        if (OPNX::ShmBroadcast::READ_OK == readResult)
+        {
+            iEmptyCount = 0;
+            handleReport(strData.c_str());
+        }
+        else if (OPNX::ShmBroadcast::READ_LOST == readResult)
+        {
+            m_ullLostCount++;
+        }
+        else if (READ_SPIN_COUNT > iEmptyCount)
+        {
+            iEmptyCount++;
+        }
+        else
+        {
+            usleep(10);
+        }
+    }
+}
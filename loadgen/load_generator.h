@@ -0,0 +1,176 @@
+#ifndef MATCHING_ENGINE_LOAD_GENERATOR_H
+#define MATCHING_ENGINE_LOAD_GENERATOR_H
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "IMessage.h"
+#include "json.hpp"
+#include "order.h"
+#include "shm_ring.h"
+
+class Manager;
+
+// The shape of the generated flow and the load steps
+struct LoadProfile {
+    std::string transport;           // "loopback": LoopbackBus, "shm": the shared memory rings of the markets
+    unsigned long long seed;
+    int markets;                     // the first markets of PERP, SPOT, FUTURE, REPO, SPREAD, the implied links need at least 3
+    double rate;                     // orders per second of the first step
+    double stepFactor;               // the rate of the next step is rate * stepFactor
+    double maxRate;                  // 0: no limit
+    int maxSteps;
+    double duration;                 // seconds of each step
+    double hawkes;                   // branching ratio of the hawkes arrivals in [0, 1), 0 is poisson
+    double hawkesDecay;              // decay of the excitation per second
+    double cancelRatio;              // cancels for each aggressive order
+    double amendShare;               // share of the events that amend a resting order
+    double stopShare;                // share of the events that are stop orders
+    double icebergShare;             // share of the passive orders that are iceberg
+    double fokShare;                 // share of the aggressive orders that are FOK instead of IOC
+    double driftShare;               // share of the events that move the mid one tick
+    unsigned long long maxLive;      // resting orders remembered for each market to cancel and amend
+    unsigned long long markInterval; // milli seconds between two mark prices of a market
+    unsigned long long maxLatency;   // micro seconds, a step with a larger p99 is saturated
+
+    LoadProfile()
+    : transport("loopback")
+    , seed(1)
+    , markets(5)
+    , rate(10000)
+    , stepFactor(2)
+    , maxRate(0)
+    , maxSteps(10)
+    , duration(5)
+    , hawkes(0)
+    , hawkesDecay(1000)
+    , cancelRatio(10)
+    , amendShare(0.05)
+    , stopShare(0.02)
+    , icebergShare(0.05)
+    , fokShare(0.2)
+    , driftShare(0.01)
+    , maxLive(10000)
+    , markInterval(100)
+    , maxLatency(10000){};
+};
+
+// Drives a Manager with its real queues, threads and proxies through LoopbackBus or the shared memory rings and raises
+// the rate of a synthetic flow step by step until the engine saturates.
+// The flow: passive orders around the touch, IOC/FOK orders through the touch, cancels and amends of resting orders,
+// iceberg and stop orders, on markets whose mids move together so that the implied orders of the config take part.
+// Each step prints one json line with the sent and acknowledged rates and the latency percentiles in micro seconds.
+// The latency of a new order is from the time it was scheduled to its first report, so a generator that falls behind
+// counts the waiting time as well. Fills do not remove the resting orders of the generator, a cancel or amend of a filled
+// order is rejected like the late cancel of a client and counted in rejects.
+class LoadGenerator {
+public:
+    LoadGenerator(nlohmann::json& jsonConfig, const LoadProfile& profile);
+    ~LoadGenerator();
+    LoadGenerator(const LoadGenerator &) = delete;
+    LoadGenerator &operator=(const LoadGenerator &) = delete;
+
+public:
+    // Runs the manager and waits until it is READY
+    bool start();
+    // Runs the steps until the first saturated one or maxSteps
+    void run();
+    void stop();
+
+private:
+    struct LiveOrder {
+        unsigned long long orderId;
+        unsigned long long accountId;
+        long long price;
+        unsigned long long quantity;
+        unsigned long long displayQuantity;
+        OPNX::Order::OrderSide side;
+    };
+    struct Market {
+        unsigned long long marketId;
+        std::string strMarketCode;
+        std::string strType;
+        double dTickSize;
+        long long llTick;
+        long long llOffset;           // the mid is the spot mid + llOffset, or llOffset for bFollowSpot false
+        bool bFollowSpot;
+        double dWeight;               // share of the events of this market
+        std::vector<LiveOrder> vecLive;
+        OPNX::ShmQueue<OPNX::Order> orderIn;
+        OPNX::ShmBroadcast orderOut;
+        std::thread readThread;
+    };
+    struct StepResult {
+        unsigned long long ullSent;       // all events
+        unsigned long long ullNew;        // new orders, whose first report is the ack
+        unsigned long long ullAck;
+        unsigned long long ullReports;
+        unsigned long long ullMatches;
+        unsigned long long ullRejects;
+        unsigned long long ullLost;
+        double dSeconds;                  // duration of the sending
+        bool bDrained;
+        std::vector<unsigned long long> vecLatency;
+    };
+
+    void addMarkets();
+    nlohmann::json getMarketInfo(const Market* pMarket);
+    bool attachRings(Market* pMarket);
+    bool waitFor(const std::function<bool()>& condition, unsigned long long ullTimeoutMs);
+
+    void runStep(double dRate, StepResult& result);
+    void sendEvent(unsigned long long ullScheduled, StepResult& result);
+    void sendNew(Market* pMarket, OPNX::Order& order, unsigned long long ullScheduled, StepResult& result);
+    void sendOrder(Market* pMarket, OPNX::Order& order);
+    void sendMarkPrices();
+    void printStep(int iStep, double dRate, StepResult& result, bool bSaturated);
+
+    double nextArrival(double dRate);
+    double uniform();
+    unsigned long long placement();
+    Market* pickMarket();
+    long long getMid(const Market* pMarket);
+    OPNX::Order createOrder(Market* pMarket, OPNX::Order::OrderSide side, long long llPrice, unsigned long long ullQuantity);
+
+    void onMessage(unsigned long long ullMarketId, IMessage::ProxyType proxyType, const std::string& strData);
+    void handleReport(const char* pszData);
+    void readOrderOut(Market* pMarket);
+    static void readOrderOutThread(LoadGenerator* pLoadGenerator, Market* pMarket);
+
+private:
+    static const long long PRICE_FACTOR = 100;              // factor of the generated markets
+    static const long long SPOT_MID = 3000000;              // 30000.00
+    static const unsigned long long SEND_TIME_SLOTS = 1 << 22;  // scheduled times of the orders in flight, by orderId
+
+    nlohmann::json m_jsonConfig;
+    LoadProfile m_profile;
+    Manager* m_pManager;
+    std::thread m_managerThread;
+    std::vector<Market*> m_vecMarket;
+    std::mt19937_64 m_random;
+    long long m_llSpotMid;
+    double m_dExcitation;                 // hawkes intensity above the base rate
+    unsigned long long m_ullOrderId;
+    unsigned long long m_ullNextMark;
+    std::atomic<bool> m_bRunning;
+    std::atomic<bool> m_bMarketsRequested;
+    std::atomic<bool> m_bReady;
+
+    // the sending thread writes, the reporting threads of the manager or the ring readers read
+    std::unique_ptr<std::atomic<unsigned long long>[]> m_pSendTime;
+    std::atomic<unsigned long long> m_ullAckCount;
+    std::atomic<unsigned long long> m_ullReportCount;
+    std::atomic<unsigned long long> m_ullMatchCount;
+    std::atomic<unsigned long long> m_ullRejectCount;
+    std::atomic<unsigned long long> m_ullLostCount;
+    std::mutex m_mutexLatency;
+    std::vector<unsigned long long> m_vecLatency;   // nano seconds
+};
+
+#endif //MATCHING_ENGINE_LOAD_GENERATOR_H
@@ -0,0 +1,162 @@
+#include <string>
+#include <cstdlib>
+#include <fstream>
+
+#include "load_generator.h"
+#include "log.h"
+#include "utils.h"
+#include "global.h"
+
+
+// init global variables of global.h
+unsigned long long g_ullPerpMarketId = 0;
+long long g_llPerpMarkPrice = 0;
+unsigned long long g_ullRepoMarketId = 0;
+
+// init global variables of utils.h
+std::atomic<unsigned long long> g_ullSortId(OPNX::Utils::getMilliTimestamp() * 1000);
+std::atomic<unsigned long long> g_ullMatchId(OPNX::Utils::getMilliTimestamp() * 1000);
+std::atomic<unsigned long long> g_ullSequenceNumber(OPNX::Utils::getMilliTimestamp() * 1000);
+unsigned long long g_ullNodeId = 0;
+
+CallBackPulsarLog pulsarLog = [](const std::string& strLog) {};
+OPNX::Log cfLog(OPNX::Log::ERROR, pulsarLog);
+
+static void usage(const char* pszName)
+{
+    // one std::endl, the log prints its buffer on each flush
+    cfLog.printInfo() << "usage: " << pszName << " [--config file] [--transport loopback|shm] [--markets n] [--rate n] [--step x]\n"
+                      << "       [--max-rate n] [--max-steps n] [--duration s] [--hawkes n] [--hawkes-decay b] [--cancel-ratio r]\n"
+                      << "       [--amend-share x] [--stop-share x] [--iceberg-share x] [--fok-share x] [--max-latency us] [--seed n] [--log level]\n"
+                      << "  --config        config of the manager, the default is ./config.json\n"
+                      << "  --transport     how the orders reach the manager, the default is loopback\n"
+                      << "  --markets       1 to 5 of PERP, SPOT, FUTURE, REPO, SPREAD, the default is 5\n"
+                      << "  --rate          orders per second of the first step, the default is 10000\n"
+                      << "  --step          rate factor of the next step, the default is 2\n"
+                      << "  --duration      seconds of each step, the default is 5\n"
+                      << "  --hawkes        branching ratio of the arrivals in [0, 1), the default 0 is poisson\n"
+                      << "  --cancel-ratio  cancels for each aggressive order, the default is 10\n"
+                      << "  --max-latency   p99 in micro seconds above which a step is saturated, the default is 10000\n"
+                      << "  prints one json line for each step and a summary, the latencies are micro seconds" << std::endl;
+}
+
+int main(int iArgc, char** pszArgv) {
+
+    std::string strConfigFile = "./config.json";
+    LoadProfile profile;
+    int iLogLevel = OPNX::Log::ERROR;
+    for (int i = 1; i < iArgc; i++)
+    {
+        std::string strArg = pszArgv[i];
+        if (i + 1 >= iArgc)
+        {
+            usage(pszArgv[0]);
+            return 1;
+        }
+        std::string strValue = pszArgv[++i];
+        if ("--config" == strArg)
+        {
+            strConfigFile = strValue;
+        }
+        else if ("--transport" == strArg && ("loopback" == strValue || "shm" == strValue))
+        {
+            profile.transport = strValue;
+        }
+        else if ("--markets" == strArg)
+        {
+            profile.markets = atoi(strValue.c_str());
+        }
+        else if ("--rate" == strArg)
+        {
+            profile.rate = atof(strValue.c_str());
+        }
+        else if ("--step" == strArg)
+        {
+            profile.stepFactor = atof(strValue.c_str());
+        }
+        else if ("--max-rate" == strArg)
+        {
+            profile.maxRate = atof(strValue.c_str());
+        }
+        else if ("--max-steps" == strArg)
+        {
+            profile.maxSteps = atoi(strValue.c_str());
+        }
+        else if ("--duration" == strArg)
+        {
+            profile.duration = atof(strValue.c_str());
+        }
+        else if ("--hawkes" == strArg)
+        {
+            profile.hawkes = atof(strValue.c_str());
+        }
+        else if ("--hawkes-decay" == strArg)
+        {
+            profile.hawkesDecay = atof(strValue.c_str());
+        }
+        else if ("--cancel-ratio" == strArg)
+        {
+            profile.cancelRatio = atof(strValue.c_str());
+        }
+        else if ("--amend-share" == strArg)
+        {
+            profile.amendShare = atof(strValue.c_str());
+        }
+        else if ("--stop-share" == strArg)
+        {
+            profile.stopShare = atof(strValue.c_str());
+        }
+        else if ("--iceberg-share" == strArg)
+        {
+            profile.icebergShare = atof(strValue.c_str());
+        }
+        else if ("--fok-share" == strArg)
+        {
+            profile.fokShare = atof(strValue.c_str());
+        }
+        else if ("--max-latency" == strArg)
+        {
+            profile.maxLatency = strtoull(strValue.c_str(), nullptr, 10);
+        }
+        else if ("--seed" == strArg)
+        {
+            profile.seed = strtoull(strValue.c_str(), nullptr, 10);
+        }
+        else if ("--log" == strArg)
+        {
+            iLogLevel = atoi(strValue.c_str());
+            cfLog.setLogLevel((OPNX::Log::Level)iLogLevel);
+        }
+        else
+        {
+            usage(pszArgv[0]);
+            return 1;
+        }
+    }
+    if (0 >= profile.rate || 0 >= profile.duration || 1 > profile.stepFactor)
+    {
+        usage(pszArgv[0]);
+        return 1;
+    }
+
+    nlohmann::json jsonConfig;
+    try {
+        std::ifstream ifs(strConfigFile);
+        ifs >> jsonConfig;
+    } catch (...) {
+        cfLog.error() << "load config failed, file: " << strConfigFile << std::endl;
+        return 1;
+    }
+    // the manager logs at the level of the command line, not of the config
+    jsonConfig["logLevel"] = iLogLevel;
+
+    LoadGenerator loadGenerator(jsonConfig, profile);
+    if (!loadGenerator.start())
+    {
+        loadGenerator.stop();
+        return 1;
+    }
+    loadGenerator.run();
+    loadGenerator.stop();
+    return 0;
+}
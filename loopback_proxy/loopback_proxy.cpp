@@ -0,0 +1,249 @@
+#include <sstream>
+#include "loopback_proxy.h"
+#include "log.h"
+#include "utils.h"
+
+
+IMessage* createIMessage(OPNX::OrderQueue<OPNX::Order>* pOrderQueue,
+                         OPNX::OrderQueue<OPNX::Order>* pTriggerOrderQueue,
+                         OPNX::TriggerPriceQueue* pMarkPriceQueue,
+                         OPNX::OrderQueue<nlohmann::json>* pCmdQueue,
+                         const std::string& strServiceUrl){
+    return LoopbackProxy::createIMessage(pOrderQueue, pTriggerOrderQueue, pMarkPriceQueue, pCmdQueue);
+};
+IMessage* LoopbackProxy::createIMessage(OPNX::OrderQueue<OPNX::Order>* pOrderQueue,
+                                        OPNX::OrderQueue<OPNX::Order>* pTriggerOrderQueue,
+                                        OPNX::TriggerPriceQueue* pMarkPriceQueue,
+                                        OPNX::OrderQueue<nlohmann::json>* pCmdQueue){
+    return static_cast<IMessage*>(new LoopbackProxy(pOrderQueue, pTriggerOrderQueue, pMarkPriceQueue, pCmdQueue));
+};
+
+void LoopbackProxy::releaseIMessage() {
+    delete this;
+}
+LoopbackProxy::~LoopbackProxy()
+{
+    LoopbackBus::instance().remove(this);
+}
+
+void LoopbackProxy::createMarketAll(const nlohmann::json& jsonConfig)
+{
+    setMarketInfo(jsonConfig);
+    LoopbackBus::instance().addMarket(m_ullMarketId, this);
+}
+void LoopbackProxy::createCommander(const std::string& strReferencePair)
+{
+    m_bIsCommander = true;
+    LoopbackBus::instance().setCommander(this);
+}
+
+void LoopbackProxy::exitConsumer()
+{
+    LoopbackBus::instance().remove(this);
+}
+
+void LoopbackProxy::setMarketInfo(const nlohmann::json& jsonMarketInfo)
+{
+    OPNX::Utils::getJsonValue<unsigned long long>(m_ullMarketId, jsonMarketInfo, "marketId");
+    OPNX::Utils::getJsonValue<std::string>(m_strMarketCode, jsonMarketInfo, "marketCode");
+}
+
+void LoopbackProxy::receiveOrder(OPNX::Order& order)
+{
+    order.receivedTime = OPNX::Utils::getNanoTimestamp();
+    if (m_bIsRecovery)
+    {
+        if (OPNX::Order::RECOVERY_END == order.action)
+        {
+            // The engine collects the RECOVERY orders and loads them into its order book at RECOVERY_END
+            if (m_pOrderQueue)
+            {
+                order.marketId = m_ullMarketId;
+                m_pOrderQueue->push(order);
+            }
+            m_bIsRecovery = false;
+            return;
+        }
+        if (OPNX::Order::RECOVERY != order.action)
+        {
+            order.status = OPNX::Order::REJECT_MATCHING_ENGINE_RECOVERING;
+            sendReject(order);
+            return;
+        }
+    }
+    if (!m_orderRouter.pushOrder(order))
+    {
+        sendReject(order);
+    }
+}
+
+void LoopbackProxy::receiveMassQuote(std::vector<OPNX::Order>& vecQuote)
+{
+    unsigned long long ullReceivedTime = OPNX::Utils::getNanoTimestamp();
+    for (auto& quote: vecQuote)
+    {
+        quote.receivedTime = ullReceivedTime;
+    }
+    if (m_bIsRecovery)
+    {
+        for (auto& quote: vecQuote)
+        {
+            quote.status = OPNX::Order::REJECT_MATCHING_ENGINE_RECOVERING;
+            sendReject(quote);
+        }
+        return;
+    }
+    std::vector<OPNX::Order> vecReject;
+    m_orderRouter.pushMassQuote(vecQuote, vecReject);
+    for (auto& quote: vecReject)
+    {
+        sendReject(quote);
+    }
+}
+
+void LoopbackProxy::receiveMarkPrice(long long llMarkPrice)
+{
+    if (m_pMarkPriceQueue && !m_bIsRecovery)
+    {
+        OPNX::TriggerPrice markPrice;
+        markPrice.price = llMarkPrice;
+        markPrice.marketId = m_ullMarketId;
+        m_pMarkPriceQueue->push(markPrice);
+    }
+}
+
+void LoopbackProxy::receiveCmd(const nlohmann::json& jsonCmd)
+{
+    if (m_pCmdQueue)
+    {
+        m_pCmdQueue->push(jsonCmd);
+    }
+}
+
+void LoopbackProxy::send(ProxyType proxyType, const std::string& strData)
+{
+    auto& callback = LoopbackBus::instance().getCallback();
+    if (callback)
+    {
+        callback(m_bIsCommander ? 0 : m_ullMarketId, proxyType, strData);
+    }
+}
+void LoopbackProxy::send(ProxyType proxyType, const nlohmann::json& jsonData)
+{
+    auto& callback = LoopbackBus::instance().getCallback();
+    if (callback)
+    {
+        callback(m_bIsCommander ? 0 : m_ullMarketId, proxyType, jsonData.dump());
+    }
+}
+
+void LoopbackProxy::sendReject(const OPNX::Order& order)
+{
+    std::stringstream ssOrder;
+    std::string strJsonOrder = "";
+    OPNX::Order::orderToJsonString(order, strJsonOrder);
+    ssOrder << "{\"pt\":\"Order\",\"ol\":[" << strJsonOrder << "]}";
+    sendOrder(ssOrder.str());
+}
+
+
+LoopbackBus& LoopbackBus::instance()
+{
+    static LoopbackBus loopbackBus;
+    return loopbackBus;
+}
+
+bool LoopbackBus::sendOrder(OPNX::Order& order)
+{
+    std::lock_guard<std::recursive_mutex> lock(m_mutex);
+    auto it = m_mapProxy.find(order.marketId);
+    if (m_mapProxy.end() == it)
+    {
+        return false;
+    }
+    it->second->receiveOrder(order);
+    return true;
+}
+
+bool LoopbackBus::sendMassQuote(std::vector<OPNX::Order>& vecQuote)
+{
+    if (vecQuote.empty())
+    {
+        return false;
+    }
+    std::lock_guard<std::recursive_mutex> lock(m_mutex);
+    auto it = m_mapProxy.find(vecQuote[0].marketId);
+    if (m_mapProxy.end() == it)
+    {
+        return false;
+    }
+    it->second->receiveMassQuote(vecQuote);
+    return true;
+}
+
+bool LoopbackBus::sendMarkPrice(unsigned long long ullMarketId, long long llMarkPrice)
+{
+    std::lock_guard<std::recursive_mutex> lock(m_mutex);
+    auto it = m_mapProxy.find(ullMarketId);
+    if (m_mapProxy.end() == it)
+    {
+        return false;
+    }
+    it->second->receiveMarkPrice(llMarkPrice);
+    return true;
+}
+
+bool LoopbackBus::sendCmd(const nlohmann::json& jsonCmd)
+{
+    std::lock_guard<std::recursive_mutex> lock(m_mutex);
+    if (nullptr == m_pCommander)
+    {
+        return false;
+    }
+    m_pCommander->receiveCmd(jsonCmd);
+    return true;
+}
+
+bool LoopbackBus::hasMarket(unsigned long long ullMarketId)
+{
+    std::lock_guard<std::recursive_mutex> lock(m_mutex);
+    return m_mapProxy.end() != m_mapProxy.find(ullMarketId);
+}
+
+bool LoopbackBus::hasCommander()
+{
+    std::lock_guard<std::recursive_mutex> lock(m_mutex);
+    return nullptr != m_pCommander;
+}
+
+void LoopbackBus::addMarket(unsigned long long ullMarketId, LoopbackProxy* pLoopbackProxy)
+{
+    std::lock_guard<std::recursive_mutex> lock(m_mutex);
+    m_mapProxy[ullMarketId] = pLoopbackProxy;
+}
+
+void LoopbackBus::setCommander(LoopbackProxy* pLoopbackProxy)
+{
+    std::lock_guard<std::recursive_mutex> lock(m_mutex);
+    m_pCommander = pLoopbackProxy;
+}
+
+void LoopbackBus::remove(LoopbackProxy* pLoopbackProxy)
+{
+    std::lock_guard<std::recursive_mutex> lock(m_mutex);
+    for (auto it = m_mapProxy.begin(); m_mapProxy.end() != it; )
+    {
+        if (pLoopbackProxy == it->second)
+        {
+            it = m_mapProxy.erase(it);
+        }
+        else
+        {
+            it++;
+        }
+    }
+    if (pLoopbackProxy == m_pCommander)
+    {
+        m_pCommander = nullptr;
+    }
+}
@@ -0,0 +1,128 @@
+#ifndef __LOOPBACK_PROXY_H__
+#define __LOOPBACK_PROXY_H__
+
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "IMessage.h"
+#include "thread_queue.h"
+#include "order.h"
+#include "json.hpp"
+#include "order_router.h"
+
+// In-process transport without pulsar, for simulators, benchmarks and load tests that embed the engine core.
+// loopback_proxy.cpp is linked instead of pulsar_proxy_c.cpp, so createIMessage returns a LoopbackProxy and the manager
+// creates its commander and market proxies as with pulsar. The embedding code reaches them through LoopbackBus.
+class LoopbackProxy: public IMessage{
+private:
+    LoopbackProxy(OPNX::OrderQueue<OPNX::Order>* pOrderQueue,
+                  OPNX::OrderQueue<OPNX::Order>* pTriggerOrderQueue,
+                  OPNX::TriggerPriceQueue* pMarkPriceQueue,
+                  OPNX::OrderQueue<nlohmann::json>* pCmdQueue)
+    : m_orderRouter(pOrderQueue, pTriggerOrderQueue)
+    , m_pOrderQueue(pOrderQueue)
+    , m_pMarkPriceQueue(pMarkPriceQueue)
+    , m_pCmdQueue(pCmdQueue)
+    , m_bIsRecovery(true)
+    , m_bIsCommander(false)
+    , m_ullMarketId(0)
+    , m_strMarketCode(""){};
+    LoopbackProxy(const LoopbackProxy &) = delete;
+    LoopbackProxy(LoopbackProxy &&) = delete;
+    LoopbackProxy &operator=(const LoopbackProxy &) = delete;
+    LoopbackProxy &operator=(LoopbackProxy &&) = delete;
+    ~LoopbackProxy();
+public:
+    static IMessage* createIMessage(OPNX::OrderQueue<OPNX::Order>* pOrderQueue, OPNX::OrderQueue<OPNX::Order>* pTriggerOrderQueue, OPNX::TriggerPriceQueue* pMarkPriceQueue, OPNX::OrderQueue<nlohmann::json>* pCmdQueue);
+    virtual void releaseIMessage();
+
+    // Register the market on the bus
+    // jsonConfig contains the following fields: marketId, marketCode, referencePair, factor
+    virtual void createMarketAll(const nlohmann::json& jsonConfig);
+    virtual void createMarketAllTest(const nlohmann::json& jsonConfig) { createMarketAll(jsonConfig); }
+
+    // Register the commander on the bus
+    virtual void createCommander(const std::string& strReferencePair);
+    virtual void createTestCommander(const std::string& strReferencePair) { createCommander(strReferencePair); }
+
+    virtual void sendOrder(const std::string& strJsonData) { send(ORDER, strJsonData); }
+    virtual void sendOrders(const std::string& strJsonData) { send(ORDERS, strJsonData); }
+    virtual void sendOrderBookSnapshot(const nlohmann::json& jsonData) { send(MARKET_SNAPSHOT, jsonData); }
+    virtual void sendOrderBookDiff(const nlohmann::json& jsonData) { send(MARKET_DIFF, jsonData); }
+    virtual void sendOrderBookBest(const nlohmann::json& jsonData) { send(MARKET_BEST, jsonData); }
+    virtual void sendCmd(const nlohmann::json& jsonData) { send(COMMAND, jsonData); }
+    virtual void sendHeartbeat(const nlohmann::json& jsonData) { send(HEARTBEAT, jsonData); }
+    virtual void sendPulsarLog(const std::string& strLog) { send(CONSUMER_TO_LOG, strLog); }
+    virtual void sendSpreadSnapshot(const std::string& strJsonData) { send(SPREAD_SNAPSHOT, strJsonData); }
+
+    virtual void setRecovery(bool bRecovery) { m_bIsRecovery = bRecovery; }
+    virtual bool getRecovery() { return m_bIsRecovery; }
+    virtual void exitConsumer();
+    virtual void addOrderConsumer(int iCount) {}
+    virtual void setMarketInfo(const nlohmann::json& jsonMarketInfo);
+
+    // called by LoopbackBus on the thread of the embedding code, like the consumers of pulsar
+    void receiveOrder(OPNX::Order& order);
+    void receiveMassQuote(std::vector<OPNX::Order>& vecQuote);
+    void receiveMarkPrice(long long llMarkPrice);
+    void receiveCmd(const nlohmann::json& jsonCmd);
+
+private:
+    void send(ProxyType proxyType, const std::string& strData);
+    void send(ProxyType proxyType, const nlohmann::json& jsonData);
+    void sendReject(const OPNX::Order& order);
+private:
+    OPNX::OrderRouter m_orderRouter;
+    OPNX::OrderQueue<OPNX::Order> * m_pOrderQueue;
+    OPNX::TriggerPriceQueue * m_pMarkPriceQueue;
+    OPNX::OrderQueue<nlohmann::json> * m_pCmdQueue;
+    volatile bool m_bIsRecovery;
+    bool m_bIsCommander;
+    unsigned long long m_ullMarketId;
+    std::string m_strMarketCode;
+};
+
+// Connects the embedding code with the proxies the manager created.
+// The callback gets everything the manager sends: marketId is 0 for the messages of the commander.
+// It is called on the sending threads of the manager, several at the same time.
+class LoopbackBus {
+public:
+    typedef std::function<void(unsigned long long ullMarketId, IMessage::ProxyType proxyType, const std::string& strData)> Callback;
+
+    static LoopbackBus& instance();
+
+    // Set before the manager runs
+    void setCallback(const Callback& callback) { m_callback = callback; }
+    const Callback& getCallback() const { return m_callback; }
+
+    // Like a message of the order topic of order.marketId: a RECOVERY_END ends the recovery of the market.
+    // Returns false if the manager has no such market yet.
+    bool sendOrder(OPNX::Order& order);
+    // The quotes of one mass quote of vecQuote[0].marketId
+    bool sendMassQuote(std::vector<OPNX::Order>& vecQuote);
+    // llMarkPrice is multiplied by the factor of the market already
+    bool sendMarkPrice(unsigned long long ullMarketId, long long llMarkPrice);
+    // Like a message of the command topic, returns false before the manager created its commander
+    bool sendCmd(const nlohmann::json& jsonCmd);
+
+    bool hasMarket(unsigned long long ullMarketId);
+    bool hasCommander();
+
+private:
+    friend class LoopbackProxy;
+    LoopbackBus() : m_pCommander(nullptr){};
+    void addMarket(unsigned long long ullMarketId, LoopbackProxy* pLoopbackProxy);
+    void setCommander(LoopbackProxy* pLoopbackProxy);
+    void remove(LoopbackProxy* pLoopbackProxy);
+
+private:
+    Callback m_callback;
+    std::recursive_mutex m_mutex;      // the callback may send again on its thread
+    std::map<unsigned long long, LoopbackProxy*> m_mapProxy;
+    LoopbackProxy* m_pCommander;
+};
+
+#endif //__LOOPBACK_PROXY_H__
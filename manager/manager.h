@@ -5,7 +5,9 @@
 #ifndef MATCHING_ENGINE_MANAGER_H
 #define MATCHING_ENGINE_MANAGER_H
 
+#include <atomic>
 #include <map>
+#include <memory>
 #include <string>
 #include <mutex>
 
@@ -14,8 +16,12 @@
 #include "thread_queue.h"
 #include "IEngine.h"
 #include "ITriggerOrder.h"
+#include "snapshot.h"
+#include "journal.h"
+#include "latency.h"
 
 class Manager: public OPNX::ICallbackManager{
+    friend class Bench;     // bench/bench.cpp measures the order book diff and snapshot
 
 public:
     Manager(const std::string& strPulsarServiceUrl, const std::string& strReferencePair, nlohmann::json& jsonConfig)
@@ -25,6 +31,7 @@ public:
     , m_bOBThreadRunning(true)
     , m_bRecoveryEnd(false)
     , m_bEnableAuction(false)
+    , m_ullAuctionCallMillis(1000)
     , m_bSendRecovery(false)
     , m_bEngineEnable(false)
     , m_iLogLevel(4)
@@ -39,6 +46,28 @@ public:
     , m_ullSortId(0)
     , m_ullSendSortId(0)
     , m_iSnapshotLogCycle(100)
+    , m_strSnapshotFile("")
+    , m_iSnapshotInterval(60)
+    , m_bTakeSnapshot(false)
+    , m_strJournalFile("")
+    , m_ullJournalSize(1000000)
+    , m_bReplay(false)
+    , m_ullTriggerJournaled(0)
+    , m_ullTriggerRouted(0)
+    , m_bResetJournal(false)
+    , m_ullExpireTime(0)
+    , m_bStandby(false)
+    , m_bStandbySynced(false)
+    , m_bStandbyResync(false)
+    , m_bPromote(false)
+    , m_iJournalLockFd(-1)
+    , m_llMarketsModified(0)
+    , m_strMessageTransport("pulsar")
+    , m_strShmPrefix("/opnx-me-")
+    , m_ullShmRingSize(65536)
+    , m_bAsyncLog(false)
+    , m_strLogFile("")
+    , m_ullAsyncLogRingSize(1 << 20)
     , m_jsonConfig(jsonConfig)
     , m_pCmdPulsarProxy(nullptr)
     , m_pLogPulsar(nullptr){};
@@ -51,19 +80,63 @@ public:
 public:
     // IICallbackManager
     virtual void pulsarOrder(const OPNX::Order& order){
+        if (m_bReplay)
+        {
+            return;
+        }
         OPNX::Order newOrder(order);
+        stampReport(newOrder);
         m_orderOutQueue.push(newOrder);
     }
     virtual void pulsarOrderList(const std::vector<OPNX::Order>& orders){
+        if (m_bReplay)
+        {
+            return;
+        }
         std::vector<OPNX::Order> newOrders(orders);
+        if (!newOrders.empty())
+        {
+            stampReport(newOrders[0]);     // the stages of a list are those of its first order
+            if (OPNX::Order::MASS_QUOTE != newOrders[0].action)    // the report of a mass quote has no transaction
+            {
+                triggerLastPrice(newOrders);
+            }
+        }
         m_ordersOutQueue.push(newOrders);
     }
     virtual void triggerOrderToEngine(const OPNX::Order& order){
+        if (m_bReplay)
+        {
+            return;     // the triggered orders are in the journal
+        }
         OPNX::Order newOrder(order);
+        newOrder.receivedTime = 0;
+        newOrder.queuedTime = OPNX::Utils::getNanoTimestamp();
         m_orderQueue.push(newOrder);
     }
+    virtual void triggerOrderListToEngine(const std::vector<OPNX::Order>& orders){
+        if (m_bReplay || orders.empty())
+        {
+            return;     // the triggered orders are in the journal
+        }
+        std::vector<OPNX::Order> newOrders(orders);
+        unsigned long long ullQueuedTime = OPNX::Utils::getNanoTimestamp();
+        for (auto& newOrder: newOrders)
+        {
+            newOrder.receivedTime = 0;
+            newOrder.queuedTime = ullQueuedTime;
+        }
+        m_triggeredOrderQueue.push(newOrders);
+        m_orderQueue.wake();
+    }
     virtual void engineOrderToTrigger(const OPNX::Order& order){
+        if (m_bReplay)
+        {
+            return;     // the orders of the trigger order managers are in the journal
+        }
         OPNX::Order newOrder(order);
+        newOrder.receivedTime = 0;
+        newOrder.queuedTime = OPNX::Utils::getNanoTimestamp();
         m_triggerOrderQueue.push(newOrder);
     }
     virtual void bestOrderBookChange(){
@@ -91,7 +164,6 @@ public:
         ORDER_IN,
         TRIGGER_ORDER_IN,
         MARK_PRICE,
-        LAST_PRICE,
         ORDER_OUT,
         ORDERS_OUT,
         ORDER_BOOK,
@@ -100,18 +172,30 @@ public:
         TEST,
         PULSAR_LOG,
         SNAPSHOT,
+        ENGINE_SNAPSHOT,
+        STANDBY,
     };
 private:
     static void handleThread(Manager* pManager, ThreadType threadType);
     void handleOrder();
+    void routeOrder(OPNX::Order& order);
+    void routeMassQuote(std::vector<OPNX::Order>& vecQuote);
+    void routeOrderList(std::vector<OPNX::Order>& vecOrder);
+    void triggerLastPrice(const std::vector<OPNX::Order>& orders);
+    void expireOrders();
+    void replayOrder(OPNX::Order& order);
+    void handleStandby();
+    void handleJournalLock();
     void handleTriggerOrder();
+    void routeTriggerOrder(OPNX::Order& order);
     void handleMarkPrice();
-    void handleLastPrice();
     void handleOrderOut();
     void handleOrdersOut();
     void handleOrderBook();
     void handleBestOrderBook();
     void handleSpreadSnapshot();
+    void addSpreadLevels(nlohmann::json& jsonLevels, const std::vector<OPNX::SpreadLevelItem>& vecLevel, unsigned long long ullFactor);
+    void handleEngineSnapshot();
     void handleCmd(IMessage* pCmdIMessage, nlohmann::json jsonCmd);
 
     void testHandle();
@@ -122,9 +206,28 @@ private:
     void deleteMarketsInfo(nlohmann::json jsonMarkets);
     void impliedEngine();
     void clearOrder();
+    void takeSnapshot();
+    bool loadSnapshot(unsigned long long& ullJournalSequence);
+    bool replayJournal(unsigned long long& ullJournalSequence, bool& bRestored);
+    bool restore();
+    void resetJournal();
+    bool lockJournal();
+    bool syncStandby(unsigned long long& ullJournalSequence);
+    bool verifyStandby(unsigned long long ullStateHash);
+    void saveMarkets();
+    void loadMarkets();
+    IMessage* createCommander(bool enablePulsarLog);
+    void promote();
+    void addMarketMessage(const nlohmann::json& jsonMarket, unsigned long long ullMarketId, bool bIsRecovery);
 
     inline bool checkOrder(OPNX::Order& order);
 
+    // Latency stages of the markets, the histograms are kept when a market is deleted because the threads may still record
+    OPNX::MarketLatency* getLatency(unsigned long long ullMarketId);
+    void recordInbound(const OPNX::Order& order, unsigned long long ullBegin);
+    void stampReport(OPNX::Order& order);
+    nlohmann::json getLatencyJson();
+
     void sendOrderBookSnapshot(unsigned long long ullMarketId, const std::string& strMarketCode, unsigned long long ullFactor, unsigned long long ullQtyFactor, AskOrderBook& askOrderBook, BidOrderBook& bidOrderBook, unsigned long long ullSequenceNumber);
     bool sendOrderBookDiff(unsigned long long ullMarketId, const std::string& strMarketCode, unsigned long long ullFactor, unsigned long long ullQtyFactor, const AskOrderBook& askOrderBook, const BidOrderBook& bidOrderBook, unsigned long long ullSequenceNumber);
     void sendOrderBookBest();
@@ -138,6 +241,7 @@ private:
     volatile bool m_bOBThreadRunning;
     volatile bool m_bRecoveryEnd;
     bool m_bEnableAuction;   // default disable
+    unsigned long long m_ullAuctionCallMillis;   // the call phase of the AUCTION orders of a market, from its first order to its uncross
     bool m_bSendRecovery;
     int m_iLogLevel;
     int m_iOrderBookCycle;  // Order book cycle in milliseconds
@@ -152,16 +256,18 @@ private:
     std::map<unsigned long long, OPNX::IEngine*> m_mapEngine;
     std::map<unsigned long long, OPNX::ITriggerOrder*> m_mapITriggerOrderManager;
     std::multimap<std::string, OPNX::IEngine*> m_multimapTypeEngine;
+    std::map<unsigned long long, OPNX::MarketLatency*> m_mapLatency;
     OPNX::OrderQueue<OPNX::Order> m_orderQueue;
+    OPNX::OrderQueue<std::vector<OPNX::Order>> m_triggeredOrderQueue;   // the orders triggered by one price, ORDER_IN handles them before m_orderQueue
     OPNX::OrderQueue<OPNX::Order> m_triggerOrderQueue;
-    OPNX::OrderQueue<OPNX::TriggerPrice> m_markPriceQueue;
+    OPNX::TriggerPriceQueue m_markPriceQueue;     // the latest mark price of each market, coalesced
     OPNX::OrderQueue<nlohmann::json>  m_cmdQueue;
     OPNX::OrderQueue<bool>  m_bestChangeQueue;
     OPNX::OrderQueue<std::string>  m_pulsarLogQueue;
 
     OPNX::OrderQueue<OPNX::Order> m_orderOutQueue;
     OPNX::OrderQueue<std::vector<OPNX::Order>> m_ordersOutQueue;
-    OPNX::OrderQueue<std::unordered_map<unsigned long long, long long >> m_lastPriceQueue;   // key is marketId, value is lastMatchPrice
+    std::vector<std::pair<unsigned long long, long long>> m_vecLastPrice;   // marketId, lastMatchPrice of a transaction, ORDER_IN thread
 
     std::unordered_map<unsigned long long, AskOrderBook>  m_unmapAskOrderBook;
     std::unordered_map<unsigned long long, BidOrderBook>  m_unmapBidOrderBook;
@@ -174,6 +280,34 @@ private:
     std::atomic<unsigned long long> m_ullSortId;
     volatile unsigned long long m_ullSendSortId;
     int m_iSnapshotLogCycle;
+    std::string m_strSnapshotFile;    // engine snapshot, disabled if empty
+    int m_iSnapshotInterval;          // seconds between two engine snapshots
+    volatile bool m_bTakeSnapshot;    // set by the timer, the snapshot is taken on the ORDER_IN thread
+    OPNX::OrderQueue<std::shared_ptr<std::pair<OPNX::SnapshotHeader, std::vector<OPNX::MarketSnapshot>>>> m_engineSnapshotQueue;   // the copy is not copied again
+    std::string m_strJournalFile;     // prefix of the journal files, disabled if empty
+    unsigned long long m_ullJournalSize;   // records of a journal file
+    OPNX::Journal m_journal;          // appended by the ORDER_IN and TRIGGER_ORDER_IN threads under m_mutexJournal
+    std::mutex m_mutexJournal;        // also held by the trigger order changes a snapshot must see together with their records
+    volatile bool m_bReplay;          // the reports of a journal replay are not sent
+    unsigned long long m_ullTriggerJournaled;    // TRIGGER_ORDER_IN orders appended, under m_mutexJournal
+    std::atomic<unsigned long long> m_ullTriggerRouted;   // TRIGGER_ORDER_IN orders routed, a snapshot waits for the ones appended
+    volatile bool m_bResetJournal;    // set by clearOrder, handled on the ORDER_IN thread
+    unsigned long long m_ullExpireTime;    // milli second of the last expireOrders, ORDER_IN thread
+    std::vector<OPNX::Order> m_vecExpiredOrder;    // cancels of the expired GTT orders, ORDER_IN thread
+    // A process that can't lock the journal is a standby: it applies the journal of the primary and has no pulsar connection.
+    // It is promoted when the lock of the primary is released.
+    volatile bool m_bStandby;
+    volatile bool m_bStandbySynced;   // the engines of the standby follow the journal
+    volatile bool m_bStandbyResync;   // the markets were changed, load the snapshot again
+    volatile bool m_bPromote;         // the lock is taken, the standby reads the rest of the journal
+    int m_iJournalLockFd;
+    long long m_llMarketsModified;    // modification time of the markets file read by the standby
+    std::string m_strMessageTransport;     // pulsar, or shm: the markets also have the shared memory rings of a co-located gateway
+    std::string m_strShmPrefix;       // name prefix of the shared memory rings
+    unsigned long long m_ullShmRingSize;   // orders of the inbound ring of a market
+    bool m_bAsyncLog;                 // the log records are written by the backend thread of OPNX::AsyncLog
+    std::string m_strLogFile;         // file of the async log, empty: std::clog
+    unsigned long long m_ullAsyncLogRingSize;   // bytes of the log ring of a thread
     IMessage* m_pCmdPulsarProxy;
     IMessage* m_pLogPulsar;
 };
@@ -7,6 +7,7 @@
 #include "pulsar_proxy_c.h"
 #include "log.h"
 #include "utils.h"
+#include "thread_placement.h"
 #include "rapidjson/document.h"
 
 const std::string PULSAR_TOPIC_ORDER_IN = "persistent://OPNX-V1/PRETRADE-ME/ORDER-IN-";
@@ -19,18 +20,19 @@ const std::string PULSAR_TOPIC_CMD_OUT = "persistent://OPNX-V1/ME-POSTTRADE/CMD-
 const std::string PULSAR_TOPIC_MARK_PRICE = "non-persistent://OPNX-V1/PRICE-SERVER/MARK-PRICE";
 const std::string PULSAR_TOPIC_HEARTBEAT = "non-persistent://OPNX-V1/ME-POSTTRADE/HEARTBEAT";
 const std::string PULSAR_TOPIC_LOG = "non-persistent://OPNX-V1/DATA-COLLECTOR/ME-LOG";
+const std::string PULSAR_TOPIC_SPREAD_SNAPSHOT = "persistent://OPNX-V1/ME-WS/SNAPSHOTS";
 
 
 IMessage* createIMessage(OPNX::OrderQueue<OPNX::Order>* pOrderQueue,
                          OPNX::OrderQueue<OPNX::Order>* pTriggerOrderQueue,
-                         OPNX::OrderQueue<OPNX::TriggerPrice>* pMarkPriceQueue,
+                         OPNX::TriggerPriceQueue* pMarkPriceQueue,
                          OPNX::OrderQueue<nlohmann::json>* pCmdQueue,
                          const std::string& strServiceUrl){
     return PulsarProxy::createIMessage(pOrderQueue, pTriggerOrderQueue, pMarkPriceQueue, pCmdQueue, strServiceUrl);
 };
 IMessage* PulsarProxy::createIMessage(OPNX::OrderQueue<OPNX::Order>* pOrderQueue,
                                       OPNX::OrderQueue<OPNX::Order>* pTriggerOrderQueue,
-                                      OPNX::OrderQueue<OPNX::TriggerPrice>* pMarkPriceQueue,
+                                      OPNX::TriggerPriceQueue* pMarkPriceQueue,
                                       OPNX::OrderQueue<nlohmann::json>* pCmdQueue,
                                       const std::string& strServiceUrl){
     return static_cast<IMessage*>(new PulsarProxy(pOrderQueue, pTriggerOrderQueue, pMarkPriceQueue, pCmdQueue, strServiceUrl));
@@ -83,6 +85,7 @@ void PulsarProxy::consumerOrderThread(PulsarProxy* pulsarProxy, const std::strin
 {
     if (pulsarProxy)
     {
+        OPNX::ThreadPlacement::instance().apply("ORDER_CONSUMER");
         pulsarProxy->consumerOrder(strTopic, strConsumerName);
     }
 }
@@ -149,6 +152,7 @@ void PulsarProxy::consumerOrder(const std::string& strTopic, const std::string&
             try {
                 if (pulsar_result_Ok == res)
                 {
+                    unsigned long long ullReceivedTime = OPNX::Utils::getNanoTimestamp();
                     strJsonOrder = (char*)pulsar_message_get_data(pulsarMessage);
                     uint32_t length = pulsar_message_get_length(pulsarMessage);
                     strJsonOrder = strJsonOrder.substr(0, length);
@@ -157,7 +161,7 @@ void PulsarProxy::consumerOrder(const std::string& strTopic, const std::string&
                         unsigned long long receivedTimestamp = OPNX::Utils::getMilliTimestamp();
                         uint64_t publish_timestamp = pulsar_message_get_publish_timestamp(pulsarMessage);
                         long timeInterval = receivedTimestamp - publish_timestamp;
-                        cfLog.info() << "ME in <-- " << m_strMarketCode << " publish_timestamp: " << publish_timestamp << " interval: " << timeInterval
+                        OPNX_LOG_INFO << "ME in <-- " << m_strMarketCode << " publish_timestamp: " << publish_timestamp << " interval: " << timeInterval
                                      << " thread_id: " << std::this_thread::get_id()
                                      << " pulsar receive order: " << strJsonOrder << std::endl;
                     }
@@ -166,6 +170,7 @@ void PulsarProxy::consumerOrder(const std::string& strTopic, const std::string&
                     {
                         if (std::string::npos != strJsonOrder.find("RECOVERY_END"))
                         {
+                            pushRecoveryEnd();
                             m_bIsRecovery = false;
                             if (nullptr != pulsarMessage)
                             {
@@ -206,25 +211,15 @@ void PulsarProxy::consumerOrder(const std::string& strTopic, const std::string&
                     document.Parse(strJsonOrder.c_str());
                     OPNX::Order order;
                     OPNX::Order::rapidjsonToOrder(document, order);
+                    order.receivedTime = ullReceivedTime;
 
-                    if (checkOrder(order))
+                    if (OPNX::Order::MASS_QUOTE == order.action)
                     {
-                        if ((!order.isTriggered && (OPNX::Order::STOP_LIMIT == order.type || OPNX::Order::STOP_MARKET == order.type
-                             || OPNX::Order::TAKE_PROFIT_LIMIT == order.type || OPNX::Order::TAKE_PROFIT_MARKET == order.type))
-                             || (OPNX::Order::CANCEL == order.action && 0 == order.orderId))
-                        {
-                            if (m_pTriggerOrderQueue)
-                            {
-                                m_pTriggerOrderQueue->push(order);
-                            }
-                        }
-                        else
-                        {
-                            if (m_pOrderQueue)
-                            {
-                                m_pOrderQueue->push(order);
-                            }
-                        }
+                        pushMassQuote(document, order);
+                    }
+                    else
+                    {
+                        pushOrder(order);
                     }
 
                 } else if (pulsar_result_Timeout == res) {
@@ -296,7 +291,7 @@ void PulsarProxy::consumerMarkPrice(const std::string& strTopic, const std::stri
                     long long price = OPNX::Utils::double2int(dMarkPrice * m_factor);
                     if (m_pMarkPriceQueue && price != llMarkPrice && !m_bIsRecovery)
                     {
-                        cfLog.debug() << "ME in <-- pulsar receive markPrice: " << strJsonOrder << std::endl;
+                        OPNX_LOG_DEBUG << "ME in <-- pulsar receive markPrice: " << strJsonOrder << std::endl;
                         OPNX::TriggerPrice markPrice;
                         markPrice.price = price;
                         markPrice.marketId = marketId;
@@ -496,6 +491,7 @@ void PulsarProxy::consumerListenerOrder(const std::string& strTopic, const std::
             try {
                 if (nullptr != pPulsarProxy)
                 {
+                    unsigned long long ullReceivedTime = OPNX::Utils::getNanoTimestamp();
                     strJsonOrder = (char*)pulsar_message_get_data(pulsarMessage);
                     uint32_t length = pulsar_message_get_length(pulsarMessage);
                     strJsonOrder = strJsonOrder.substr(0, length);
@@ -504,7 +500,7 @@ void PulsarProxy::consumerListenerOrder(const std::string& strTopic, const std::
                         unsigned long long receivedTimestamp = OPNX::Utils::getMilliTimestamp();
                         uint64_t publish_timestamp = pulsar_message_get_publish_timestamp(pulsarMessage);
                         long timeInterval = receivedTimestamp - publish_timestamp;
-                        cfLog.info() << "ME in <-- " << pPulsarProxy->m_strMarketCode << " publish_timestamp: " << publish_timestamp << " interval: " << timeInterval
+                        OPNX_LOG_INFO << "ME in <-- " << pPulsarProxy->m_strMarketCode << " publish_timestamp: " << publish_timestamp << " interval: " << timeInterval
                                      << " thread_id: " << std::this_thread::get_id()
                                      << " pulsar receive order: " << strJsonOrder << std::endl;
                     }
@@ -513,6 +509,7 @@ void PulsarProxy::consumerListenerOrder(const std::string& strTopic, const std::
                     {
                         if (std::string::npos != strJsonOrder.find("RECOVERY_END"))
                         {
+                            pPulsarProxy->pushRecoveryEnd();
                             pPulsarProxy->m_bIsRecovery = false;
                             if (nullptr != pulsarMessage)
                             {
@@ -553,25 +550,15 @@ void PulsarProxy::consumerListenerOrder(const std::string& strTopic, const std::
                     document.Parse(strJsonOrder.c_str());
                     OPNX::Order order;
                     OPNX::Order::rapidjsonToOrder(document, order);
+                    order.receivedTime = ullReceivedTime;
 
-                    if (pPulsarProxy->checkOrder(order))
+                    if (OPNX::Order::MASS_QUOTE == order.action)
                     {
-                        if ((!order.isTriggered && (OPNX::Order::STOP_LIMIT == order.type || OPNX::Order::STOP_MARKET == order.type
-                                                    || OPNX::Order::TAKE_PROFIT_LIMIT == order.type || OPNX::Order::TAKE_PROFIT_MARKET == order.type))
-                            || (OPNX::Order::CANCEL == order.action && 0 == order.orderId))
-                        {
-                            if (pPulsarProxy->m_pTriggerOrderQueue)
-                            {
-                                pPulsarProxy->m_pTriggerOrderQueue->push(order);
-                            }
-                        }
-                        else
-                        {
-                            if (pPulsarProxy->m_pOrderQueue)
-                            {
-                                pPulsarProxy->m_pOrderQueue->push(order);
-                            }
-                        }
+                        pPulsarProxy->pushMassQuote(document, order);
+                    }
+                    else
+                    {
+                        pPulsarProxy->pushOrder(order);
                     }
 
                 } else {
@@ -636,7 +623,7 @@ void PulsarProxy::consumerListenerMarkPrice(const std::string& strTopic, const s
                     long long price = OPNX::Utils::double2int(dMarkPrice * pPulsarProxy->m_factor);
                     if (pPulsarProxy->m_pMarkPriceQueue && price != pPulsarProxy->m_llMarkPrice && !pPulsarProxy->m_bIsRecovery)
                     {
-                        cfLog.debug() << "ME in <-- pulsar receive markPrice: " << strJsonOrder << std::endl;
+                        OPNX_LOG_DEBUG << "ME in <-- pulsar receive markPrice: " << strJsonOrder << std::endl;
                         OPNX::TriggerPrice markPrice;
                         markPrice.price = price;
                         markPrice.marketId = marketId;
@@ -937,7 +924,7 @@ void PulsarProxy::sendOrder(const std::string& strJsonData)
     m_spinMutexSendOrder.lock();
     if (nullptr != m_pOrderProducer)
     {
-        cfLog.info() << "ME out --> thread_id: " << std::this_thread::get_id() <<", order: " << strJsonData << std::endl;
+        OPNX_LOG_INFO << "ME out --> thread_id: " << std::this_thread::get_id() <<", order: " << strJsonData << std::endl;
         sendMsg(m_pOrderProducer, strJsonData);
     } else {
         cfLog.error() << "PulsarProxy::sendOrder ProxyType not exting";
@@ -949,7 +936,7 @@ void PulsarProxy::sendOrders(const std::string& strJsonData)
     m_spinMutexSendOrders.lock();
     if (nullptr != m_pOrdersProducer)
     {
-        cfLog.info() << "ME out --> thread_id: " << std::this_thread::get_id() << ", orders: " << strJsonData << std::endl;
+        OPNX_LOG_INFO << "ME out --> thread_id: " << std::this_thread::get_id() << ", orders: " << strJsonData << std::endl;
         sendMsg(m_pOrdersProducer, strJsonData);
     } else {
         cfLog.error() << "PulsarProxy::sendOrder ProxyType not exting";
@@ -961,7 +948,7 @@ void PulsarProxy::sendOrderBookSnapshot(const nlohmann::json& jsonData)
     if (!m_bIsRecovery && nullptr != m_pBookSnapshotProducer)
     {
         std::string strJsonData = jsonData.dump();
-        cfLog.trace() << "MD Snapshot out --> : " << strJsonData << std::endl;
+        OPNX_LOG_TRACE << "MD Snapshot out --> : " << strJsonData << std::endl;
         sendMsg(m_pBookSnapshotProducer, strJsonData);
     } else {
         cfLog.error() << "PulsarProxy::sendOrderBookSnapshot ProxyType not exting";
@@ -972,7 +959,7 @@ void PulsarProxy::sendOrderBookDiff(const nlohmann::json& jsonData)
     if (!m_bIsRecovery && nullptr != m_pBookDiffProducer)
     {
         std::string strJsonData = jsonData.dump();
-        cfLog.trace() << "MD Diff out --> " << strJsonData << std::endl;
+        OPNX_LOG_TRACE << "MD Diff out --> " << strJsonData << std::endl;
         sendMsg(m_pBookDiffProducer, strJsonData);
     } else {
         cfLog.error() << "PulsarProxy::sendOrderBookDiff ProxyType not exting";
@@ -983,7 +970,7 @@ void PulsarProxy::sendOrderBookBest(const nlohmann::json& jsonData)
     if (!m_bIsRecovery && nullptr != m_pBookBestProducer)
     {
         std::string strJsonData = jsonData.dump();
-        cfLog.info() << "MD Best out --> " << strJsonData << std::endl;
+        OPNX_LOG_INFO << "MD Best out --> " << strJsonData << std::endl;
         sendMsg(m_pBookBestProducer, strJsonData);
     } else {
         cfLog.error() << "PulsarProxy::sendOrderBookBest ProxyType not exting";
@@ -1011,7 +998,7 @@ void PulsarProxy::sendHeartbeat(const nlohmann::json& jsonData)
         std::string strJsonData = jsonData.dump();
         std::string strAction = "";
         OPNX::Utils::getJsonValue<std::string>(strAction, jsonData, "action");
-        cfLog.trace() << "ME out --> heartbeat: " << strJsonData << std::endl;
+        OPNX_LOG_TRACE << "ME out --> heartbeat: " << strJsonData << std::endl;
         sendMsg(m_pHeartbeatProducer, strJsonData, "action", strAction);
     } else {
         cfLog.error() << "PulsarProxy::sendHeartbeat m_pHeartbeatProducer is nullptr";
@@ -1022,13 +1009,28 @@ void PulsarProxy::sendPulsarLog(const std::string& strLog)
 {
     if (nullptr != m_pLogProducer)
     {
-        cfLog.trace() << "ME out --> CallBackPulsarLog: " << strLog << std::endl;
+        OPNX_LOG_TRACE << "ME out --> CallBackPulsarLog: " << strLog << std::endl;
         sendMsg(m_pLogProducer, strLog, "market", m_strReferencePair);
     } else {
         cfLog.error() << "PulsarProxy::sendPulsarLog m_pLogProducer is nullptr";
     }
 }
 
+// The producer is created by the first snapshot
+void PulsarProxy::sendSpreadSnapshot(const std::string& strJsonData)
+{
+    if (nullptr == m_pSpreadSnapshotProducer)
+    {
+        m_pSpreadSnapshotProducer = createProducer(SPREAD_SNAPSHOT, PULSAR_TOPIC_SPREAD_SNAPSHOT, "ME-WS-SNAPSHOT-" + m_strReferencePair);
+    }
+    if (nullptr != m_pSpreadSnapshotProducer)
+    {
+        sendMsg(m_pSpreadSnapshotProducer, strJsonData);
+    } else {
+        cfLog.error() << "PulsarProxy::sendSpreadSnapshot m_pSpreadSnapshotProducer is nullptr";
+    }
+}
+
 void PulsarProxy::sendMsg(pulsar_producer_t *producer, const std::string& strJsonData, const std::string& strPropertyName, const std::string& strPropertyValue)
 {
     pulsar_message_t *pulsarMessage = pulsar_message_create();
@@ -1085,74 +1087,72 @@ void PulsarProxy::setMarketInfo(const nlohmann::json& jsonMarketInfo)
     OPNX::Utils::getJsonValue<unsigned long long>(m_factor, jsonMarketInfo, "factor");
 }
 
-inline bool PulsarProxy::checkOrder(OPNX::Order& order)
+// The orders that wait for a trigger and cancel all go to the trigger order queue, the others to the order queue
+void PulsarProxy::pushOrder(OPNX::Order& order)
 {
-    bool checkResult = false;
-    while (!checkResult)
+    if (!m_orderRouter.pushOrder(order))
     {
-        if (OPNX::Order::AUCTION == order.timeCondition || OPNX::Order::CANCEL == order.action)  // don't check AUCTION order and CANCEL order
-        {
-            checkResult = true;
-            break;
-        }
-        if (0 == order.quantity && 0 == order.amount
-            && (OPNX::Order::NEW == order.action || OPNX::Order::AMEND == order.action || OPNX::Order::RECOVERY == order.action))
-        {
-            order.status = OPNX::Order::REJECT_QUANTITY_AND_AMOUNT_ZERO;
-            break;
-        }
-        if (0 < order.quantity && 0 < order.amount)
-        {
-            order.status = OPNX::Order::REJECT_QUANTITY_AND_AMOUNT_LARGER_ZERO;
-            break;
-        }
-        if (OPNX::Order::STOP_LIMIT == order.type || OPNX::Order::STOP_MARKET == order.type)
+        sendReject(order);
+    }
+}
+
+void PulsarProxy::sendReject(const OPNX::Order& order)
+{
+    std::stringstream ssOrder;
+    std::string strJsonOrder = "";
+    OPNX::Order::orderToJsonString(order, strJsonOrder);
+    ssOrder << "{\"pt\":\"Order\",\"ol\":[" << strJsonOrder << "]}";
+    sendOrder(ssOrder.str());
+}
+
+// The engine collects the RECOVERY orders and loads them into its order book at RECOVERY_END
+void PulsarProxy::pushRecoveryEnd()
+{
+    if (m_pOrderQueue)
+    {
+        OPNX::Order order;
+        order.action = OPNX::Order::RECOVERY_END;
+        order.marketId = strtoll(m_strMarketId.c_str(), nullptr, 10);
+        m_pOrderQueue->push(order);
+    }
+}
+
+// The quotes of a mass quote are in "ql", each quote is an order object, the other fields come from the mass quote.
+// All quotes are pushed together, so the engine handles them in one call, the rejected ones are reported one by one.
+void PulsarProxy::pushMassQuote(const rapidjson::Document& document, const OPNX::Order& massQuote)
+{
+    std::vector<OPNX::Order> vecQuote;
+    auto it = document.FindMember(OPNX::key_quoteList);
+    if (document.MemberEnd() != it && it->value.IsArray())
+    {
+        for (auto& jsonQuote: it->value.GetArray())
         {
-            if (OPNX::Order::NONE == order.stopCondition)
+            OPNX::Order quote(massQuote);
+            OPNX::Order::rapidjsonToOrder(jsonQuote, quote);
+            quote.accountId = massQuote.accountId;
+            quote.marketId = massQuote.marketId;
+            quote.type = OPNX::Order::LIMIT;
+            quote.remainQuantity = quote.quantity;
+            if (0 == quote.displayQuantity)
             {
-                order.status = OPNX::Order::REJECT_STOP_CONDITION_IS_NONE;
-                break;
+                quote.displayQuantity = quote.quantity;
             }
-            if (OPNX::Order::MAX_PRICE == order.triggerPrice)
-            {
-                order.status = OPNX::Order::REJECT_STOP_TRIGGER_PRICE_IS_NONE;
-                break;
-            }
-        }
-        if (0 < order.quantity && order.quantity < order.displayQuantity)
-        {
-            order.status = OPNX::Order::REJECT_DISPLAY_QUANTITY_LARGER_THAN_QUANTITY;
-            break;
-        }
-
-        if (0 >= order.displayQuantity && 0 == order.amount)
-        {
-            order.status = OPNX::Order::REJECT_DISPLAY_QUANTITY_ZERO;
-            break;
+            quote.action = OPNX::Order::MASS_QUOTE;
+            vecQuote.push_back(quote);
         }
-        if (OPNX::Order::LIMIT == order.type && OPNX::Order::MAX_PRICE == order.price)
-        {
-            order.status = OPNX::Order::REJECT_LIMIT_ORDER_WITH_MARKET_PRICE;
-            break;
-        }
-        checkResult = true;
     }
-    if (!checkResult)
+    if (vecQuote.empty())
     {
-//        nlohmann::json jsonOrder;
-//        OPNX::Order::orderToJson(order, jsonOrder);
-//        nlohmann::json jsonGroupOrder;
-//        jsonGroupOrder[OPNX::Order::key_payloadType] = "Order";
-//        jsonGroupOrder[OPNX::Order::key_orderList] = nlohmann::json::array();
-//        jsonGroupOrder[OPNX::Order::key_orderList].push_back(jsonOrder);
-//        sendOrder(jsonGroupOrder);
-        std::stringstream ssOrder;
-        std::string strJsonOrder = "";
-        OPNX::Order::orderToJsonString(order, strJsonOrder);
-        ssOrder << "{\"pt\":\"Order\",\"ol\":[" << strJsonOrder << "]}";
-        sendOrder(ssOrder.str());
+        // no quote: cancel all quotes of the account
+        OPNX::Order quote(massQuote);
+        quote.quantity = 0;
+        quote.remainQuantity = 0;
+        vecQuote.push_back(quote);
+    }
+    std::vector<OPNX::Order> vecReject;
+    m_orderRouter.pushMassQuote(vecQuote, vecReject);
+    for (auto& quote: vecReject)
+    {
+        sendReject(quote);
     }
-    return checkResult;
 }
-
-
@@ -15,6 +15,7 @@
 #include "thread_queue.h"
 #include "pulsar/c/client.h"
 #include "order.h"
+#include "order_router.h"
 #include "json.hpp"
 #include "spin_mutex.hpp"
 
@@ -23,11 +24,12 @@ class PulsarProxy: public IMessage{
 private:
     PulsarProxy(OPNX::OrderQueue<OPNX::Order>* pOrderQueue,
                 OPNX::OrderQueue<OPNX::Order>* pTriggerOrderQueue,
-                OPNX::OrderQueue<OPNX::TriggerPrice>* pMarkPriceQueue,
+                OPNX::TriggerPriceQueue* pMarkPriceQueue,
                 OPNX::OrderQueue<nlohmann::json>* pCmdQueue,
                 const std::string& strServiceUrl)
     : m_pOrderQueue(pOrderQueue)
     , m_pTriggerOrderQueue(pTriggerOrderQueue)
+    , m_orderRouter(pOrderQueue, pTriggerOrderQueue)
     , m_pMarkPriceQueue(pMarkPriceQueue)
     , m_pCmdQueue(pCmdQueue)
     , m_strServiceUrl(strServiceUrl)
@@ -42,6 +44,7 @@ private:
     , m_pCmdProducer(nullptr)
     , m_pHeartbeatProducer(nullptr)
     , m_pLogProducer(nullptr)
+    , m_pSpreadSnapshotProducer(nullptr)
     , m_bRunning(true)
     , m_bIsRecovery(true)
     , m_factor(100000000)
@@ -56,7 +59,7 @@ private:
     PulsarProxy &operator=(PulsarProxy &&) = delete;
     ~PulsarProxy();
 public:
-    static IMessage* createIMessage(OPNX::OrderQueue<OPNX::Order>* pOrderQueue, OPNX::OrderQueue<OPNX::Order>* pTriggerOrderQueue, OPNX::OrderQueue<OPNX::TriggerPrice>* pMarkPriceQueue, OPNX::OrderQueue<nlohmann::json>* pCmdQueue, const std::string& strServiceUrl);
+    static IMessage* createIMessage(OPNX::OrderQueue<OPNX::Order>* pOrderQueue, OPNX::OrderQueue<OPNX::Order>* pTriggerOrderQueue, OPNX::TriggerPriceQueue* pMarkPriceQueue, OPNX::OrderQueue<nlohmann::json>* pCmdQueue, const std::string& strServiceUrl);
     virtual void releaseIMessage();
 
     // Create all consumers and producers in the specified market
@@ -81,6 +84,7 @@ public:
     virtual void sendCmd(const nlohmann::json& jsonData);
     virtual void sendHeartbeat(const nlohmann::json& jsonData);
     virtual void sendPulsarLog(const std::string& strLog);
+    virtual void sendSpreadSnapshot(const std::string& strJsonData);
 
     virtual void setRecovery(bool bRecovery) { m_bIsRecovery = bRecovery; }
     virtual bool getRecovery() { return m_bIsRecovery; }
@@ -111,11 +115,15 @@ private:
     // only print msg of consume
     void consumerListenerToLog(const std::string& strTopic, const std::string& strConsumerName);
 
-    inline bool checkOrder(OPNX::Order& order);
+    void pushOrder(OPNX::Order& order);
+    void pushMassQuote(const rapidjson::Document& document, const OPNX::Order& massQuote);
+    void pushRecoveryEnd();
+    void sendReject(const OPNX::Order& order);
 private:
     OPNX::OrderQueue<OPNX::Order> * m_pOrderQueue;
     OPNX::OrderQueue<OPNX::Order> * m_pTriggerOrderQueue;
-    OPNX::OrderQueue<OPNX::TriggerPrice> * m_pMarkPriceQueue;
+    OPNX::OrderRouter m_orderRouter;    // the checks and queues of the orders, as for the other transports
+    OPNX::TriggerPriceQueue * m_pMarkPriceQueue;
     OPNX::OrderQueue<nlohmann::json> * m_pCmdQueue;
     std::map<ProxyType, pulsar_client_t*> m_mapProducerClient;
     std::map<ProxyType, pulsar_producer_t*> m_mapProducer;
@@ -133,6 +141,7 @@ private:
     pulsar_producer_t* m_pCmdProducer;
     pulsar_producer_t* m_pHeartbeatProducer;
     pulsar_producer_t* m_pLogProducer;
+    pulsar_producer_t* m_pSpreadSnapshotProducer;
     volatile bool m_bRunning;
     volatile bool m_bIsRecovery;
     unsigned long long m_factor;
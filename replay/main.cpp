@@ -0,0 +1,87 @@
+#include <string>
+#include <cstdlib>
+
+#include "replay.h"
+#include "log.h"
+#include "utils.h"
+#include "global.h"
+
+
+// init global variables of global.h
+unsigned long long g_ullPerpMarketId = 0;
+long long g_llPerpMarkPrice = 0;
+unsigned long long g_ullRepoMarketId = 0;
+
+// init global variables of utils.h, fixed values so that two runs give the same ids
+std::atomic<unsigned long long> g_ullSortId(10000);
+std::atomic<unsigned long long> g_ullMatchId(10000);
+std::atomic<unsigned long long> g_ullSequenceNumber(10000);
+unsigned long long g_ullNodeId = 0;
+std::atomic<unsigned long long> g_ullVirtualMilliTimestamp(0);
+
+CallBackPulsarLog pulsarLog = [](const std::string& strLog) {};
+OPNX::Log cfLog(OPNX::Log::ERROR, pulsarLog);
+
+static void usage(const char* pszName)
+{
+    // one std::endl, the log prints its buffer on each flush
+    cfLog.printInfo() << "usage: " << pszName << " markets.json input [--journal] [--speed x] [--out reports.jsonl] [--log level]\n"
+                      << "  input      json lines of the order and mark price topics, or the journal prefix with --journal\n"
+                      << "  --speed x  replay with the original pacing divided by x, the default is max speed\n"
+                      << "  --out      write the reports as json lines" << std::endl;
+}
+
+int main(int iArgc, char** pszArgv) {
+
+    if (3 > iArgc)
+    {
+        usage(pszArgv[0]);
+        return 1;
+    }
+    std::string strMarketsFile = pszArgv[1];
+    std::string strInput = pszArgv[2];
+    std::string strOutputFile = "";
+    bool bJournal = false;
+    double dSpeed = 0;
+    for (int i = 3; i < iArgc; i++)
+    {
+        std::string strArg = pszArgv[i];
+        if ("--journal" == strArg)
+        {
+            bJournal = true;
+        }
+        else if ("--speed" == strArg && i + 1 < iArgc)
+        {
+            dSpeed = atof(pszArgv[++i]);
+        }
+        else if ("--out" == strArg && i + 1 < iArgc)
+        {
+            strOutputFile = pszArgv[++i];
+        }
+        else if ("--log" == strArg && i + 1 < iArgc)
+        {
+            cfLog.setLogLevel((OPNX::Log::Level)atoi(pszArgv[++i]));
+        }
+        else
+        {
+            usage(pszArgv[0]);
+            return 1;
+        }
+    }
+
+    Replay replay;
+    if (!replay.addMarkets(strMarketsFile))
+    {
+        return 1;
+    }
+    if (!strOutputFile.empty())
+    {
+        replay.setOutputFile(strOutputFile);
+    }
+    if (!replay.run(strInput, bJournal, dSpeed))
+    {
+        return 1;
+    }
+    replay.report();
+    return 0;
+}
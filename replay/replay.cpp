@@ -0,0 +1,478 @@
+#include <algorithm>
+#include <cstdio>
+#include <unistd.h>
+
+#include "replay.h"
+#include "log.h"
+#include "utils.h"
+#include "global.h"
+#include "journal.h"
+
+Replay::~Replay()
+{
+    for (auto it : m_mapITriggerOrderManager)
+    {
+        it.second->releaseITriggerOrder();
+    }
+    for (auto it : m_mapEngine)
+    {
+        it.second->releaseIEngine();
+    }
+    if (m_ofstOutput.is_open())
+    {
+        m_ofstOutput.close();
+    }
+}
+
+void Replay::pulsarOrder(const OPNX::Order& order)
+{
+    if (m_bMute)
+    {
+        return;
+    }
+    digest(order);
+}
+
+void Replay::pulsarOrderList(const std::vector<OPNX::Order>& orders)
+{
+    if (orders.empty())
+    {
+        return;
+    }
+    std::unordered_map<unsigned long long, long long> mapLastPrice;
+    for (auto& order: orders)
+    {
+        mapLastPrice.emplace(order.marketId, order.lastMatchPrice);
+        digest(order);
+    }
+    // as Manager::triggerLastPrice, a transaction moves the last price of the trigger order managers
+    if (OPNX::Order::MASS_QUOTE != orders[0].action && !m_bJournal)
+    {
+        for (auto item: mapLastPrice)
+        {
+            auto it = m_mapITriggerOrderManager.find(item.first);
+            if (m_mapITriggerOrderManager.end() != it)
+            {
+                it->second->lastPriceTriggerOrder(item.second);
+            }
+        }
+    }
+}
+
+// The file holds a json array of the markets as in the "markets" cmd
+bool Replay::addMarkets(const std::string& strMarketsFile)
+{
+    try {
+        nlohmann::json jsonMarkets;
+        std::ifstream ifst(strMarketsFile);
+        if (!ifst.is_open())
+        {
+            cfLog.fatal() << "Replay::addMarkets can't open " << strMarketsFile << std::endl;
+            return false;
+        }
+        ifst >> jsonMarkets;
+        ifst.close();
+        for (auto& jsonMarket: jsonMarkets)
+        {
+            unsigned long long ullMarketId = 0;
+            OPNX::Utils::getJsonValue<unsigned long long>(ullMarketId, jsonMarket, "marketId");
+            std::string strMarketCode = "";
+            OPNX::Utils::getJsonValue<std::string>(strMarketCode, jsonMarket, "marketCode");
+            unsigned long long ullFactor = 1;
+            OPNX::Utils::getJsonValue<unsigned long long>(ullFactor, jsonMarket, "factor");
+            if (m_mapEngine.end() != m_mapEngine.find(ullMarketId))
+            {
+                continue;
+            }
+            OPNX::IEngine* pIEngine = createIEngine(jsonMarket, (OPNX::ICallbackManager*)this);
+            m_mapEngine.emplace(ullMarketId, pIEngine);
+            OPNX::ITriggerOrder* pITriggerOrder = createTriggerOrder(jsonMarket, (OPNX::ICallbackManager*)this);
+            m_mapITriggerOrderManager.emplace(ullMarketId, pITriggerOrder);
+            m_unmapMarketCode[strMarketCode] = std::make_pair(ullMarketId, ullFactor);
+
+            std::string strType = pIEngine->getType();
+            if ("PERP" == strType)
+            {
+                g_ullPerpMarketId = ullMarketId;
+            }
+            else if ("REPO" == strType)
+            {
+                g_ullRepoMarketId = ullMarketId;
+            }
+            OPNX::Utils::setNodeId(ullMarketId);
+        }
+        return !m_mapEngine.empty();
+    } catch (const std::exception &e) {
+        cfLog.fatal() << "Replay::addMarkets exception: " << e.what() << std::endl;
+    }
+    return false;
+}
+
+void Replay::setOutputFile(const std::string& strOutputFile)
+{
+    m_ofstOutput.open(strOutputFile, std::ios::out | std::ios::trunc);
+}
+
+bool Replay::run(const std::string& strInput, bool bJournal, double dSpeed)
+{
+    m_bJournal = bJournal;
+    m_dSpeed = dSpeed;
+    unsigned long long beginTime = OPNX::Utils::getMicroTimestamp();
+    if (m_bJournal)
+    {
+        std::vector<OPNX::JournalRecord> vecRecord;
+        unsigned long long ullFirstSequence = 0;
+        OPNX::Journal::read(strInput, 0, vecRecord, ullFirstSequence);
+        if (vecRecord.empty())
+        {
+            cfLog.fatal() << "Replay::run no journal records of " << strInput << std::endl;
+            return false;
+        }
+        m_vecLatency.reserve(vecRecord.size());
+        for (size_t i = 0; i < vecRecord.size(); i++)
+        {
+            OPNX::Order& order = vecRecord[i].order;
+            setClock(order.orderCreated);
+            unsigned long long beginNano = OPNX::Utils::getNanoTimestamp();
+            if (OPNX::JOURNAL_TRIGGER_ORDER_IN == vecRecord[i].queue)
+            {
+                routeTriggerOrder(order);
+            }
+            else if (OPNX::Order::MASS_QUOTE == order.action)
+            {
+                // the quotes of a mass quote follow each other in the journal, the first one carries the count
+                size_t count = std::min<size_t>(std::max(1u, order.quoteCount), vecRecord.size() - i);
+                std::vector<OPNX::Order> vecQuote;
+                for (size_t j = i; j < i + count; j++)
+                {
+                    vecQuote.push_back(vecRecord[j].order);
+                }
+                i += count - 1;
+                auto it = m_mapEngine.find(vecQuote[0].marketId);
+                if (m_mapEngine.end() != it)
+                {
+                    it->second->handleMassQuote(vecQuote);
+                }
+            }
+            else
+            {
+                if (order.isTriggered && OPNX::Order::NEW == order.action)
+                {
+                    // as Manager::replayOrder, the triggered order leaves its trigger order manager
+                    auto it = m_mapITriggerOrderManager.find(order.marketId);
+                    if (m_mapITriggerOrderManager.end() != it)
+                    {
+                        OPNX::Order cancelOrder(order);
+                        cancelOrder.action = OPNX::Order::CANCEL;
+                        m_bMute = true;
+                        it->second->handleOrder(cancelOrder);
+                        m_bMute = false;
+                    }
+                }
+                routeOrder(order);
+            }
+            m_dequeTriggerOrder.clear();   // the orders passed between the engines and the trigger order managers are in the journal
+            m_dequeEngineOrder.clear();
+            m_vecLatency.push_back(OPNX::Utils::getNanoTimestamp() - beginNano);
+            m_ullMessageCount++;
+        }
+    }
+    else
+    {
+        std::ifstream ifst(strInput);
+        if (!ifst.is_open())
+        {
+            cfLog.fatal() << "Replay::run can't open " << strInput << std::endl;
+            return false;
+        }
+        std::string strLine;
+        while (std::getline(ifst, strLine))
+        {
+            if (strLine.empty())
+            {
+                continue;
+            }
+            handleLine(strLine);
+        }
+        ifst.close();
+    }
+    m_ullElapsed = OPNX::Utils::getMicroTimestamp() - beginTime;
+    return true;
+}
+
+// One line is a message of the order topic or of the mark price topic
+void Replay::handleLine(const std::string& strLine)
+{
+    rapidjson::Document document;
+    document.Parse(strLine.c_str());
+    if (document.HasParseError() || !document.IsObject())
+    {
+        cfLog.warn() << "Replay::handleLine can't parse: " << strLine << std::endl;
+        return;
+    }
+    auto it = document.FindMember("markPrice");
+    if (document.MemberEnd() != it)
+    {
+        auto itCode = document.FindMember("marketCode");
+        if (document.MemberEnd() == itCode || !itCode->value.IsString())
+        {
+            return;
+        }
+        auto market = m_unmapMarketCode.find(itCode->value.GetString());
+        if (m_unmapMarketCode.end() == market)
+        {
+            return;
+        }
+        auto itTime = document.FindMember("timestamp");
+        if (document.MemberEnd() != itTime && itTime->value.IsUint64())
+        {
+            setClock(itTime->value.GetUint64());
+        }
+        expireOrders();
+        unsigned long long beginNano = OPNX::Utils::getNanoTimestamp();
+        handleMarkPrice(market->second.first, OPNX::Utils::double2int(it->value.GetDouble() * market->second.second));
+        m_vecLatency.push_back(OPNX::Utils::getNanoTimestamp() - beginNano);
+        m_ullMessageCount++;
+        return;
+    }
+
+    OPNX::Order order;
+    OPNX::Order::rapidjsonToOrder(document, order);
+    setClock(0 != order.orderCreated ? order.orderCreated : order.timestamp);
+    expireOrders();
+    unsigned long long beginNano = OPNX::Utils::getNanoTimestamp();
+    if (OPNX::Order::MASS_QUOTE == order.action)
+    {
+        handleMassQuote(document, order);
+    }
+    else
+    {
+        handleOrder(order);
+    }
+    drain();
+    m_vecLatency.push_back(OPNX::Utils::getNanoTimestamp() - beginNano);
+    m_ullMessageCount++;
+}
+
+// The same split as PulsarProxy::consumerOrder
+void Replay::handleOrder(OPNX::Order& order)
+{
+    if ((!order.isTriggered && (OPNX::Order::STOP_LIMIT == order.type || OPNX::Order::STOP_MARKET == order.type
+         || OPNX::Order::TAKE_PROFIT_LIMIT == order.type || OPNX::Order::TAKE_PROFIT_MARKET == order.type))
+         || (OPNX::Order::CANCEL == order.action && 0 == order.orderId))
+    {
+        routeTriggerOrder(order);
+    }
+    else
+    {
+        routeOrder(order);
+    }
+}
+
+// The same quotes as PulsarProxy::pushMassQuote
+void Replay::handleMassQuote(const rapidjson::Document& document, const OPNX::Order& massQuote)
+{
+    std::vector<OPNX::Order> vecQuote;
+    auto it = document.FindMember(OPNX::key_quoteList);
+    if (document.MemberEnd() != it && it->value.IsArray())
+    {
+        for (auto& jsonQuote: it->value.GetArray())
+        {
+            OPNX::Order quote(massQuote);
+            OPNX::Order::rapidjsonToOrder(jsonQuote, quote);
+            quote.accountId = massQuote.accountId;
+            quote.marketId = massQuote.marketId;
+            quote.type = OPNX::Order::LIMIT;
+            quote.remainQuantity = quote.quantity;
+            if (0 == quote.displayQuantity)
+            {
+                quote.displayQuantity = quote.quantity;
+            }
+            quote.action = OPNX::Order::MASS_QUOTE;
+            vecQuote.push_back(quote);
+        }
+    }
+    if (vecQuote.empty())
+    {
+        OPNX::Order quote(massQuote);
+        quote.quantity = 0;
+        quote.remainQuantity = 0;
+        vecQuote.push_back(quote);
+    }
+    for (size_t i = 0; i < vecQuote.size(); i++)
+    {
+        vecQuote[i].quoteCount = vecQuote.size() - i;
+    }
+    auto itEngine = m_mapEngine.find(massQuote.marketId);
+    if (m_mapEngine.end() != itEngine)
+    {
+        itEngine->second->handleMassQuote(vecQuote);
+    }
+}
+
+void Replay::handleMarkPrice(unsigned long long ullMarketId, long long llMarkPrice)
+{
+    auto it = m_mapITriggerOrderManager.find(ullMarketId);
+    if (m_mapITriggerOrderManager.end() != it)
+    {
+        it->second->markPriceTriggerOrder(llMarkPrice);
+    }
+    if (ullMarketId == g_ullPerpMarketId)
+    {
+        g_llPerpMarkPrice = llMarkPrice;
+    }
+    drain();
+}
+
+// As Manager::routeOrder
+void Replay::routeOrder(OPNX::Order& order)
+{
+    if (OPNX::Order::CANCEL == order.action && 0 == order.orderId)
+    {
+        for (auto item : m_mapEngine)
+        {
+            if (0 == order.marketId || item.first == order.marketId)
+            {
+                item.second->handleOrder(order);
+            }
+        }
+    }
+    else
+    {
+        auto it = m_mapEngine.find(order.marketId);
+        if (m_mapEngine.end() != it)
+        {
+            it->second->handleOrder(order);
+        }
+    }
+}
+
+// As Manager::handleTriggerOrder, a cancel all goes on to the engines
+void Replay::routeTriggerOrder(OPNX::Order& order)
+{
+    if (OPNX::Order::CANCEL == order.action && 0 == order.orderId)
+    {
+        for (auto item : m_mapITriggerOrderManager)
+        {
+            if (0 == order.marketId || item.first == order.marketId)
+            {
+                item.second->handleOrder(order);
+            }
+        }
+        m_dequeEngineOrder.push_back(order);
+    }
+    else
+    {
+        auto it = m_mapITriggerOrderManager.find(order.marketId);
+        if (m_mapITriggerOrderManager.end() != it)
+        {
+            it->second->handleOrder(order);
+        }
+    }
+}
+
+// As Manager::expireOrders with the virtual clock, the expiries of a journal are in the journal
+void Replay::expireOrders()
+{
+    std::vector<OPNX::Order> vecExpired;
+    for (auto& item: m_mapEngine)
+    {
+        item.second->expireOrders(OPNX::Utils::getMilliTimestamp(), vecExpired);
+    }
+    for (auto& order: vecExpired)
+    {
+        routeOrder(order);
+    }
+    drain();
+}
+
+// Handle the orders passed between the engines and the trigger order managers until there are none left
+void Replay::drain()
+{
+    while (!m_dequeEngineOrder.empty() || !m_dequeTriggerOrder.empty())
+    {
+        while (!m_dequeTriggerOrder.empty())
+        {
+            OPNX::Order order = m_dequeTriggerOrder.front();
+            m_dequeTriggerOrder.pop_front();
+            routeTriggerOrder(order);
+        }
+        if (!m_dequeEngineOrder.empty())
+        {
+            OPNX::Order order = m_dequeEngineOrder.front();
+            m_dequeEngineOrder.pop_front();
+            routeOrder(order);
+        }
+    }
+}
+
+// The virtual clock follows the messages, with a speed the messages are also paced as they were received
+void Replay::setClock(unsigned long long ullTimestamp)
+{
+    if (0 == ullTimestamp || ullTimestamp < g_ullVirtualMilliTimestamp.load())
+    {
+        return;
+    }
+    g_ullVirtualMilliTimestamp.store(ullTimestamp);
+    if (0 >= m_dSpeed)
+    {
+        return;
+    }
+    if (0 == m_ullFirstTimestamp)
+    {
+        m_ullFirstTimestamp = ullTimestamp;
+        m_ullBeginTime = OPNX::Utils::getMicroTimestamp();
+        return;
+    }
+    unsigned long long dueTime = m_ullBeginTime + (unsigned long long)((ullTimestamp - m_ullFirstTimestamp) * 1000 / m_dSpeed);
+    unsigned long long now = OPNX::Utils::getMicroTimestamp();
+    if (dueTime > now)
+    {
+        usleep(dueTime - now);
+    }
+}
+
+// FNV-1a of the fields the engine sets, the digests of two runs are equal if their reports are equal
+void Replay::digest(const OPNX::Order& order)
+{
+    const unsigned long long arrField[] = {
+        order.orderId, order.accountId, order.marketId, (unsigned long long)order.price, order.quantity,
+        order.displayQuantity, order.remainQuantity, order.remainAmount, (unsigned long long)order.lastMatchPrice,
+        order.lastMatchQuantity, order.lastMatchedOrderId, order.lastMatchedOrderId2, order.matchedId, order.timestamp,
+        (unsigned long long)order.side, (unsigned long long)order.action, (unsigned long long)order.status,
+        (unsigned long long)order.matchedType, (unsigned long long)order.isTriggered
+    };
+    const unsigned char* p = (const unsigned char*)arrField;
+    for (size_t i = 0; i < sizeof(arrField); i++)
+    {
+        m_ullDigest = (m_ullDigest ^ p[i]) * FNV_PRIME;
+    }
+    m_ullOutputCount++;
+    if (m_ofstOutput.is_open())
+    {
+        std::string strJsonOrder = "";
+        OPNX::Order::orderToJsonString(order, strJsonOrder);
+        m_ofstOutput << strJsonOrder << "\n";
+    }
+}
+
+void Replay::report()
+{
+    std::sort(m_vecLatency.begin(), m_vecLatency.end());
+    auto percentile = [&](double dPercent) -> double {
+        if (m_vecLatency.empty())
+        {
+            return 0;
+        }
+        size_t index = std::min(m_vecLatency.size() - 1, (size_t)(dPercent / 100 * m_vecLatency.size()));
+        return m_vecLatency[index] / 1000.0;
+    };
+    double dSeconds = m_ullElapsed / 1000000.0;
+    printf("messages:   %llu\n", m_ullMessageCount);
+    printf("reports:    %llu\n", m_ullOutputCount);
+    printf("elapsed:    %.3f s\n", dSeconds);
+    printf("throughput: %.0f msg/s\n", 0 < dSeconds ? m_ullMessageCount / dSeconds : 0.0);
+    printf("latency(us) p50: %.2f p90: %.2f p99: %.2f p99.9: %.2f max: %.2f\n",
+           percentile(50), percentile(90), percentile(99), percentile(99.9), percentile(100));
+    printf("digest:     %016llx\n", m_ullDigest);
+}
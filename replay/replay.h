@@ -0,0 +1,97 @@
+#ifndef MATCHING_ENGINE_REPLAY_H
+#define MATCHING_ENGINE_REPLAY_H
+
+#include <deque>
+#include <fstream>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "common.h"
+#include "IEngine.h"
+#include "ITriggerOrder.h"
+#include "json.hpp"
+#include "order.h"
+#include "rapidjson/document.h"
+
+// Feeds a captured inbound stream into the engines and trigger order managers without pulsar.
+// Everything runs on the calling thread: the orders a message causes between the engine and the trigger
+// order manager are handled before the next message, so the same input gives the same output.
+class Replay: public OPNX::ICallbackManager {
+public:
+    Replay()
+    : m_bJournal(false)
+    , m_bMute(false)
+    , m_dSpeed(0)
+    , m_ullFirstTimestamp(0)
+    , m_ullBeginTime(0)
+    , m_ullMessageCount(0)
+    , m_ullOutputCount(0)
+    , m_ullDigest(FNV_OFFSET)
+    , m_ullElapsed(0){};
+    virtual ~Replay();
+
+public:
+    // ICallbackManager
+    virtual void pulsarOrder(const OPNX::Order& order);
+    virtual void pulsarOrderList(const std::vector<OPNX::Order>& orders);
+    virtual void triggerOrderToEngine(const OPNX::Order& order){
+        m_dequeEngineOrder.push_back(order);
+    }
+    virtual void triggerOrderListToEngine(const std::vector<OPNX::Order>& orders){
+        // as the manager, the orders triggered by one price go before the other orders
+        m_dequeEngineOrder.insert(m_dequeEngineOrder.begin(), orders.begin(), orders.end());
+    }
+    virtual void engineOrderToTrigger(const OPNX::Order& order){
+        m_dequeTriggerOrder.push_back(order);
+    }
+    virtual void bestOrderBookChange(){}
+    virtual void orderStore(OPNX::Order* pOrder){}
+
+public:
+    bool addMarkets(const std::string& strMarketsFile);
+    // bJournal: strInput is the prefix of journal files, otherwise a file of json lines as consumed from pulsar.
+    // dSpeed: 0 replays at max speed, otherwise the original pacing divided by dSpeed
+    bool run(const std::string& strInput, bool bJournal, double dSpeed);
+    void setOutputFile(const std::string& strOutputFile);
+    void report();
+
+private:
+    void handleLine(const std::string& strLine);
+    void handleOrder(OPNX::Order& order);
+    void handleMassQuote(const rapidjson::Document& document, const OPNX::Order& massQuote);
+    void handleMarkPrice(unsigned long long ullMarketId, long long llMarkPrice);
+    void routeOrder(OPNX::Order& order);
+    void routeTriggerOrder(OPNX::Order& order);
+    void expireOrders();
+    void drain();
+    void setClock(unsigned long long ullTimestamp);
+    void digest(const OPNX::Order& order);
+
+private:
+    static const unsigned long long FNV_OFFSET = 14695981039346656037ULL;
+    static const unsigned long long FNV_PRIME = 1099511628211ULL;
+
+    std::map<unsigned long long, OPNX::IEngine*> m_mapEngine;
+    std::map<unsigned long long, OPNX::ITriggerOrder*> m_mapITriggerOrderManager;
+    std::unordered_map<std::string, std::pair<unsigned long long, unsigned long long>> m_unmapMarketCode;   // marketCode: marketId, factor
+
+    std::deque<OPNX::Order> m_dequeEngineOrder;
+    std::deque<OPNX::Order> m_dequeTriggerOrder;
+
+    bool m_bJournal;            // a journal holds the input of the engines and of the trigger order managers, and what they pass each other
+    bool m_bMute;               // a triggered order of a journal leaves its trigger order manager without a report
+    double m_dSpeed;
+    unsigned long long m_ullFirstTimestamp;       // virtual clock of the first message
+    unsigned long long m_ullBeginTime;            // wall clock of the first message, micro seconds
+
+    std::ofstream m_ofstOutput;
+    unsigned long long m_ullMessageCount;
+    unsigned long long m_ullOutputCount;
+    unsigned long long m_ullDigest;
+    unsigned long long m_ullElapsed;              // micro seconds
+    std::vector<unsigned long long> m_vecLatency; // nano seconds of each message
+};
+
+#endif //MATCHING_ENGINE_REPLAY_H
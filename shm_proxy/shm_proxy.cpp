@@ -0,0 +1,253 @@
+#include <sstream>
+#include <unistd.h>
+#include "shm_proxy.h"
+#include "log.h"
+#include "utils.h"
+#include "thread_placement.h"
+
+static const int SHM_SPIN_COUNT = 10000;               // empty polls of the inbound ring before the consumer sleeps
+static const unsigned long long SHM_BROADCAST_SLOTS = 4;  // slots of an outbound ring for each slot of the inbound ring
+static const unsigned long long SHM_QUOTE_TIMEOUT = 10000;   // micro seconds to wait for the rest of a mass quote
+
+
+IMessage* createShmIMessage(IMessage* pIMessage,
+                            OPNX::OrderQueue<OPNX::Order>* pOrderQueue,
+                            OPNX::OrderQueue<OPNX::Order>* pTriggerOrderQueue,
+                            const std::string& strShmPrefix,
+                            unsigned long long ullRingSize){
+    return ShmProxy::createIMessage(pIMessage, pOrderQueue, pTriggerOrderQueue, strShmPrefix, ullRingSize);
+};
+IMessage* ShmProxy::createIMessage(IMessage* pIMessage,
+                                   OPNX::OrderQueue<OPNX::Order>* pOrderQueue,
+                                   OPNX::OrderQueue<OPNX::Order>* pTriggerOrderQueue,
+                                   const std::string& strShmPrefix,
+                                   unsigned long long ullRingSize){
+    return static_cast<IMessage*>(new ShmProxy(pIMessage, pOrderQueue, pTriggerOrderQueue, strShmPrefix, ullRingSize));
+};
+
+void ShmProxy::releaseIMessage() {
+    delete this;
+}
+ShmProxy::~ShmProxy()
+{
+    m_bRunning = false;
+    if (m_consumerThread.joinable())
+    {
+        m_consumerThread.join();
+    }
+    m_orderIn.destroy();
+    m_orderOut.destroy();
+    m_marketData.destroy();
+    if (nullptr != m_pIMessage)
+    {
+        m_pIMessage->releaseIMessage();
+        m_pIMessage = nullptr;
+    }
+}
+
+void ShmProxy::createMarketAll(const nlohmann::json& jsonConfig)
+{
+    setMarketInfo(jsonConfig);
+    m_pIMessage->createMarketAll(jsonConfig);
+
+    std::string strName = m_strShmPrefix + m_strMarketId;
+    if (!m_orderOut.create(strName + "-order-out", m_ullRingSize * SHM_BROADCAST_SLOTS)
+        || !m_marketData.create(strName + "-md", m_ullRingSize * SHM_BROADCAST_SLOTS))
+    {
+        cfLog.error() << "ShmProxy::createMarketAll create outbound rings failed, MarketCode: " << m_strMarketCode << " name: " << strName << std::endl;
+    }
+    // the inbound ring is created last, a gateway that attaches to it finds the outbound rings
+    if (!m_orderIn.create(strName + "-order-in", m_ullRingSize))
+    {
+        cfLog.error() << "ShmProxy::createMarketAll create inbound ring failed, MarketCode: " << m_strMarketCode << " name: " << strName << std::endl;
+        return;
+    }
+    if (!m_consumerThread.joinable())
+    {
+        m_consumerThread = std::thread(consumerOrderThread, this);
+    }
+}
+
+void ShmProxy::sendOrder(const std::string& strJsonData)
+{
+    m_pIMessage->sendOrder(strJsonData);
+    m_orderOut.write(strJsonData);
+}
+void ShmProxy::sendOrders(const std::string& strJsonData)
+{
+    m_pIMessage->sendOrders(strJsonData);
+    m_orderOut.write(strJsonData);
+}
+void ShmProxy::sendOrderBookSnapshot(const nlohmann::json& jsonData)
+{
+    m_pIMessage->sendOrderBookSnapshot(jsonData);
+    m_marketData.write(jsonData.dump());
+}
+void ShmProxy::sendOrderBookDiff(const nlohmann::json& jsonData)
+{
+    m_pIMessage->sendOrderBookDiff(jsonData);
+    m_marketData.write(jsonData.dump());
+}
+void ShmProxy::sendOrderBookBest(const nlohmann::json& jsonData)
+{
+    m_pIMessage->sendOrderBookBest(jsonData);
+    m_marketData.write(jsonData.dump());
+}
+
+void ShmProxy::exitConsumer()
+{
+    m_bRunning = false;
+    m_pIMessage->exitConsumer();
+}
+
+void ShmProxy::setMarketInfo(const nlohmann::json& jsonMarketInfo)
+{
+    unsigned long long llMarketId = 0;
+    OPNX::Utils::getJsonValue<unsigned long long>(llMarketId, jsonMarketInfo, "marketId");
+    m_strMarketId = std::to_string(llMarketId);
+    OPNX::Utils::getJsonValue<std::string>(m_strMarketCode, jsonMarketInfo, "marketCode");
+    m_pIMessage->setMarketInfo(jsonMarketInfo);
+}
+
+void ShmProxy::consumerOrderThread(ShmProxy* pShmProxy)
+{
+    if (nullptr != pShmProxy)
+    {
+        OPNX::ThreadPlacement::instance().apply("ORDER_CONSUMER");
+        pShmProxy->consumerOrder();
+    }
+}
+
+// Polls the inbound ring with the wait strategy of ORDER_CONSUMER, by default it sleeps between the polls after SHM_SPIN_COUNT empty ones
+void ShmProxy::consumerOrder()
+{
+    OPNX::WaitStrategy waitStrategy = OPNX::ThreadPlacement::instance().getWaitStrategy("ORDER_CONSUMER", OPNX::WaitStrategy(OPNX::WaitStrategy::SPIN_PARK, SHM_SPIN_COUNT, 10));
+    std::vector<OPNX::Order> vecQuote;
+    OPNX::Order nextOrder;
+    bool bNextOrder = false;    // the record that ended an incomplete mass quote
+    while (m_bRunning)
+    {
+        try {
+            OPNX::Order order;
+            if (bNextOrder)
+            {
+                order = nextOrder;
+                bNextOrder = false;
+            }
+            else if (!popOrder(order, waitStrategy))
+            {
+                continue;
+            }
+
+            if (OPNX::Order::MASS_QUOTE == order.action)
+            {
+                // the gateway pushes all quotes at once, the ones after the first are in the ring already or being written.
+                // A count the ring can't hold, a record of another mass quote or a timeout ends the mass quote, it is rejected.
+                vecQuote.clear();
+                vecQuote.push_back(order);
+                unsigned long long ullQuoteCount = std::max(1u, order.quoteCount);
+                bool bComplete = ullQuoteCount <= m_orderIn.getSlotCount();
+                unsigned long long ullDeadline = OPNX::Utils::getMicroTimestamp() + SHM_QUOTE_TIMEOUT;
+                while (bComplete && m_bRunning && vecQuote.size() < ullQuoteCount)
+                {
+                    if (popOrder(nextOrder, waitStrategy))
+                    {
+                        if (OPNX::Order::MASS_QUOTE != nextOrder.action || nextOrder.accountId != vecQuote[0].accountId
+                            || nextOrder.quoteCount != ullQuoteCount - vecQuote.size())
+                        {
+                            bNextOrder = true;
+                            bComplete = false;
+                            break;
+                        }
+                        nextOrder.receivedTime = vecQuote[0].receivedTime;
+                        vecQuote.push_back(nextOrder);
+                    }
+                    else if (OPNX::Utils::getMicroTimestamp() > ullDeadline)
+                    {
+                        bComplete = false;
+                    }
+                }
+                if (bComplete && vecQuote.size() == ullQuoteCount)
+                {
+                    pushMassQuote(vecQuote);
+                }
+                else
+                {
+                    cfLog.error() << "ShmProxy::consumerOrder " << m_strMarketCode << " incomplete mass quote of account: " << vecQuote[0].accountId
+                                  << " quotes: " << vecQuote.size() << " of " << vecQuote[0].quoteCount << std::endl;
+                    for (auto& quote: vecQuote)
+                    {
+                        quote.status = OPNX::Order::REJECT_MASS_QUOTE_INCOMPLETE;
+                        sendReject(quote);
+                    }
+                }
+            }
+            else
+            {
+                pushOrder(order);
+            }
+        } catch (...) {
+            cfLog.fatal() << "ShmProxy::consumerOrder exception, MarketCode: " << m_strMarketCode << std::endl;
+        }
+    }
+}
+
+// Returns false after an idle of the wait strategy if the ring is empty
+bool ShmProxy::popOrder(OPNX::Order& order, OPNX::WaitStrategy& waitStrategy)
+{
+    if (!m_orderIn.pop(order))
+    {
+        waitStrategy.idle();
+        return false;
+    }
+    waitStrategy.reset();
+    order.receivedTime = OPNX::Utils::getNanoTimestamp();
+    if (cfLog.enabledInfo())
+    {
+        OPNX_LOG_INFO << "ME in <-- " << m_strMarketCode << " shm receive order: " << order.orderId << " action: " << order.action
+                     << " accountId: " << order.accountId << " clientOrderId: " << order.clientOrderId << std::endl;
+    }
+    return true;
+}
+
+void ShmProxy::pushOrder(OPNX::Order& order)
+{
+    if (m_pIMessage->getRecovery())
+    {
+        order.status = OPNX::Order::REJECT_MATCHING_ENGINE_RECOVERING;
+        sendReject(order);
+        return;
+    }
+    if (!m_orderRouter.pushOrder(order))
+    {
+        sendReject(order);
+    }
+}
+
+void ShmProxy::pushMassQuote(std::vector<OPNX::Order>& vecQuote)
+{
+    if (m_pIMessage->getRecovery())
+    {
+        for (auto& quote: vecQuote)
+        {
+            quote.status = OPNX::Order::REJECT_MATCHING_ENGINE_RECOVERING;
+            sendReject(quote);
+        }
+        return;
+    }
+    std::vector<OPNX::Order> vecReject;
+    m_orderRouter.pushMassQuote(vecQuote, vecReject);
+    for (auto& quote: vecReject)
+    {
+        sendReject(quote);
+    }
+}
+
+void ShmProxy::sendReject(const OPNX::Order& order)
+{
+    std::stringstream ssOrder;
+    std::string strJsonOrder = "";
+    OPNX::Order::orderToJsonString(order, strJsonOrder);
+    ssOrder << "{\"pt\":\"Order\",\"ol\":[" << strJsonOrder << "]}";
+    sendOrder(ssOrder.str());
+}
@@ -0,0 +1,94 @@
+#ifndef __SHM_PROXY_H__
+#define __SHM_PROXY_H__
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "IMessage.h"
+#include "thread_queue.h"
+#include "order.h"
+#include "json.hpp"
+#include "shm_ring.h"
+#include "order_router.h"
+
+// Shared memory transport for a gateway on the same host, in front of the pulsar proxy of a market.
+// Orders of the gateway come from the inbound ring as OPNX::Order records and are routed like the orders of pulsar.
+// Everything that is sent goes to pulsar as before, reports and market data are also written to the outbound rings,
+// so the gateway gets them without the broker. Commands, heartbeat, logs and mark prices stay on pulsar only.
+//
+// Rings of market <marketId>, named with the prefix of the config:
+//   <prefix><marketId>-order-in    ShmQueue<OPNX::Order>, the gateway pushes, the orders of a mass quote together with quoteCount counting down
+//   <prefix><marketId>-order-out   ShmBroadcast of the json reports of sendOrder and sendOrders
+//   <prefix><marketId>-md          ShmBroadcast of the json order book snapshots, diffs and best prices
+class ShmProxy: public IMessage{
+private:
+    ShmProxy(IMessage* pIMessage,
+             OPNX::OrderQueue<OPNX::Order>* pOrderQueue,
+             OPNX::OrderQueue<OPNX::Order>* pTriggerOrderQueue,
+             const std::string& strShmPrefix,
+             unsigned long long ullRingSize)
+    : m_pIMessage(pIMessage)
+    , m_orderRouter(pOrderQueue, pTriggerOrderQueue)
+    , m_strShmPrefix(strShmPrefix)
+    , m_ullRingSize(ullRingSize)
+    , m_bRunning(true)
+    , m_strMarketId("")
+    , m_strMarketCode(""){};
+    ShmProxy(const ShmProxy &) = delete;
+    ShmProxy(ShmProxy &&) = delete;
+    ShmProxy &operator=(const ShmProxy &) = delete;
+    ShmProxy &operator=(ShmProxy &&) = delete;
+    ~ShmProxy();
+public:
+    // pIMessage is the pulsar proxy of the market, it is released with the ShmProxy
+    static IMessage* createIMessage(IMessage* pIMessage, OPNX::OrderQueue<OPNX::Order>* pOrderQueue, OPNX::OrderQueue<OPNX::Order>* pTriggerOrderQueue,
+                                    const std::string& strShmPrefix, unsigned long long ullRingSize);
+    virtual void releaseIMessage();
+
+    // Create the rings of the market and all consumers and producers of pulsar
+    // jsonConfig contains the following fields: marketId, marketCode, referencePair, factor
+    virtual void createMarketAll(const nlohmann::json& jsonConfig);
+    virtual void createMarketAllTest(const nlohmann::json& jsonConfig) { m_pIMessage->createMarketAllTest(jsonConfig); }
+    virtual void createCommander(const std::string& strReferencePair) { m_pIMessage->createCommander(strReferencePair); }
+    virtual void createTestCommander(const std::string& strReferencePair) { m_pIMessage->createTestCommander(strReferencePair); }
+
+    virtual void sendOrder(const std::string& strJsonData);
+    virtual void sendOrders(const std::string& strJsonData);
+    virtual void sendOrderBookSnapshot(const nlohmann::json& jsonData);
+    virtual void sendOrderBookDiff(const nlohmann::json& jsonData);
+    virtual void sendOrderBookBest(const nlohmann::json& jsonData);
+    virtual void sendCmd(const nlohmann::json& jsonData) { m_pIMessage->sendCmd(jsonData); }
+    virtual void sendHeartbeat(const nlohmann::json& jsonData) { m_pIMessage->sendHeartbeat(jsonData); }
+    virtual void sendPulsarLog(const std::string& strLog) { m_pIMessage->sendPulsarLog(strLog); }
+    virtual void sendSpreadSnapshot(const std::string& strJsonData) { m_pIMessage->sendSpreadSnapshot(strJsonData); }
+
+    // the recovery state belongs to the pulsar proxy, it ends with the RECOVERY_END of pulsar
+    virtual void setRecovery(bool bRecovery) { m_pIMessage->setRecovery(bRecovery); }
+    virtual bool getRecovery() { return m_pIMessage->getRecovery(); }
+    virtual void exitConsumer();
+    virtual void addOrderConsumer(int iCount) { m_pIMessage->addOrderConsumer(iCount); }
+    virtual void setMarketInfo(const nlohmann::json& jsonMarketInfo);
+
+private:
+    static void consumerOrderThread(ShmProxy* pShmProxy);
+    void consumerOrder();
+    bool popOrder(OPNX::Order& order, OPNX::WaitStrategy& waitStrategy);
+    void pushOrder(OPNX::Order& order);
+    void pushMassQuote(std::vector<OPNX::Order>& vecQuote);
+    void sendReject(const OPNX::Order& order);
+private:
+    IMessage* m_pIMessage;
+    OPNX::OrderRouter m_orderRouter;
+    std::string m_strShmPrefix;
+    unsigned long long m_ullRingSize;
+    volatile bool m_bRunning;
+    std::string m_strMarketId;
+    std::string m_strMarketCode;
+    std::thread m_consumerThread;
+    OPNX::ShmQueue<OPNX::Order> m_orderIn;
+    OPNX::ShmBroadcast m_orderOut;
+    OPNX::ShmBroadcast m_marketData;
+};
+
+#endif //__SHM_PROXY_H__
@@ -0,0 +1,113 @@
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include "shm_ring.h"
+
+
+struct ShmValue {
+    unsigned long long ullValue;
+    unsigned int uiCount;
+};
+
+class ShmQueueTest: public ::testing::Test {
+protected:
+    void SetUp() override
+    {
+        m_strName = "/opnx_shm_queue_test_" + std::to_string(getpid());
+        ASSERT_TRUE(m_queue.create(m_strName, 8));
+        ASSERT_EQ(8u, m_queue.getSlotCount());
+    }
+    void TearDown() override
+    {
+        m_queue.destroy();
+    }
+
+    bool push(unsigned long long ullFirst, unsigned int uiCount)
+    {
+        std::vector<ShmValue> vecValue;
+        for (unsigned int i = 0; i < uiCount; i++)
+        {
+            vecValue.push_back(ShmValue{ullFirst + i, uiCount - i});
+        }
+        return m_queue.push(vecValue.data(), uiCount);
+    }
+
+    std::vector<unsigned long long> popAll()
+    {
+        std::vector<unsigned long long> vecValue;
+        ShmValue value;
+        while (m_queue.pop(value))
+        {
+            vecValue.push_back(value.ullValue);
+        }
+        return vecValue;
+    }
+
+    std::string m_strName;
+    OPNX::ShmQueue<ShmValue> m_queue;
+};
+
+// A push of several values that crosses the end of the ring keeps them together and in order
+TEST_F(ShmQueueTest, MultiSlotPushWraps)
+{
+    ASSERT_TRUE(push(1, 5));
+    EXPECT_EQ(std::vector<unsigned long long>({1, 2, 3, 4, 5}), popAll());
+
+    // positions 5 to 10, the slots 5, 6, 7, 0, 1, 2
+    ASSERT_TRUE(push(100, 6));
+    ShmValue value;
+    for (unsigned int i = 0; i < 6; i++)
+    {
+        ASSERT_TRUE(m_queue.pop(value));
+        EXPECT_EQ(100 + i, value.ullValue);
+        EXPECT_EQ(6 - i, value.uiCount);
+    }
+    EXPECT_FALSE(m_queue.pop(value));
+}
+
+// A push that needs slots the consumer hasn't released fails as a whole, nothing of it is visible
+TEST_F(ShmQueueTest, MultiSlotPushFullFails)
+{
+    ASSERT_TRUE(push(1, 6));
+    EXPECT_FALSE(push(10, 3));
+    ASSERT_TRUE(push(20, 2));
+    EXPECT_FALSE(push(30, 1));
+
+    ShmValue value;
+    ASSERT_TRUE(m_queue.pop(value));
+    ASSERT_TRUE(m_queue.pop(value));
+    // 2 slots free at the start of the next round, the push wraps into them
+    EXPECT_FALSE(push(40, 3));
+    ASSERT_TRUE(push(50, 2));
+    EXPECT_EQ(std::vector<unsigned long long>({3, 4, 5, 6, 20, 21, 50, 51}), popAll());
+}
+
+// More values than the ring has slots are never pushed
+TEST_F(ShmQueueTest, PushLargerThanRingFails)
+{
+    EXPECT_FALSE(push(1, 9));
+    EXPECT_FALSE(push(1, 0));
+    ASSERT_TRUE(push(1, 8));
+    EXPECT_EQ(8u, popAll().size());
+}
+
+// The ring keeps working after many rounds of pushes of different sizes
+TEST_F(ShmQueueTest, ManyRounds)
+{
+    unsigned long long ullNext = 0;
+    for (unsigned int uiRound = 0; uiRound < 1000; uiRound++)
+    {
+        unsigned int uiCount = 1 + uiRound % 8;
+        ASSERT_TRUE(push(ullNext, uiCount)) << "round " << uiRound;
+        std::vector<unsigned long long> vecValue = popAll();
+        ASSERT_EQ(uiCount, vecValue.size());
+        for (unsigned int i = 0; i < uiCount; i++)
+        {
+            EXPECT_EQ(ullNext + i, vecValue[i]);
+        }
+        ullNext += uiCount;
+    }
+}
@@ -0,0 +1,122 @@
+#include <map>
+#include <random>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "timing_wheel.h"
+
+
+// The entries of a time <= ullNow of a reference ordered by time, they are removed from it
+static std::vector<unsigned long long> expireReference(std::multimap<unsigned long long, unsigned long long>& mapReference, unsigned long long ullNow)
+{
+    std::vector<unsigned long long> vecExpired;
+    auto itEnd = mapReference.upper_bound(ullNow);
+    for (auto it = mapReference.begin(); itEnd != it; it++)
+    {
+        vecExpired.push_back(it->second);
+    }
+    mapReference.erase(mapReference.begin(), itEnd);
+    return vecExpired;
+}
+
+static std::vector<unsigned long long> advance(OPNX::TimingWheel<unsigned long long>& timingWheel, unsigned long long ullNow)
+{
+    std::vector<unsigned long long> vecExpired;
+    timingWheel.advance(ullNow, [&vecExpired](unsigned long long ullValue) { vecExpired.push_back(ullValue); });
+    return vecExpired;
+}
+
+// Each entry expires at its own tick and not before, on both sides of the end of every level and of the overflow
+TEST(TimingWheelTest, AdvanceAcrossLevelsAndOverflow)
+{
+    OPNX::TimingWheel<unsigned long long> timingWheel;
+    std::vector<unsigned long long> vecTime;
+    for (unsigned int uiLevel = 1; uiLevel <= OPNX::TIMING_WHEEL_LEVEL_COUNT + 1; uiLevel++)
+    {
+        unsigned long long ullBoundary = 1ULL << (uiLevel * OPNX::TIMING_WHEEL_SLOT_BITS);
+        vecTime.push_back(ullBoundary - 1);
+        vecTime.push_back(ullBoundary);
+        vecTime.push_back(ullBoundary + 1);
+    }
+    for (auto ullTime: vecTime)
+    {
+        timingWheel.add(ullTime, ullTime);
+    }
+    EXPECT_EQ(vecTime.size(), timingWheel.size());
+
+    for (auto ullTime: vecTime)
+    {
+        EXPECT_TRUE(advance(timingWheel, ullTime - 1).empty()) << "before " << ullTime;
+        std::vector<unsigned long long> vecExpired = advance(timingWheel, ullTime);
+        ASSERT_EQ(1u, vecExpired.size()) << "at " << ullTime;
+        EXPECT_EQ(ullTime, vecExpired[0]);
+    }
+    EXPECT_TRUE(timingWheel.empty());
+}
+
+// An entry added after the current tick crossed levels is placed relative to the new tick
+TEST(TimingWheelTest, AddAfterLongAdvance)
+{
+    OPNX::TimingWheel<unsigned long long> timingWheel;
+    unsigned long long ullNow = (1ULL << 32) + 12345;
+    EXPECT_TRUE(advance(timingWheel, ullNow).empty());
+
+    timingWheel.add(ullNow + 1, 1);
+    timingWheel.add(ullNow + 300, 2);
+    timingWheel.add(ullNow + 70000, 3);
+    timingWheel.add(ullNow + (1ULL << 33), 4);
+    EXPECT_EQ(std::vector<unsigned long long>({1}), advance(timingWheel, ullNow + 299));
+    EXPECT_EQ(std::vector<unsigned long long>({2}), advance(timingWheel, ullNow + 69999));
+    EXPECT_EQ(std::vector<unsigned long long>({3}), advance(timingWheel, ullNow + (1ULL << 33) - 1));
+    EXPECT_EQ(std::vector<unsigned long long>({4}), advance(timingWheel, ullNow + (1ULL << 33)));
+    EXPECT_TRUE(timingWheel.empty());
+}
+
+// A time before the current tick expires at the current tick, the one after the last advance
+TEST(TimingWheelTest, AddInThePast)
+{
+    OPNX::TimingWheel<unsigned long long> timingWheel;
+    advance(timingWheel, 1000);
+    timingWheel.add(10, 1);
+    EXPECT_EQ(std::vector<unsigned long long>({1}), advance(timingWheel, 1001));
+    EXPECT_TRUE(timingWheel.empty());
+}
+
+// Random times of all the levels and random steps expire as a sorted reference, in the order of their ticks
+TEST(TimingWheelTest, AdvanceMatchesReference)
+{
+    std::mt19937_64 random(1);
+    OPNX::TimingWheel<unsigned long long> timingWheel;
+    std::multimap<unsigned long long, unsigned long long> mapReference;    // time, value
+    std::map<unsigned long long, unsigned long long> mapTime;              // value, time
+    unsigned long long ullNow = 0;
+    unsigned long long ullValue = 0;
+    for (int iRound = 0; iRound < 2000; iRound++)
+    {
+        for (int i = 0; i < 5; i++)
+        {
+            // a range of each level and the overflow
+            unsigned int uiBits = OPNX::TIMING_WHEEL_SLOT_BITS * (1 + random() % (OPNX::TIMING_WHEEL_LEVEL_COUNT + 1));
+            unsigned long long ullTime = ullNow + 1 + random() % (1ULL << uiBits);
+            timingWheel.add(ullTime, ++ullValue);
+            mapReference.emplace(ullTime, ullValue);
+            mapTime[ullValue] = ullTime;
+        }
+        unsigned int uiStepBits = random() % 34;
+        ullNow += random() % (1ULL << uiStepBits);
+
+        std::vector<unsigned long long> vecExpired = advance(timingWheel, ullNow);
+        std::vector<unsigned long long> vecExpected = expireReference(mapReference, ullNow);
+        ASSERT_EQ(vecExpected.size(), vecExpired.size()) << "round " << iRound;
+        for (size_t i = 0; i < vecExpired.size(); i++)
+        {
+            // the entries of the same tick expire in any order
+            ASSERT_EQ(mapTime[vecExpected[i]], mapTime[vecExpired[i]]) << "round " << iRound;
+        }
+        ASSERT_EQ(mapReference.size(), timingWheel.size());
+    }
+    ullNow += 1ULL << 41;
+    EXPECT_EQ(expireReference(mapReference, ullNow).size(), advance(timingWheel, ullNow).size());
+    EXPECT_TRUE(timingWheel.empty());
+}
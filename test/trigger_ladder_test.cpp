@@ -0,0 +1,127 @@
+#include <list>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "trigger_ladder.h"
+
+
+class TriggerLadderTest: public ::testing::Test {
+protected:
+    TriggerLadderTest() : m_ullSortId(0){};
+
+    OPNX::Order* newOrder(OPNX::TriggerLadder& triggerLadder, unsigned long long ullOrderId, long long llTriggerPrice)
+    {
+        m_listOrder.emplace_back();
+        OPNX::Order* pOrder = &m_listOrder.back();
+        pOrder->orderId = ullOrderId;
+        pOrder->triggerPrice = llTriggerPrice;
+        pOrder->sortId = ++m_ullSortId;
+        triggerLadder.add(pOrder);
+        return pOrder;
+    }
+
+    // As TriggerOrderManager::handleAmendOrder: the order is erased with its old trigger price and sortId,
+    // then it goes to the back of its new price with a new sortId
+    OPNX::Order amend(OPNX::TriggerLadder& triggerLadder, OPNX::Order* pOrder, long long llTriggerPrice)
+    {
+        OPNX::Order bakOrder(*pOrder);
+        pOrder->triggerPrice = llTriggerPrice;
+        triggerLadder.erase(bakOrder);
+        pOrder->sortId = ++m_ullSortId;
+        triggerLadder.add(pOrder);
+        return bakOrder;
+    }
+
+    static std::vector<unsigned long long> getOrderIds(const OPNX::TriggerLadder& triggerLadder)
+    {
+        std::vector<unsigned long long> vecOrderId;
+        triggerLadder.forEach([&vecOrderId](const OPNX::Order* pOrder) { vecOrderId.push_back(pOrder->orderId); });
+        return vecOrderId;
+    }
+
+    static std::vector<unsigned long long> trigger(OPNX::TriggerLadder& triggerLadder, long long llPrice)
+    {
+        std::vector<unsigned long long> vecOrderId;
+        triggerLadder.trigger(llPrice, [&vecOrderId](OPNX::Order* pOrder) { vecOrderId.push_back(pOrder->orderId); });
+        return vecOrderId;
+    }
+
+    unsigned long long m_ullSortId;
+    std::list<OPNX::Order> m_listOrder;    // the ladders keep pointers to the orders
+};
+
+// An order amended to the price of other orders goes behind them and is erased with its new price and sortId
+TEST_F(TriggerLadderTest, EraseAfterAmendToOtherLevel)
+{
+    OPNX::TriggerLadder triggerLadder(OPNX::Order::GREATER_EQUAL);
+    newOrder(triggerLadder, 1, 100);
+    OPNX::Order* pOrder = newOrder(triggerLadder, 2, 100);
+    newOrder(triggerLadder, 3, 110);
+    newOrder(triggerLadder, 4, 120);
+
+    OPNX::Order bakOrder = amend(triggerLadder, pOrder, 120);
+    EXPECT_EQ(4u, triggerLadder.size());
+    EXPECT_EQ(std::vector<unsigned long long>({1, 3, 4, 2}), getOrderIds(triggerLadder));
+
+    // the record of the order before the amend is gone
+    triggerLadder.erase(bakOrder);
+    EXPECT_EQ(4u, triggerLadder.size());
+
+    triggerLadder.erase(*pOrder);
+    EXPECT_EQ(3u, triggerLadder.size());
+    EXPECT_EQ(std::vector<unsigned long long>({1, 3, 4}), getOrderIds(triggerLadder));
+    EXPECT_EQ(std::vector<unsigned long long>({1, 3, 4}), trigger(triggerLadder, 120));
+    EXPECT_TRUE(triggerLadder.empty());
+}
+
+// An order amended to a new price alone on its level removes the level when it is erased, the old level goes when it is empty
+TEST_F(TriggerLadderTest, EraseAfterAmendToNewLevel)
+{
+    OPNX::TriggerLadder triggerLadder(OPNX::Order::LESS_EQUAL);
+    OPNX::Order* pOrder = newOrder(triggerLadder, 1, 100);
+    newOrder(triggerLadder, 2, 90);
+
+    amend(triggerLadder, pOrder, 95);
+    EXPECT_EQ(std::vector<unsigned long long>({1, 2}), getOrderIds(triggerLadder));
+    // nothing is left at the old price
+    EXPECT_TRUE(trigger(triggerLadder, 99).empty());
+
+    triggerLadder.erase(*pOrder);
+    EXPECT_EQ(1u, triggerLadder.size());
+    EXPECT_TRUE(trigger(triggerLadder, 95).empty());
+    EXPECT_EQ(std::vector<unsigned long long>({2}), trigger(triggerLadder, 90));
+    EXPECT_TRUE(triggerLadder.empty());
+}
+
+// The amends of many orders keep each level sorted by sortId, every order can be erased after them
+TEST_F(TriggerLadderTest, EraseAfterManyAmends)
+{
+    OPNX::TriggerLadder triggerLadder(OPNX::Order::GREATER_EQUAL);
+    std::vector<OPNX::Order*> vecOrder;
+    for (unsigned long long i = 0; i < 100; i++)
+    {
+        vecOrder.push_back(newOrder(triggerLadder, i + 1, 1000 + (long long)(i % 10)));
+    }
+    for (unsigned long long i = 0; i < 100; i += 3)
+    {
+        amend(triggerLadder, vecOrder[i], 1000 + (long long)((i * 7) % 13));
+    }
+    EXPECT_EQ(100u, triggerLadder.size());
+
+    // by trigger price then sortId
+    std::vector<const OPNX::Order*> vecSorted;
+    triggerLadder.forEach([&vecSorted](const OPNX::Order* pOrder) { vecSorted.push_back(pOrder); });
+    for (size_t i = 1; i < vecSorted.size(); i++)
+    {
+        EXPECT_TRUE(vecSorted[i - 1]->triggerPrice < vecSorted[i]->triggerPrice
+                    || (vecSorted[i - 1]->triggerPrice == vecSorted[i]->triggerPrice && vecSorted[i - 1]->sortId < vecSorted[i]->sortId));
+    }
+
+    for (auto pOrder: vecOrder)
+    {
+        triggerLadder.erase(*pOrder);
+    }
+    EXPECT_TRUE(triggerLadder.empty());
+    EXPECT_TRUE(getOrderIds(triggerLadder).empty());
+}